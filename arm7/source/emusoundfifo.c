@@ -1,13 +1,83 @@
 #include <nds/arm7/audio.h>
 #include <nds/fifocommon.h>
 #include <nds/fifomessages.h>
+#include <nds/interrupts.h>
+#include <nds/timers.h>
+#include <string.h>
+#include "TIASynth.h"
 
 typedef enum {
   EMUARM7_INIT_SND = 0x123C,
   EMUARM7_STOP_SND = 0x123D,
   EMUARM7_PLAY_SND = 0x123E,
+  EMUARM7_SYNTH_SND = 0x123F,
 } FifoMesType;
 
+static TiaSynthShared *synthShared = 0;     // Set while we're making the TIA sound for the ARM9
+static TiaSynth synth;
+static u32 synthRingIdx = 0;                // Next sample to be written (free running - masked on use)
+static u16 synthFreq = 0;
+static u32 synthFrameSamples = 0;           // Samples in one of the cart's frames - we keep two of these ahead
+static u32 synthPlayed = 0;                 // The frame number and cycle we've played the log up to (as a record)
+
+//---------------------------------------------------------------------------------
+// Play everything the ARM9 has logged since last time into the ring. This runs off
+// a 1kHz timer so the log never gets anywhere near full. At the end of each frame
+// we check that we're still ahead of the channel (TIMER3 counts the samples it has
+// played) but not so far ahead that we'd be writing over what it hasn't played yet.
+//---------------------------------------------------------------------------------
+void soundEmuSynthUpdate(void)
+{
+	TiaSynthShared *shared = synthShared;
+	if (shared == 0) return;
+
+	u32 tail = shared->tail;
+	u32 head = shared->head;
+	while (tail != head)
+	{
+		u32 record = shared->records[tail & (TIA_SYNTH_FIFO_SIZE-1)];
+		TiaSynth_record(&synth, record, shared->ring, TIA_SYNTH_RING_SIZE-1, &synthRingIdx);
+		tail++;
+
+		if (TIA_SYNTH_REG(record) == TIA_SYNTH_FRAME)
+		{
+			synthPlayed = TIA_SYNTH_RECORD(0, TIA_SYNTH_FRAME, TIA_SYNTH_VALUE(record));
+			s16 ahead = (s16)((u16)synthRingIdx - TIMER3_DATA);
+			if ((ahead < (s16)(synthFrameSamples / 2)) || (ahead > (s16)(TIA_SYNTH_RING_SIZE - synthFrameSamples)))
+			{
+				synthRingIdx = (u16)TIMER3_DATA + (2 * synthFrameSamples);
+			}
+		}
+		else
+		{
+			synthPlayed = TIA_SYNTH_RECORD(TIA_SYNTH_CYCLE(record), TIA_SYNTH_FRAME, TIA_SYNTH_VALUE(synthPlayed));
+		}
+	}
+	shared->tail = tail;
+	shared->ahead = (s16)((u16)synthRingIdx - TIMER3_DATA);    // For the ARM9 to pace its frames by...
+	shared->played = synthPlayed;                               // ...with what it still has to add on - always written second
+}
+
+//---------------------------------------------------------------------------------
+static void soundEmuSynthStop(void)
+{
+	irqDisable(IRQ_TIMER1);
+	TIMER1_CR = 0;
+	TIMER2_CR = 0;
+	TIMER3_CR = 0;
+	synthShared = 0;
+}
+
+//---------------------------------------------------------------------------------
+static void soundEmuStartChannel(int channel, FifoMessage *msg, const void *data)
+{
+	SCHANNEL_SOURCE(channel) = (u32)data;
+	SCHANNEL_REPEAT_POINT(channel) = msg->SoundPlay.loopPoint;
+	SCHANNEL_LENGTH(channel) = msg->SoundPlay.dataSize;
+	SCHANNEL_TIMER(channel) = SOUND_FREQ(msg->SoundPlay.freq);
+	SCHANNEL_CR(channel) = SCHANNEL_ENABLE | SOUND_VOL(msg->SoundPlay.volume) | SOUND_PAN(msg->SoundPlay.pan) | ((msg->SoundPlay.format & 0xF) << 29) | (msg->SoundPlay.loop ? SOUND_REPEAT : SOUND_ONE_SHOT);
+}
+
 //---------------------------------------------------------------------------------
 void soundEmuDataHandler(int bytes, void *user_data) 
 {
@@ -19,18 +89,46 @@ void soundEmuDataHandler(int bytes, void *user_data)
 
   switch (msg.type) {
     case EMUARM7_PLAY_SND:
+      soundEmuSynthStop();
       channel = (msg.SoundPlay.format & 0xF0)>>4;
-      SCHANNEL_SOURCE(channel) = (u32)msg.SoundPlay.data;
-      SCHANNEL_REPEAT_POINT(channel) = msg.SoundPlay.loopPoint;
-      SCHANNEL_LENGTH(channel) = msg.SoundPlay.dataSize;
-      SCHANNEL_TIMER(channel) = SOUND_FREQ(msg.SoundPlay.freq);
-      SCHANNEL_CR(channel) = SCHANNEL_ENABLE | SOUND_VOL(msg.SoundPlay.volume) | SOUND_PAN(msg.SoundPlay.pan) | ((msg.SoundPlay.format & 0xF) << 29) | (msg.SoundPlay.loop ? SOUND_REPEAT : SOUND_ONE_SHOT);
+      soundEmuStartChannel(channel, &msg, msg.SoundPlay.data);
+      break;
+
+    case EMUARM7_SYNTH_SND:
+      // The ARM9 hands us the shared log/ring and we make the TIA sound from here on
+      soundEmuSynthStop();
+      channel = (msg.SoundPlay.format & 0xF0)>>4;
+      synthFreq = msg.SoundPlay.freq;
+      synthShared = (TiaSynthShared *)msg.SoundPlay.data;
+      synthShared->tail = synthShared->head;     // Anything still in the log belongs to the last game
+      memset(synthShared->ring, 0x00, sizeof(synthShared->ring));
+      TiaSynth_init(&synth, TIA_SYNTH_CLOCK, synthFreq, synthShared->bit9);
+      TiaSynth_bandlimit(&synth, synthShared->bandlimited);
+      synthFrameSamples = synthShared->frame_samples;
+      synthRingIdx = 2 * synthFrameSamples;      // Start two frames ahead of the channel
+      synthPlayed = 0;                           // Put right by the first end of frame we play
+
+      // TIMER2 divides down to the sample rate and TIMER3 counts the samples the channel has played.
+      // The channel timer ticks at half the bus clock so twice its divider is exactly one sample
+      // for TIMER2 - TIMER_FREQ() works off a slightly different clock and would slowly drift.
+      TIMER3_DATA = 0;
+      TIMER3_CR = TIMER_CASCADE | TIMER_ENABLE;
+      TIMER2_DATA = 2*SOUND_FREQ(synthFreq);
+      soundEmuStartChannel(channel, &msg, synthShared->ring);
+      TIMER2_CR = TIMER_DIV_1 | TIMER_ENABLE;
+
+      // And the log is played a thousand times a second
+      TIMER1_DATA = TIMER_FREQ(1000);
+      TIMER1_CR = TIMER_DIV_1 | TIMER_IRQ_REQ | TIMER_ENABLE;
+      irqSet(IRQ_TIMER1, soundEmuSynthUpdate);
+      irqEnable(IRQ_TIMER1);
       break;
    
     case EMUARM7_INIT_SND:
       break;
 
     case EMUARM7_STOP_SND:
+      soundEmuSynthStop();
       break;
   }
 }
@@ -51,6 +51,16 @@
 
 #define VERSION "8.0"
 
+#if defined(DS_AUDIO_PACING) && !defined(TIA_SOUND_BLOCKS) && !defined(TIA_SOUND_ARM7) && !defined(TIA_SOUND_WAVE_LOG)
+#error "DS_AUDIO_PACING needs one of the ring sound options in TIASound.hxx"
+#endif
+
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_WAVE_LOG)
+// The sound channel's timer divider for a sample rate - as the ARM7's SOUND_FREQ() (libnds only has it there).
+// The channel timer ticks at half the bus clock so twice this in TIMER2 at TIMER_DIV_1 is exactly one sample.
+#define CHANNEL_FREQ(n) (-0x1000000 / (n))
+#endif
+
 #define MAX_RESISTANCE  1030000
 #define MIN_RESISTANCE  70000
 
@@ -121,6 +131,15 @@ static void DumpDebugData(void)
             j++;
         }
     }
+    for (int i=0; (i<256*256) && (j<17); i++)   // Then the busiest pairs of ops (shown as previous op, op)
+    {
+        if (profiler_pairs[i] > 10000000)
+        {
+            debug[j] = profiler_pairs[i];
+            debug[20+j] = i;
+            j++;
+        }
+    }
 #endif
 
     for (int i=0; i<17; i++)
@@ -268,6 +287,12 @@ void dsWarnIncompatibileCart(void)
     bHaltEmulation = 1; // And force the game to not run 
 }
 
+void dsWarnOutOfMemory(void)
+{
+    dsPrintValue(5,0,0, (char*)"NOT ENOUGH MEMORY FOR CART");
+    bHaltEmulation = 1; // And force the game to not run 
+}
+
 void dsPrintCartType(char *type, int size)
 {
     if (DEBUG_DUMP)
@@ -285,6 +310,9 @@ void dsShowScreenEmu(void)
     
   bg0 = bgInit(3, BgType_Bmp8, BgSize_B8_256x256, 0,0);
   memset((void*)0x06000000, 0x00, 128*1024);
+#ifdef TIA_DIRTY_LINES
+  theTIA.invalidateScreen();
+#endif
 
   REG_BG3PA = (((A26_VID_WIDTH / 256) << 8) | (A26_VID_WIDTH % 256)) - myCartInfo.xStretch;
   REG_BG3PB = 0; REG_BG3PC = 0;
@@ -537,6 +565,11 @@ bool dsLoadGame(char *filename)
 
         memset(sound_buffer, 0x00, SOUND_SIZE);
         
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+        if (!dsInstallSoundRingFIFO())  // Sets up the carts that make their sound without any interrupts
+        {
+            dsInstallSoundEmuFIFO();    // Back to the little hold buffer that the interrupt writes into
+#endif
         TIMER2_DATA = TIMER_FREQ((myCartInfo.soundQuality == SOUND_WAVE) ? (mySoundFreq+75) : mySoundFreq); // For Wave Direct we run a little faster so as always to keep sampling ahead of TIA output
         TIMER2_CR = TIMER_DIV_1 | TIMER_IRQ_REQ | TIMER_ENABLE;
         if (myCartInfo.soundQuality == SOUND_WAVE)
@@ -547,6 +580,9 @@ bool dsLoadGame(char *filename)
         {
             irqSet(IRQ_TIMER2, Tia_process);
         }
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+        }
+#endif
         
         if (myCartInfo.soundQuality)
         {
@@ -1016,6 +1052,93 @@ void dsInstallSoundEmuFIFO(void)
     fifoSendDatamsg(FIFO_USER_01, sizeof(msg), (u8*)&msg);
 }
 
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+//---------------------------------------------------------------------------------
+// Same channel as above but looping over a whole ring of samples at the sample
+// rate rather than over a single sample at 44.1kHz - so no sound interrupts.
+// Returns false for the carts that still need the TIMER2 interrupt (mute, and
+// WAVE DIRECT unless it's logged) so the caller can set that up instead.
+//---------------------------------------------------------------------------------
+bool dsInstallSoundRingFIFO(void)
+{
+    uint32 uncached = isDSiMode() ? 0xA000000 : 0x00400000;
+    FifoMessage msg;
+
+    msg.SoundPlay.freq = mySoundFreq;
+    msg.SoundPlay.volume = 127;
+    msg.SoundPlay.pan = 64;
+    msg.SoundPlay.loop = 1;
+    msg.SoundPlay.format = ((1)<<4) | SoundFormat_16Bit;
+    msg.SoundPlay.loopPoint = 0;
+
+#ifdef TIA_SOUND_WAVE_LOG
+    // ------------------------------------------------------------------------------------
+    // WAVE DIRECT makes a whole frame of sound into its ring at the end of each frame. The
+    // timers are just as for the block sound - TIMER3 counts the samples played, with
+    // TIMER2 on the channel's own divider so one count is exactly one sample.
+    // ------------------------------------------------------------------------------------
+    TIMER3_CR = 0;
+    if (bWaveLogSound)
+    {
+        tia_wave_ring = (uInt16*)((uint32)&tia_wave_ring_buffer[0] + uncached);
+        TIMER3_DATA = 0;
+        TIMER3_CR = TIMER_CASCADE | TIMER_ENABLE;
+        TIMER2_DATA = 2*CHANNEL_FREQ(mySoundFreq);
+        TIMER2_CR = TIMER_DIV_1 | TIMER_ENABLE;
+
+        msg.SoundPlay.data = &tia_wave_ring_buffer;
+        msg.SoundPlay.dataSize = sizeof(tia_wave_ring_buffer) >> 2;
+        msg.type = EMUARM7_PLAY_SND;
+        fifoSendDatamsg(FIFO_USER_01, sizeof(msg), (u8*)&msg);
+        return true;
+    }
+#endif
+
+#if defined(TIA_SOUND_BLOCKS)
+    // ------------------------------------------------------------------------------------
+    // The TIA fills the ring as it runs. TIMER2 divides down to the sample rate and TIMER3
+    // counts the samples played so the TIA can tell how far ahead of the hardware it is.
+    // TIMER2 is loaded from the channel's own divider (the channel timer ticks at half the
+    // bus clock) and not TIMER_FREQ() - that works off a slightly different clock and would
+    // count about 0.1% fast, so the ring would slowly lap the channel without us seeing it.
+    // ------------------------------------------------------------------------------------
+    TIMER3_CR = 0;
+    if (!bBlockSound) return false;
+
+    tia_ring = (uInt16*)((uint32)&tia_ring_buffer[0] + uncached);
+    TIMER3_DATA = 0;
+    TIMER3_CR = TIMER_CASCADE | TIMER_ENABLE;
+    TIMER2_DATA = 2*CHANNEL_FREQ(mySoundFreq);
+    TIMER2_CR = TIMER_DIV_1 | TIMER_ENABLE;
+
+    msg.SoundPlay.data = &tia_ring_buffer;
+    msg.SoundPlay.dataSize = sizeof(tia_ring_buffer) >> 2;
+    msg.type = EMUARM7_PLAY_SND;
+#elif defined(TIA_SOUND_ARM7)
+    // ------------------------------------------------------------------------------------
+    // The ARM7 plays the AUDx writes we log through its own copy of the sound core into
+    // the ring and starts the channel along with its own sample counter. Everything the
+    // ARM7 needs is in main RAM - make sure none of it is sitting in our cache.
+    // ------------------------------------------------------------------------------------
+    if (!bArm7Sound) return false;
+
+    tia_synth = (TiaSynthShared*)((uint32)&tia_synth_shared + uncached);
+    DC_FlushRange(&tia_synth_shared, sizeof(tia_synth_shared));
+    DC_FlushRange(Bit9, sizeof(Bit9));
+
+    msg.SoundPlay.data = &tia_synth_shared;
+    msg.SoundPlay.dataSize = sizeof(tia_synth_shared.ring) >> 2;
+    msg.type = EMUARM7_SYNTH_SND;
+#else
+    return false;
+#endif
+
+    fifoSendDatamsg(FIFO_USER_01, sizeof(msg), (u8*)&msg);
+
+    return true;
+}
+#endif
+
 __attribute__((noinline)) void ProcessAtariKeypad(void)
 {
     touchPosition touch;
@@ -1142,6 +1265,50 @@ static u16 info_dampen=0;
 static u16 driving_dampen = 0;
 static uInt8 bSelectOrResetWasPressed = 0;
 
+#ifdef DS_AUDIO_PACING
+//---------------------------------------------------------------------------------
+// Pace the frame off the sound hardware. The ring is played at exactly the sample
+// rate so keeping it two frames ahead of the hardware keeps us at exactly the
+// rate the sound is played at. If it's further ahead than that we sleep for the
+// difference - TIMER0 is turned into a one-shot that wakes us with its interrupt
+// - and if it's behind we don't sleep at all. TIMER0 is left counting from zero
+// again afterwards so the TIMER0 pacing picks up cleanly if it's ever needed.
+// Returns false if this cart's sound doesn't go through a ring.
+//---------------------------------------------------------------------------------
+static void dsAudioWake(void)
+{
+}
+
+bool dsAudioPacing(void)
+{
+    Int16 ahead;
+    if (!Tia_sound_ring_ahead(&ahead)) return false;
+
+    Int32 excess = ahead - (2 * tia_frame_samples);
+    if (excess > 0)
+    {
+        uint32 ticks = ((uint32)excess * 32728) / mySoundFreq;   // DIV_1024 is 32,728.5 ticks per second
+        if (ticks)
+        {
+            TIMER0_CR = 0;
+            TIMER0_DATA = 0x10000 - ticks;
+            irqSet(IRQ_TIMER0, dsAudioWake);
+            irqEnable(IRQ_TIMER0);
+            TIMER0_CR = TIMER_ENABLE | TIMER_DIV_1024 | TIMER_IRQ_REQ;
+            swiIntrWait(1, IRQ_TIMER0);
+            irqDisable(IRQ_TIMER0);
+        }
+    }
+
+    TIMER0_CR = 0;
+    TIMER0_DATA = 0;
+    TIMER0_CR = TIMER_ENABLE | TIMER_DIV_1024;
+    atari_frames = 0;
+
+    return true;
+}
+#endif
+
 ITCM_CODE void dsMainLoop(void)
 {
     uInt16 keys_pressed;
@@ -1186,33 +1353,38 @@ ITCM_CODE void dsMainLoop(void)
 
         case STELLADS_PLAYGAME:
         
-            // ------------------------------------------------------------------------------------
-            // If we get above 50K, that means we've fallen way behind - so just unthrottle until
-            // the next 50/60 frame mark. If we don't do this and we do wrap the timer at at 64K,
-            // we will end up with a pause/gap in play as we catch back up to the frame counter.
-            // ------------------------------------------------------------------------------------
-            if (TIMER0_DATA > 50000)
-            {   
-                temp_full_speed = 1; 
-            }
-        
-            // 32,728.5 ticks = 1 second
-            // 1 frame = 1/50 or 1/60 (0.02 or 0.016)
-            // 655 -> 50 fps and 546 -> 60 fps
-            if ((full_speed || temp_full_speed) == 0)
+#ifdef DS_AUDIO_PACING
+            if (full_speed || !dsAudioPacing())
+#endif
             {
-                while(TIMER0_DATA < ((myCartInfo.tv_type ? 655:546)*atari_frames))
-                    ;
-            }
+                // ------------------------------------------------------------------------------------
+                // If we get above 50K, that means we've fallen way behind - so just unthrottle until
+                // the next 50/60 frame mark. If we don't do this and we do wrap the timer at at 64K,
+                // we will end up with a pause/gap in play as we catch back up to the frame counter.
+                // ------------------------------------------------------------------------------------
+                if (TIMER0_DATA > 50000)
+                {   
+                    temp_full_speed = 1; 
+                }
+            
+                // 32,728.5 ticks = 1 second
+                // 1 frame = 1/50 or 1/60 (0.02 or 0.016)
+                // 655 -> 50 fps and 546 -> 60 fps
+                if ((full_speed || temp_full_speed) == 0)
+                {
+                    while(TIMER0_DATA < ((myCartInfo.tv_type ? 655:546)*atari_frames))
+                        ;
+                }
 
-            // Have we processed 50/60 frames... start over...
-            if (++atari_frames == (myCartInfo.tv_type ? 50:60))
-            {
-                TIMER0_CR=0;
-                TIMER0_DATA=0;
-                TIMER0_CR=TIMER_ENABLE|TIMER_DIV_1024;
-                atari_frames=0;
-                temp_full_speed = 0;
+                // Have we processed 50/60 frames... start over...
+                if (++atari_frames == (myCartInfo.tv_type ? 50:60))
+                {
+                    TIMER0_CR=0;
+                    TIMER0_DATA=0;
+                    TIMER0_CR=TIMER_ENABLE|TIMER_DIV_1024;
+                    atari_frames=0;
+                    temp_full_speed = 0;
+                }
             }
                 
             // Wait for keys
@@ -1672,6 +1844,12 @@ ITCM_CODE void dsMainLoop(void)
             {
                 dsPrintFPS();
             }
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+            // Let the user know if we had to skip drawing any frames in the last second
+            static uInt32 lastFramesSkipped = 0;
+            dsPrintValue(25,0,0, (gFramesSkipped != lastFramesSkipped) ? (char *)"SKP" : (char *)"   ");
+            lastFramesSkipped = gFramesSkipped;
+#endif
             if (gSaveKeyIsDirty)
             {
                 gSaveKeyEEprom->WriteEEtoFile();
@@ -1945,7 +2123,17 @@ ITCM_CODE void dsMainLoop(void)
         // -------------------------------------------------------------
         // Now, here, at the bottom of the world - update the frame! 
         // -------------------------------------------------------------
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+        // Time the frame against the 1/50 or 1/60 sec it has so the TIA knows when to skip drawing
+        if (!bHaltEmulation)
+        {
+            uInt16 frame_start = TIMER1_DATA;
+            theConsole->update();
+            tiaFrameTime((uInt16)(TIMER1_DATA - frame_start), full_speed ? 0 : (myCartInfo.tv_type ? 655:546));
+        }
+#else
         if (!bHaltEmulation) theConsole->update();
+#endif
         break;
         }
     }
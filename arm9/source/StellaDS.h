@@ -7,6 +7,18 @@
 
 #define WAITVBL swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank(); swiWaitForVBlank();
 
+// ---------------------------------------------------------------------------------
+// Uncomment this to pace the frames off the sound hardware rather than TIMER0 for
+// the carts whose sound goes into a ring (TIA_SOUND_BLOCKS, TIA_SOUND_ARM7 and/or
+// TIA_SOUND_WAVE_LOG in TIASound.hxx). Instead of spinning on TIMER0 each frame we
+// sleep until the ring is down to two frames ahead of what has been played. What
+// has been played is counted by TIMER3, which is clocked off the channel's own
+// divider (see dsInstallSoundRingFIFO()) so the emulation follows the rate the
+// sound is really played at - as long as the DS can keep up, the ring doesn't need
+// resyncing. Carts without a ring (mute) are still paced off TIMER0.
+// ---------------------------------------------------------------------------------
+//#define DS_AUDIO_PACING   TRUE
+
 #define STELLADS_MENUINIT 0x01
 #define STELLADS_MENUSHOW 0x02
 #define STELLADS_PLAYINIT 0x03 
@@ -17,6 +29,7 @@ typedef enum {
   EMUARM7_INIT_SND = 0x123C,
   EMUARM7_STOP_SND = 0x123D,
   EMUARM7_PLAY_SND = 0x123E,
+  EMUARM7_SYNTH_SND = 0x123F,
 } FifoMesType;
 
 #define MAX_ROMS_PER_DIRECTORY  1500
@@ -68,6 +81,10 @@ extern void dsPrintValue(int x, int y, unsigned int isSelect, char *pchStr);
 extern void dsMainLoop(void);
 
 extern void dsInstallSoundEmuFIFO(void);
+extern bool dsInstallSoundRingFIFO(void);
+#ifdef DS_AUDIO_PACING
+extern bool dsAudioPacing(void);
+#endif
 
 extern void vcsFindFiles(void);
 
@@ -0,0 +1,380 @@
+/*****************************************************************************/
+/*                                                                           */
+/* Module:  TIA Chip Sound Synthesiser (register log driven)                 */
+/* Purpose: The TIA Chip Sound Simulator divide/poly state machine with all  */
+/*          of its state in one structure and no DS specifics, so the same   */
+/*          code can run on the ARM7 (fed from the ARM9 over a shared FIFO)  */
+/*          and on a PC (fed from a recorded register log).                  */
+/* Author:  Ron Fries - adapted for StellaDS by Dave Bernazzani              */
+/*                                                                           */
+/*****************************************************************************/
+/*                                                                           */
+/*                 License Information and Copyright Notice                  */
+/*                 ========================================                  */
+/*                                                                           */
+/* TiaSound is Copyright(c) 1996 by Ron Fries                                */
+/*                                                                           */
+/* This library is free software; you can redistribute it and/or modify it   */
+/* under the terms of version 2 of the GNU Library General Public License    */
+/* as published by the Free Software Foundation.                             */
+/*                                                                           */
+/* This library is distributed in the hope that it will be useful, but       */
+/* WITHOUT ANY WARRANTY; without even the implied warranty of                */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library */
+/* General Public License for more details.                                  */
+/* To obtain a copy of the GNU Library General Public License, write to the  */
+/* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.   */
+/*                                                                           */
+/* Any permitted reproduction of these routines, in whole or in part, must   */
+/* bear this legend.                                                         */
+/*                                                                           */
+/*****************************************************************************/
+#include <string.h>
+#include "TIASynth.h"
+
+/* definitions for AUDCx - see TIASound.cpp for the full list */
+#define VOL_ONLY     0x00
+#define POLY9        0x08
+#define DIV3_MASK    0x0c
+
+#define POLY4_SIZE   0x000f
+#define POLY5_SIZE   0x001f
+#define POLY9_SIZE   0x01ff
+
+/* The same bit patterns as TIASound.cpp - see there for the details */
+static const uint8_t Bit4[POLY4_SIZE] =
+      { 0xff,0xff,0,0xff,0xff,0xff,0,0,0,0,0xff,0,0xff,0,0 };
+
+static const uint8_t Bit5[POLY5_SIZE] =
+      { 0,0,1,0,1,1,0,0,1,1,1,1,1,0,0,0,1,1,0,1,1,1,0,1,0,1,0,0,0,0,1 };
+
+static const uint8_t Bit5a[POLY5_SIZE] =
+      { 0,0,0xff,0,0xff,0xff,0,0,0xff,0xff,0xff,0xff,0xff,0,0,0,0xff,0xff,0,0xff,0xff,0xff,0,0xff,0,0xff,0,0,0,0,0xff };
+
+static const uint8_t Div31[POLY5_SIZE] =
+      { 0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0 };
+
+/* A band-limited step (a Kaiser windowed sinc with beta 7 and a cutoff of */
+/* 0.42 of the output rate, integrated) as the differences between one     */
+/* output sample and the next, for a step that lands phase/32 of a sample  */
+/* before the output sample in slot 0. Each row adds up to exactly 1<<14.  */
+static const int16_t BlipStep[TIA_BLIP_PHASES][TIA_BLIP_TAPS] =
+    {
+      { 0,1,3,-12,29,-45,48,-19,-58,183,-332,452,-463,264,282,-1541,
+        9400,9401,-1541,282,264,-463,452,-332,183,-58,-19,48,-45,29,-12,3 },
+      { 0,1,2,-12,29,-47,53,-28,-45,171,-329,467,-505,342,166,-1388,
+        9746,9042,-1674,393,186,-418,435,-334,193,-70,-9,42,-43,28,-13,3 },
+      { 0,1,2,-11,28,-49,59,-38,-32,158,-323,478,-545,420,44,-1217,
+        10074,8670,-1789,498,108,-371,415,-332,202,-81,0,36,-40,28,-13,4 },
+      { 0,1,1,-10,28,-50,64,-48,-18,143,-315,487,-583,497,-81,-1028,
+        10391,8286,-1886,596,31,-323,393,-329,209,-92,9,31,-37,27,-14,4 },
+      { 0,2,0,-9,28,-51,68,-57,-3,127,-304,492,-616,572,-209,-820,
+        10684,7893,-1965,688,-44,-273,368,-324,215,-102,18,25,-35,26,-14,4 },
+      { 0,2,0,-8,27,-52,72,-67,11,110,-291,494,-647,645,-341,-593,
+        10961,7491,-2026,772,-117,-223,341,-316,219,-110,27,19,-32,25,-14,5 },
+      { 0,2,-1,-7,26,-53,76,-76,26,92,-276,493,-673,715,-474,-349,
+        11214,7083,-2069,848,-187,-172,313,-306,222,-118,35,13,-28,24,-14,5 },
+      { 0,3,-2,-6,25,-53,80,-85,42,72,-258,488,-696,782,-608,-87,
+        11451,6669,-2097,916,-255,-121,283,-295,222,-125,43,7,-25,23,-14,5 },
+      { 0,3,-3,-5,23,-52,83,-94,57,52,-239,479,-713,845,-741,191,
+        11662,6251,-2107,976,-319,-70,252,-281,222,-131,50,1,-22,22,-13,5 },
+      { -1,3,-3,-3,21,-52,85,-102,72,31,-217,468,-727,904,-875,487,
+        11853,5831,-2103,1028,-380,-20,219,-266,220,-136,57,-4,-18,20,-13,5 },
+      { -1,4,-4,-2,20,-51,87,-109,87,9,-193,452,-735,957,-1006,798,
+        12018,5410,-2083,1071,-436,29,186,-250,216,-139,63,-10,-15,19,-13,5 },
+      { -1,4,-5,0,18,-49,89,-116,102,-14,-167,433,-739,1006,-1134,1124,
+        12158,4990,-2050,1106,-489,78,152,-232,211,-142,68,-15,-12,17,-12,5 },
+      { -1,4,-6,1,15,-48,90,-123,116,-36,-140,411,-737,1048,-1259,1464,
+        12279,4571,-2003,1132,-537,124,118,-213,205,-144,73,-20,-8,15,-12,5 },
+      { -1,4,-7,3,13,-45,90,-128,130,-59,-111,385,-731,1085,-1379,1818,
+        12365,4157,-1944,1149,-580,169,84,-193,197,-144,78,-24,-5,14,-11,5 },
+      { -1,5,-7,5,10,-43,89,-133,143,-82,-81,356,-719,1114,-1493,2183,
+        12434,3747,-1873,1158,-618,211,50,-172,188,-144,81,-29,-2,12,-10,5 },
+      { -1,5,-8,7,7,-40,88,-137,156,-105,-50,324,-701,1137,-1601,2560,
+        12473,3343,-1792,1159,-651,252,16,-150,178,-143,84,-33,2,10,-10,5 },
+      { -1,5,-9,8,5,-37,87,-140,168,-128,-17,289,-679,1152,-1701,2947,
+        12485,2947,-1701,1152,-679,289,-17,-128,168,-140,87,-37,5,8,-9,5 },
+      { -1,5,-10,10,2,-33,84,-143,178,-150,16,252,-651,1159,-1792,3343,
+        12473,2560,-1601,1137,-701,324,-50,-105,156,-137,88,-40,7,7,-8,5 },
+      { -1,5,-10,12,-2,-29,81,-144,188,-172,50,211,-618,1158,-1873,3747,
+        12434,2183,-1493,1114,-719,356,-81,-82,143,-133,89,-43,10,5,-7,5 },
+      { -1,5,-11,14,-5,-24,78,-144,197,-193,84,169,-580,1149,-1944,4157,
+        12365,1818,-1379,1085,-731,385,-111,-59,130,-128,90,-45,13,3,-7,4 },
+      { -1,5,-12,15,-8,-20,73,-144,205,-213,118,124,-537,1132,-2003,4571,
+        12279,1464,-1259,1048,-737,411,-140,-36,116,-123,90,-48,15,1,-6,4 },
+      { -1,5,-12,17,-12,-15,68,-142,211,-232,152,78,-489,1106,-2050,4990,
+        12158,1124,-1134,1006,-739,433,-167,-14,102,-116,89,-49,18,0,-5,4 },
+      { -1,5,-13,19,-15,-10,63,-139,216,-250,186,29,-436,1071,-2083,5410,
+        12018,798,-1006,957,-735,452,-193,9,87,-109,87,-51,20,-2,-4,4 },
+      { -1,5,-13,20,-18,-4,57,-136,220,-266,219,-20,-380,1028,-2103,5831,
+        11853,487,-875,904,-727,468,-217,31,72,-102,85,-52,21,-3,-3,3 },
+      { 0,5,-13,22,-22,1,50,-131,222,-281,252,-70,-319,976,-2107,6251,
+        11662,191,-741,845,-713,479,-239,52,57,-94,83,-52,23,-5,-3,3 },
+      { 0,5,-14,23,-25,7,43,-125,222,-295,283,-121,-255,916,-2097,6669,
+        11451,-87,-608,782,-696,488,-258,72,42,-85,80,-53,25,-6,-2,3 },
+      { 0,5,-14,24,-28,13,35,-118,222,-306,313,-172,-187,848,-2069,7083,
+        11214,-349,-474,715,-673,493,-276,92,26,-76,76,-53,26,-7,-1,2 },
+      { 0,5,-14,25,-32,19,27,-110,219,-316,341,-223,-117,772,-2026,7491,
+        10961,-593,-341,645,-647,494,-291,110,11,-67,72,-52,27,-8,0,2 },
+      { 0,4,-14,26,-35,25,18,-102,215,-324,368,-273,-44,688,-1965,7893,
+        10684,-820,-209,572,-616,492,-304,127,-3,-57,68,-51,28,-9,0,2 },
+      { 0,4,-14,27,-37,31,9,-92,209,-329,393,-323,31,596,-1886,8286,
+        10391,-1028,-81,497,-583,487,-315,143,-18,-48,64,-50,28,-10,1,1 },
+      { 0,4,-13,28,-40,36,0,-81,202,-332,415,-371,108,498,-1789,8670,
+        10074,-1217,44,420,-545,478,-323,158,-32,-38,59,-49,28,-11,2,1 },
+      { 0,3,-13,28,-43,42,-9,-70,193,-334,435,-418,186,393,-1674,9042,
+        9746,-1388,166,342,-505,467,-329,171,-45,-28,53,-47,29,-12,2,1 }
+    };
+
+// -----------------------------------------------------------------------------------------
+// Same power-up state as Tia_sound_init() - sample_freq is the '30 Khz' TIA audio clock
+// and playback_freq the rate the samples are wanted at.
+// -----------------------------------------------------------------------------------------
+void TiaSynth_init(TiaSynth *synth, uint16_t sample_freq, uint16_t playback_freq, const uint8_t *bit9)
+{
+    memset(synth, 0x00, sizeof(TiaSynth));
+    synth->samp_n_max = (uint16_t)(((uint32_t)sample_freq<<8)/playback_freq);
+    synth->samp_n_cnt = 256;
+    synth->bit9 = bit9;
+}
+
+// -----------------------------------------------------------------------------------------
+// Switch the band-limited output on or off (after TiaSynth_init). Just taking the level
+// every Nth audio clock - which is all the sample counter does - folds everything in the
+// TIA's square waves above half the output rate back down as aliasing, which is why the
+// lower sample rates sound so rough. With this on, every change of level is added into
+// the output as a band-limited step placed where it falls between two output samples,
+// and the samples are the running sum of the steps. It costs TIA_BLIP_TAPS adds for each
+// change of level and delays the sound by TIA_BLIP_TAPS/2 samples.
+// -----------------------------------------------------------------------------------------
+void TiaSynth_bandlimit(TiaSynth *synth, uint32_t enable)
+{
+    synth->bandlimited = enable;
+    synth->blip_scale = (TIA_BLIP_PHASES << 16) / synth->samp_n_max;
+    synth->blip_level = (synth->outvol[0] + synth->outvol[1]) << 7;
+    synth->blip_pos = 0;
+    synth->blip_sum = (int32_t)(synth->blip_level << TIA_BLIP_BITS);
+    memset(synth->blip_buf, 0x00, sizeof(synth->blip_buf));
+}
+
+// -----------------------------------------------------------------------------------------
+// Add a step if the level has changed. count is the sample counter as it was when the
+// change happened - the next sample was then (count-256)/samp_n_max of a sample away.
+// -----------------------------------------------------------------------------------------
+static void TiaSynth_step(TiaSynth *synth, uint32_t count)
+{
+    uint32_t level = (synth->outvol[0] + synth->outvol[1]) << 7;
+    if (level == synth->blip_level) return;
+
+    int32_t delta = (int32_t)level - (int32_t)synth->blip_level;
+    synth->blip_level = level;
+
+    uint32_t phase = ((count - 256) * synth->blip_scale) >> 16;
+    if (phase >= TIA_BLIP_PHASES) phase = TIA_BLIP_PHASES-1;
+
+    const int16_t *step = BlipStep[phase];
+    for (uint32_t i = 0; i < TIA_BLIP_TAPS; i++)
+    {
+        synth->blip_buf[(synth->blip_pos + i) & (TIA_BLIP_SIZE-1)] += delta * step[i];
+    }
+}
+
+// -----------------------------------------------------------------------------------------
+// The next band-limited output sample - clipped as the steps ring a little past the ends.
+// -----------------------------------------------------------------------------------------
+static inline uint16_t TiaSynth_blip(TiaSynth *synth)
+{
+    int32_t *slot = &synth->blip_buf[synth->blip_pos++ & (TIA_BLIP_SIZE-1)];
+    synth->blip_sum += *slot;
+    *slot = 0;
+
+    int32_t sample = synth->blip_sum >> TIA_BLIP_BITS;
+    if (sample > 32767) sample = 32767;
+    else if (sample < -32768) sample = -32768;
+    return (uint16_t)sample;
+}
+
+// -----------------------------------------------------------------------------------------
+// Update_tia_sound() for one channel - pre-calculate the divide by N from AUDC/AUDF/AUDV.
+// -----------------------------------------------------------------------------------------
+static void TiaSynth_update(TiaSynth *synth, uint8_t chan)
+{
+    uint16_t new_val;
+
+    /* an AUDC value of 0 is a special case */
+    if (synth->audc[chan] == VOL_ONLY)
+    {
+        /* indicate the clock is zero so no processing will occur */
+        new_val = 0;
+
+        /* and set the output to the selected volume */
+        synth->outvol[chan] = synth->audv[chan];
+    }
+    else
+    {
+        /* otherwise calculate the 'divide by N' value */
+        new_val = synth->audf[chan] + 1;
+
+        /* if bits 2 & 3 are set, then multiply the 'div by n' count by 3 */
+        if ((synth->audc[chan] & DIV3_MASK) == DIV3_MASK)
+        {
+            new_val *= 3;
+        }
+    }
+
+    /* only reset those channels that have changed */
+    if (new_val != synth->div_n_max[chan])
+    {
+        /* reset the divide by n counters */
+        synth->div_n_max[chan] = new_val;
+
+        /* if the channel is now volume only or was volume only */
+        if ((synth->div_n_cnt[chan] == 0) || (new_val == 0))
+        {
+            /* reset the counter (otherwise let it complete the previous) */
+            synth->div_n_cnt[chan] = new_val;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------
+// One tick of the audio clock for one channel - exactly as Tia_tick() in TIASound.cpp.
+// -----------------------------------------------------------------------------------------
+static inline void TiaSynth_tick(TiaSynth *synth, uint8_t chan)
+{
+    if (synth->div_n_cnt[chan] > 1)
+    {
+        synth->div_n_cnt[chan]--;
+    }
+    else if (synth->div_n_cnt[chan] == 1)
+    {
+        uint8_t audc = synth->audc[chan];
+
+        synth->div_n_cnt[chan] = synth->div_n_max[chan];
+
+        if (++synth->p5[chan] == POLY5_SIZE) synth->p5[chan] = 0;
+
+        /* check clock modifier for clock tick */
+        if  ( ((audc & 0x02) == 0) ||
+              (((audc & 0x01) == 0) && Div31[synth->p5[chan]]) ||
+              (((audc & Bit5[synth->p5[chan]]))) )
+        {
+            if (audc & 0x04)       /* pure modified clock selected */
+            {
+                synth->outvol[chan] = (synth->outvol[chan] ? 0:synth->audv[chan]);
+            }
+            else if (audc & 0x08)
+            {
+                if (audc == POLY9)    /* check for poly9 */
+                {
+                    if (++synth->p9[chan] == POLY9_SIZE) synth->p9[chan] = 0;
+                    synth->outvol[chan] = synth->bit9[synth->p9[chan]] & synth->audv[chan];
+                }
+                else // Must be poly5
+                {
+                    synth->outvol[chan] = (Bit5a[synth->p5[chan]] & synth->audv[chan]);
+                }
+            }
+            else  /* poly4 is the only remaining option */
+            {
+                if (++synth->p4[chan] == POLY4_SIZE) synth->p4[chan] = 0;
+                synth->outvol[chan] = (Bit4[synth->p4[chan]] & synth->audv[chan]);
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------
+// Run the audio clock for a number of ticks. Between divider events the output of both
+// channels cannot change - each channel's waveform is a run of divide-by-N ticks at one
+// level - so rather than stepping a tick at a time we jump straight over the run, writing
+// out the samples that land in it, and only step a single tick the slow way when one of
+// the dividers runs out - a pure tone at AUDF=31 needs just one slow tick in every 32.
+// -----------------------------------------------------------------------------------------
+static uint32_t TiaSynth_run(TiaSynth *synth, uint32_t ticks, uint16_t *ring, uint32_t ring_mask, uint32_t *ring_idx)
+{
+    uint32_t samples = 0;
+
+    while (ticks)
+    {
+        /* ticks before either divider runs out (a count of 0 is volume only - never runs out) */
+        uint32_t run = ticks;
+        if (synth->div_n_cnt[0] && (synth->div_n_cnt[0] - 1) < run) run = synth->div_n_cnt[0] - 1;
+        if (synth->div_n_cnt[1] && (synth->div_n_cnt[1] - 1) < run) run = synth->div_n_cnt[1] - 1;
+
+        if (run)
+        {
+            /* every sample in the run is the same - the sample counter hits zero after cnt>>8 ticks */
+            uint16_t level = (uint16_t)((synth->outvol[0] + synth->outvol[1]) << 7);
+            uint32_t left = run;
+            while ((synth->samp_n_cnt >> 8) <= left)
+            {
+                left -= (synth->samp_n_cnt >> 8);
+                synth->samp_n_cnt = (synth->samp_n_cnt & 0xFF) + synth->samp_n_max;
+                ring[(*ring_idx)++ & ring_mask] = synth->bandlimited ? TiaSynth_blip(synth) : level;
+                samples++;
+            }
+            synth->samp_n_cnt -= (left << 8);
+
+            if (synth->div_n_cnt[0]) synth->div_n_cnt[0] -= run;
+            if (synth->div_n_cnt[1]) synth->div_n_cnt[1] -= run;
+
+            ticks -= run;
+            if (ticks == 0) break;
+        }
+
+        /* a divider runs out on this tick */
+        TiaSynth_tick(synth, 0);
+        TiaSynth_tick(synth, 1);
+        if (synth->bandlimited) TiaSynth_step(synth, synth->samp_n_cnt);
+        ticks--;
+
+        /* decrement the sample counter - value is 256 since the lower
+           byte contains the fractional part */
+        synth->samp_n_cnt -= 256;
+        if (synth->samp_n_cnt & 0xFF00) continue;
+        synth->samp_n_cnt += synth->samp_n_max;
+
+        ring[(*ring_idx)++ & ring_mask] = synth->bandlimited ? TiaSynth_blip(synth) : (uint16_t)((synth->outvol[0] + synth->outvol[1]) << 7);
+        samples++;
+    }
+
+    return samples;
+}
+
+// -----------------------------------------------------------------------------------------
+// Play one register log record: bring the sound up to the record's cycle (writing samples
+// into the ring) and then make the register change. Returns the number of samples made.
+// The sample values are the same as the ARM9 sampleExtender[] gives. The difference is
+// signed as a write early in a frame can come before the part of an audio clock that
+// was left over from the end of the last frame.
+// -----------------------------------------------------------------------------------------
+uint32_t TiaSynth_record(TiaSynth *synth, uint32_t record, uint16_t *ring, uint32_t ring_mask, uint32_t *ring_idx)
+{
+    uint32_t cycle = TIA_SYNTH_CYCLE(record);
+    uint32_t samples = 0;
+
+    if ((int32_t)(cycle - synth->cycle) >= TIA_SYNTH_CYCLES)
+    {
+        uint32_t ticks = (cycle - synth->cycle) / TIA_SYNTH_CYCLES;
+        synth->cycle += ticks * TIA_SYNTH_CYCLES;
+        samples = TiaSynth_run(synth, ticks, ring, ring_mask, ring_idx);
+    }
+
+    uint8_t value = TIA_SYNTH_VALUE(record);
+    switch (TIA_SYNTH_REG(record))
+    {
+        case 0: synth->audc[0] = value;      TiaSynth_update(synth, 0); break;
+        case 1: synth->audc[1] = value;      TiaSynth_update(synth, 1); break;
+        case 2: synth->audf[0] = value;      TiaSynth_update(synth, 0); break;
+        case 3: synth->audf[1] = value;      TiaSynth_update(synth, 1); break;
+        case 4: synth->audv[0] = value << 3; TiaSynth_update(synth, 0); break;
+        case 5: synth->audv[1] = value << 3; TiaSynth_update(synth, 1); break;
+        case TIA_SYNTH_FRAME: synth->cycle -= cycle; break;   // Cycles start over - keep any part of an audio clock left over
+    }
+
+    /* a volume only channel changes level right away */
+    if (synth->bandlimited) TiaSynth_step(synth, synth->samp_n_cnt + 256);
+
+    return samples;
+}
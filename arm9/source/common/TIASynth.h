@@ -0,0 +1,118 @@
+/*****************************************************************************/
+/*                                                                           */
+/* Module:  TIA Chip Sound Synthesiser (register log driven)                 */
+/* Purpose: The TIA Chip Sound Simulator divide/poly state machine with all  */
+/*          of its state in one structure and no DS specifics, so the same   */
+/*          code can run on the ARM7 (fed from the ARM9 over a shared FIFO)  */
+/*          and on a PC (fed from a recorded register log).                  */
+/* Author:  Ron Fries - adapted for StellaDS by Dave Bernazzani              */
+/*                                                                           */
+/*****************************************************************************/
+/*                                                                           */
+/*                 License Information and Copyright Notice                  */
+/*                 ========================================                  */
+/*                                                                           */
+/* TiaSound is Copyright(c) 1996 by Ron Fries                                */
+/*                                                                           */
+/* This library is free software; you can redistribute it and/or modify it   */
+/* under the terms of version 2 of the GNU Library General Public License    */
+/* as published by the Free Software Foundation.                             */
+/*                                                                           */
+/* This library is distributed in the hope that it will be useful, but       */
+/* WITHOUT ANY WARRANTY; without even the implied warranty of                */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library */
+/* General Public License for more details.                                  */
+/* To obtain a copy of the GNU Library General Public License, write to the  */
+/* Free Software Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.   */
+/*                                                                           */
+/* Any permitted reproduction of these routines, in whole or in part, must   */
+/* bear this legend.                                                         */
+/*                                                                           */
+/*****************************************************************************/
+
+#ifndef _TIASYNTH_H
+#define _TIASYNTH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------------------
+// A register log record is one 32-bit word so it can be handed between the two CPUs
+// without any locking:  [31:11] 6502 cycle within the frame  [10:8] register  [7:0] value
+// Registers 0-5 are AUDC0, AUDC1, AUDF0, AUDF1, AUDV0, AUDV1 (the TIA address less 0x15)
+// with the value already masked to the bits the TIA uses. The end of each frame is logged
+// too (with the frame's length as the cycle) since the 6502 cycle count starts over there.
+// The ARM9 numbers its end of frame records (in the value) so it can tell which frame the
+// ARM7 has got up to.
+// -----------------------------------------------------------------------------------------
+#define TIA_SYNTH_RECORD(cycle, reg, value)   ((((uint32_t)(cycle)) << 11) | ((reg) << 8) | (value))
+#define TIA_SYNTH_CYCLE(record)               ((record) >> 11)
+#define TIA_SYNTH_REG(record)                 (((record) >> 8) & 0x07)
+#define TIA_SYNTH_VALUE(record)               ((record) & 0xFF)
+
+#define TIA_SYNTH_FRAME         7       // Register number used for the end of frame record
+
+#define TIA_SYNTH_CLOCK         31400   // The TIA audio clock - twice per scanline
+#define TIA_SYNTH_CYCLES        38      // 6502 cycles per audio clock
+
+#define TIA_SYNTH_FIFO_SIZE     4096    // Records - must be a power of 2
+#define TIA_SYNTH_RING_SIZE     2048    // Samples - must be a power of 2
+
+#define TIA_BLIP_PHASES         32      // Band-limited steps: positions between two output samples
+#define TIA_BLIP_TAPS           32      // Band-limited steps: output samples each step is spread over
+#define TIA_BLIP_SIZE           64      // Band-limited steps: samples still being added to - a power of 2 > TAPS
+#define TIA_BLIP_BITS           14      // Band-limited steps: fraction bits of the step table
+
+typedef struct
+{
+    uint8_t  audc[2];           // AUDCx
+    uint8_t  audf[2];           // AUDFx
+    uint8_t  audv[2];           // AUDVx (scaled up by 8 as the ARM9 side does)
+    uint8_t  p4[2];             // Position in the 4-bit POLY array
+    uint8_t  p5[2];             // Position in the 5-bit POLY array
+    uint16_t p9[2];             // Position in the 9-bit POLY array
+    uint32_t div_n_cnt[2];      // Divide by n counter
+    uint32_t div_n_max[2];      // Divide by n maximum
+    uint32_t outvol[2];         // Last output volume for each channel
+    uint32_t samp_n_cnt;        // Sample counter (8 bits of fraction)
+    uint32_t samp_n_max;        // Audio clocks per output sample (8 bits of fraction)
+    uint32_t cycle;             // The 6502 cycle within the frame we've generated up to
+    const uint8_t *bit9;        // The 511 entry 0x00/0xFF poly9 table - random, so shared with the ARM9
+
+    uint32_t bandlimited;       // Output made from band-limited steps rather than just picked every Nth clock
+    uint32_t blip_scale;        // TIA_BLIP_PHASES/samp_n_max with 16 bits of fraction
+    uint32_t blip_level;        // The level the last step went to
+    uint32_t blip_pos;          // The slot in blip_buf[] the next sample is taken from
+    int32_t  blip_sum;          // Running sum of the steps - the output before it's scaled back down
+    int32_t  blip_buf[TIA_BLIP_SIZE];   // The steps still to come, one slot per output sample
+} TiaSynth;
+
+// -----------------------------------------------------------------------------------------
+// What the ARM9 and ARM7 share (in main RAM). The ARM9 only ever moves head and the ARM7
+// only ever moves tail - both run freely and are masked on use.
+// -----------------------------------------------------------------------------------------
+typedef struct
+{
+    volatile uint32_t head;                         // Next record the ARM9 will write
+    volatile uint32_t tail;                         // Next record the ARM7 will read
+    uint32_t records[TIA_SYNTH_FIFO_SIZE];          // Register log
+    uint16_t ring[TIA_SYNTH_RING_SIZE];             // Samples - looped over by the sound hardware
+    const uint8_t *bit9;                            // The ARM9's poly9 table
+    uint32_t bandlimited;                           // Set by the ARM9 to have the ARM7 use TiaSynth_bandlimit()
+    uint32_t frame_samples;                         // Set by the ARM9 - samples in one of this cart's frames (a 50th or 60th of a second)
+    volatile int32_t ahead;                         // Samples the ring was ahead of the channel at the ARM7's last look
+    volatile uint32_t played;                       // Where the ring had been made up to then - frame number and cycle as a TIA_SYNTH_RECORD()
+} TiaSynthShared;
+
+extern void     TiaSynth_init(TiaSynth *synth, uint16_t sample_freq, uint16_t playback_freq, const uint8_t *bit9);
+extern void     TiaSynth_bandlimit(TiaSynth *synth, uint32_t enable);
+extern uint32_t TiaSynth_record(TiaSynth *synth, uint32_t record, uint16_t *ring, uint32_t ring_mask, uint32_t *ring_idx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -41,27 +41,18 @@ uInt8 OptionPage = 0;
 void SaveConfig(bool bShow)
 {
     FILE *fp;
-    int slot = 0;
     
     if (bShow) dsPrintValue(0,23,0, (char*)"     SAVING CONFIGURATION       ");
 
     // Set the global configuration version number...
     allConfigs.config_ver = CONFIG_VER;
 
-    // Find the slot we should save into...
-    for (slot=0; slot<MAX_CONFIGS; slot++)
+    // Find the slot we should save into... the one this game already has or a blank one
+    Int16 slot = CartClaimConfigSlot(myCartInfo.md5);
+    if (slot >= 0)
     {
-        if (strcmp(allConfigs.cart[slot].md5, myCartInfo.md5) == 0)  // Got a match?!
-        {
-            break;                           
-        }
-        if (strcmp(allConfigs.cart[slot].md5, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx") == 0) // Didn't find it... use a blank slot...
-        {
-            break;                           
-        }
+        allConfigs.cart[slot] = myCartInfo;
     }
-
-    allConfigs.cart[slot] = myCartInfo;
     
     // Always copy back the Global Info
     allConfigs.global = myGlobalCartInfo;
@@ -137,6 +128,8 @@ static void WipeGameConfigsBackToDefault(void)
     allConfigs.global.global8 = 2;
     
     allConfigs.config_ver = CONFIG_VER;
+
+    CartIndexConfigs();
 }
 
 // -------------------------------------------------------------------------
@@ -157,6 +150,7 @@ void LoadConfig(void)
         if (allConfigs.config_ver == CONFIG_VER)
         {
             bInitDatabase = false;
+            CartIndexConfigs();
         }
     }
     
@@ -224,6 +218,7 @@ const struct options_t Game_Option_Table[2][20] =
         {"ARM THUMB",  0, {"SAFE", "OPTIMIZED", "OPT-NO-COLL", "MAX-FRAMESKIP"},                                                                                                          &myCartInfo.thumbOptimize,       4},
         {"BUS MODE",   0, {"OPTIMIZED", "ACCURATE"},                                                                                                                                      &myCartInfo.bus_driver,          2},
         {"6532 RAM",   0, {"RANDOM", "CLEAR (ZEROS)"},                                                                                                                                    &myCartInfo.clearRAM,            2},
+        {"IDLE SKIP",  0, {"ON (FASTER)", "OFF"},                                                                                                                                         &myCartInfo.noIdleSkip,          2},
         
         {"GLOB PALET", 0, {"DS OPTIMIZED", "STELLA", "Z26"},                                                                                                                              &myGlobalCartInfo.palette,       3},
         {"GLOB SOUND", 0, {"OFF (MUTE)", "10 kHZ", "15 kHZ", "20 kHZ", "30 kHZ", "WAVE DIRECT"},                                                                                          &myGlobalCartInfo.sound,         6},
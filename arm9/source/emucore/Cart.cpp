@@ -68,6 +68,8 @@
 #include "../config.h"
 
 extern void dsWarnIncompatibileCart(void);
+extern void dsWarnOutOfMemory(void);
+extern uInt8 *thumbDecoded;
 extern void dsPrintCartType(char *, int);
 
 extern uInt8 tv_type_requested;
@@ -99,7 +101,7 @@ uInt8  xl_ram_buffer[32768] __attribute__ ((aligned (4096)));
 #define VB 1        // Vertical Blank (1=zero the vertical blank... 0 or !VB is faster but may graphically cause glitching)
 #define HB 1        // Horizontal Blank (1=zero the horizontal blank... 0 or !HB is faster but may graphically cause glitching)
 
-const CartInfo table[] =
+constexpr CartInfo table[] =
 {
     {"DefaultCart_NTSCxxxxxxxxxxxxxxxx",  "??????", BANK_4K,   CTR_LJOY,      SPEC_NONE,      MODE_NO,    VB,   HB,  ANA1_0,  NTSC,  34,    210,   100,   0,  0},    // Default Cart is 4k, full-scale, L-Joy and nothing special...
     {"DefaultCart_PALxxxxxxxxxxxxxxxxx",  "??????", BANK_4K,   CTR_LJOY,      SPEC_NONE,      MODE_NO,    VB,   HB,  ANA1_0,  PAL,   52,    245,   100,   0,  0},    // Default PAL Cart is 4k, full-scale, L-Joy and nothing special...
@@ -2282,6 +2284,414 @@ const CartInfo table[] =
     {"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx",  "??????", BANK_2K,   CTR_LJOY,      99,             MODE_NO,    VB,   HB,  ANA1_0,  NTSC,  34,    210,   100,   0,  0}     // End of list...
 };
 
+// ---------------------------------------------------------------------------------------------------------
+// An MD5 as a 16 byte binary digest - four words read in the same order as the hex string so they sort the
+// same way. Anything that isn't 32 lowercase hex digits (the defaults, unused slots) has no digest.
+// ---------------------------------------------------------------------------------------------------------
+static constexpr bool CartDigestFromString(const char *md5, uInt32 digest[4])
+{
+  for (uInt8 i = 0; i < 32; i++)
+  {
+    char c = md5[i];
+    uInt32 nibble = 0;
+    if ((c >= '0') && (c <= '9'))      nibble = c - '0';
+    else if ((c >= 'a') && (c <= 'f')) nibble = c - 'a' + 10;
+    else return false;
+    digest[i >> 3] = (digest[i >> 3] << 4) | nibble;
+  }
+  return (md5[32] == 0);
+}
+
+static constexpr Int8 CartDigestCompare(const uInt32 a[4], const uInt32 b[4])
+{
+  for (uInt8 i = 0; i < 4; i++)
+  {
+    if (a[i] != b[i]) return (a[i] < b[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// The internal database sorted by digest (and then by position in the table so the first of any duplicates
+// is found first) for a binary search. Like the TIA tables, the compiler works this out for us.
+// ---------------------------------------------------------------------------------------------------------
+#define CART_DATABASE_SIZE  (sizeof(table) / sizeof(table[0]))
+
+struct CartDatabaseIndex
+{
+  uInt32 digest[CART_DATABASE_SIZE][4];
+  uInt16 entry[CART_DATABASE_SIZE];
+  uInt16 count;
+
+  constexpr bool less(uInt16 a, uInt16 b) const
+  {
+    Int8 order = CartDigestCompare(digest[a], digest[b]);
+    return (order < 0) || ((order == 0) && (entry[a] < entry[b]));
+  }
+
+  constexpr void swap(uInt16 a, uInt16 b)
+  {
+    for (uInt8 i = 0; i < 4; i++)
+    {
+      uInt32 d = digest[a][i]; digest[a][i] = digest[b][i]; digest[b][i] = d;
+    }
+    uInt16 e = entry[a]; entry[a] = entry[b]; entry[b] = e;
+  }
+
+  constexpr void siftDown(uInt16 root, uInt16 end)
+  {
+    while ((2*root + 1) < end)
+    {
+      uInt16 child = 2*root + 1;
+      if (((child + 1) < end) && less(child, child + 1)) child++;
+      if (!less(root, child)) break;
+      swap(root, child);
+      root = child;
+    }
+  }
+
+  constexpr CartDatabaseIndex() : digest(), entry(), count(0)
+  {
+    for (uInt16 i = 0; table[i].special != 99; i++)
+    {
+      if (CartDigestFromString(table[i].md5, digest[count]))
+      {
+        entry[count++] = i;
+      }
+    }
+
+    // Heapsort - it keeps the work (and so the compile time) down to n log n
+    for (uInt16 i = count / 2; i > 0; i--) siftDown(i - 1, count);
+    for (uInt16 end = count - 1; end > 0; end--)
+    {
+      swap(0, end);
+      siftDown(0, end);
+    }
+  }
+};
+
+static constexpr CartDatabaseIndex databaseIndex;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const CartInfo* CartFindInternalDatabase(const char *md5)
+{
+  uInt32 key[4] = {0};
+  if (!CartDigestFromString(md5, key)) return 0;
+
+  // Find the first index entry not below the key
+  uInt16 low = 0, high = databaseIndex.count;
+  while (low < high)
+  {
+    uInt16 mid = (low + high) >> 1;
+    if (CartDigestCompare(databaseIndex.digest[mid], key) < 0) low = mid + 1;
+    else high = mid;
+  }
+
+  if ((low < databaseIndex.count) && (CartDigestCompare(databaseIndex.digest[low], key) == 0))
+  {
+    return &table[databaseIndex.entry[low]];
+  }
+  return 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const CartInfo* CartInternalDatabase(void)
+{
+  return table;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// StellaDS.DAT slots by digest - open addressed with linear probing. MD5s are about as random as it gets so
+// the first word of the digest is all the hash we need. Each entry is the slot + 1 so zero is empty.
+// ---------------------------------------------------------------------------------------------------------
+#define CONFIG_HASH_SIZE    2048    // A power of 2 comfortably over MAX_CONFIGS
+static uInt16 configHash[CONFIG_HASH_SIZE];
+static Int16  configFreeSlot = -1;  // The first unused slot - or -1 if they're all taken
+
+static bool CartConfigSlotIsFree(Int16 slot)
+{
+  return (strcmp(allConfigs.cart[slot].md5, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx") == 0);
+}
+
+// Returns the hash entry holding the MD5 or the empty one where it would go
+static uInt16 CartConfigProbe(const uInt32 key[4], const char *md5)
+{
+  uInt16 h = key[0] & (CONFIG_HASH_SIZE - 1);
+  while (configHash[h] && (strcmp(allConfigs.cart[configHash[h] - 1].md5, md5) != 0))
+  {
+    h = (h + 1) & (CONFIG_HASH_SIZE - 1);
+  }
+  return h;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CartIndexConfigs(void)
+{
+  memset(configHash, 0x00, sizeof(configHash));
+  configFreeSlot = -1;
+
+  for (Int16 slot = 0; slot < MAX_CONFIGS; slot++)
+  {
+    uInt32 key[4] = {0};
+    if (CartDigestFromString(allConfigs.cart[slot].md5, key))
+    {
+      uInt16 h = CartConfigProbe(key, allConfigs.cart[slot].md5);
+      if (!configHash[h]) configHash[h] = slot + 1;     // First one wins - same as the old walk
+    }
+    else if ((configFreeSlot < 0) && CartConfigSlotIsFree(slot))
+    {
+      configFreeSlot = slot;
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Int16 CartFindConfigSlot(const char *md5)
+{
+  uInt32 key[4] = {0};
+  if (!CartDigestFromString(md5, key)) return -1;
+
+  uInt16 h = CartConfigProbe(key, md5);
+  return configHash[h] ? (configHash[h] - 1) : -1;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// The slot to save this MD5 into - the one it already has or the first free one (which is then indexed).
+// Returns -1 if the MD5 isn't there and every slot is taken.
+// ---------------------------------------------------------------------------------------------------------
+Int16 CartClaimConfigSlot(const char *md5)
+{
+  uInt32 key[4] = {0};
+  if (!CartDigestFromString(md5, key)) return -1;
+
+  uInt16 h = CartConfigProbe(key, md5);
+  if (configHash[h]) return configHash[h] - 1;
+  if (configFreeSlot < 0) return -1;
+
+  Int16 slot = configFreeSlot;
+  strcpy(allConfigs.cart[slot].md5, md5);
+  configHash[h] = slot + 1;
+
+  // Move on to the next unused slot
+  do configFreeSlot++; while ((configFreeSlot < MAX_CONFIGS) && !CartConfigSlotIsFree(configFreeSlot));
+  if (configFreeSlot >= MAX_CONFIGS) configFreeSlot = -1;
+
+  return slot;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// Every byte signature the isProbablyXX() checks below look for. Rather than going over the whole image
+// (up to 512K) once for each of these, the first search through an image finds all of them in one pass
+// and the counts are then handed back to searchForBytes() and friends as they ask. The checks themselves
+// are unchanged - they just get their answers from the counts.
+// ---------------------------------------------------------------------------------------------------------
+struct CartSignature
+{
+  uInt8 length;
+  uInt8 bytes[5];
+};
+
+static constexpr CartSignature cartSignatures[] =
+{
+  {5, {0x20, 0x00, 0xD0, 0xC6, 0xC5}},    // FE:    JSR $D000; DEC $C5
+  {5, {0x20, 0xC3, 0xF8, 0xA5, 0x82}},    // FE:    JSR $F8C3; LDA $82
+  {5, {0xD0, 0xFB, 0x20, 0x73, 0xFE}},    // FE:    BNE $FB; JSR $FE73
+  {5, {0x20, 0x00, 0xF0, 0x84, 0xD6}},    // FE:    JSR $F000; STY $D6
+  {3, {0x8D, 0x40, 0x02}},                // UA:    STA $240
+  {3, {0xAD, 0x40, 0x02}},                // UA:    LDA $240
+  {3, {0xBD, 0x1F, 0x02}},                // UA:    LDA $21F,X
+  {3, {0x2C, 0xC0, 0x02}},                // UA:    BIT $2C0
+  {3, {0x8D, 0xC0, 0x02}},                // UA:    STA $2C0
+  {3, {0xAD, 0xC0, 0x02}},                // UA:    LDA $2C0
+  {3, {0x2C, 0xC0, 0x0F}},                // UA and 0FA0: BIT $FC0
+  {2, {0x85, 0x3F}},                      // 3F:    STA $3F
+  {2, {0x85, 0x3E}},                      // 3E:    STA $3E
+  {4, {'T',  'J',  '3',  'E'}},           // 3E+
+  {3, {0x8D, 0xE0, 0x1F}},                // E0:    STA $1FE0
+  {3, {0x8D, 0xE0, 0x5F}},                // E0:    STA $5FE0
+  {3, {0x8D, 0xE9, 0xFF}},                // E0:    STA $FFE9
+  {3, {0x0C, 0xE0, 0x1F}},                // E0:    NOP $1FE0
+  {3, {0xAD, 0xE0, 0x1F}},                // E0:    LDA $1FE0
+  {3, {0xAD, 0xE9, 0xFF}},                // E0:    LDA $FFE9
+  {3, {0xAD, 0xED, 0xFF}},                // E0:    LDA $FFED
+  {3, {0xAD, 0xF3, 0xBF}},                // E0:    LDA $BFF3
+  {3, {0xAD, 0xE2, 0xFF}},                // E7:    LDA $FFE2
+  {3, {0xAD, 0xE5, 0xFF}},                // E7:    LDA $FFE5
+  {3, {0xAD, 0xE5, 0x1F}},                // E7:    LDA $1FE5
+  {3, {0xAD, 0xE7, 0x1F}},                // E7:    LDA $1FE7
+  {3, {0x0C, 0xE7, 0x1F}},                // E7:    NOP $1FE7
+  {3, {0x8D, 0xE7, 0xFF}},                // E7:    STA $FFE7
+  {3, {0x8D, 0xE7, 0x1F}},                // E7:    STA $1FE7
+  {3, {0xAD, 0x00, 0x08}},                // 0840:  LDA $0800
+  {3, {0xAD, 0x40, 0x08}},                // 0840:  LDA $0840
+  {3, {0x2C, 0x00, 0x08}},                // 0840:  BIT $0800
+  {4, {0x0C, 0x00, 0x08, 0x4C}},          // 0840:  NOP $0800; JMP ...
+  {4, {0x0C, 0xFF, 0x0F, 0x4C}},          // 0840:  NOP $0FFF; JMP ...
+  {4, {0x0D, 0xE0, 0x03, 0x0D}},          // 03E0:  ORA $3E0, ORA
+  {4, {0xAD, 0xE0, 0x03, 0xAD}},          // 03E0:  LDA $3E0, ORA
+  {3, {0x8D, 0xC0, 0x0F}},                // 0FA0:  STA $FC0
+  {3, {0xAD, 0xC0, 0x0F}},                // 0FA0:  LDA $FC0
+  {3, {0x2C, 0xC0, 0xEF}},                // 0FA0:  BIT $EFC0
+  {4, {'D',  'P',  'C',  '+'}},           // DPC+
+  {3, {'C',  'D',  'F'}},                 // CDF/CDFJ
+  {5, {'P',  'L',  'U',  'S',  'C'}},     // CDFJ+
+  {4, {'E',  'F',  'E',  'F'}},           // EF
+  {4, {'E',  'F',  'S',  'C'}},           // EFSC
+  {4, {'D',  'F',  'D',  'F'}},           // DF
+  {4, {'D',  'F',  'S',  'C'}},           // DFSC
+  {4, {'B',  'F',  'B',  'F'}},           // BF
+  {4, {'B',  'F',  'S',  'C'}},           // BFSC
+};
+
+#define CART_SIGNATURES  (sizeof(cartSignatures) / sizeof(cartSignatures[0]))
+
+// One state per signature byte (at most) plus the start state
+static constexpr uInt16 CartScanStates(void)
+{
+  uInt16 states = 1;
+  for (const CartSignature &signature : cartSignatures) states += signature.length;
+  return states;
+}
+
+// One class for each byte value any signature uses plus one for all the rest
+static constexpr uInt16 CartScanClasses(void)
+{
+  bool used[256] = {};
+  uInt16 classes = 1;
+  for (const CartSignature &signature : cartSignatures)
+  {
+    for (uInt8 i = 0; i < signature.length; i++)
+    {
+      if (!used[signature.bytes[i]]) {used[signature.bytes[i]] = true; classes++;}
+    }
+  }
+  return classes;
+}
+
+#define CART_SCAN_STATES   CartScanStates()
+#define CART_SCAN_CLASSES  CartScanClasses()
+
+static_assert(CART_SIGNATURES <= 64, "The signature matches are kept as a 64-bit mask");
+static_assert(CART_SCAN_STATES <= 256, "Scanner states are kept in a byte");
+
+// ---------------------------------------------------------------------------------------------------------
+// An Aho-Corasick automaton for the signatures with every transition filled in (so it's one table lookup
+// per byte of the image) worked out by the compiler. The bytes are first mapped down to the few classes
+// the signatures care about to keep the table small.
+// ---------------------------------------------------------------------------------------------------------
+struct CartSignatureScanner
+{
+  uInt8 byteClass[256];
+  uInt8 next[CART_SCAN_STATES][CART_SCAN_CLASSES];
+  u64   matches[CART_SCAN_STATES];      // The signatures that have just been seen on reaching each state
+
+  constexpr CartSignatureScanner() : byteClass(), next(), matches()
+  {
+    uInt16 classes = 1;
+    uInt16 states = 1;
+
+    // Build the trie of signatures (state 0 is the root so 0 also means no transition yet)
+    for (uInt8 id = 0; id < CART_SIGNATURES; id++)
+    {
+      uInt8 state = 0;
+      for (uInt8 i = 0; i < cartSignatures[id].length; i++)
+      {
+        uInt8 b = cartSignatures[id].bytes[i];
+        if (!byteClass[b]) byteClass[b] = classes++;
+        if (!next[state][byteClass[b]]) next[state][byteClass[b]] = states++;
+        state = next[state][byteClass[b]];
+      }
+      matches[state] |= ((u64)1 << id);
+    }
+
+    // Then go through it breadth first working out the failure links - each missing transition takes
+    // the one from the longest suffix that is also in the trie, and each state also reports the matches
+    // that suffix would have.
+    uInt8 fail[CART_SCAN_STATES] = {};
+    uInt8 queue[CART_SCAN_STATES] = {};
+    uInt16 head = 0, tail = 0;
+
+    for (uInt16 c = 1; c < classes; c++)
+    {
+      if (next[0][c]) queue[tail++] = next[0][c];
+    }
+
+    while (head < tail)
+    {
+      uInt8 state = queue[head++];
+      matches[state] |= matches[fail[state]];
+      for (uInt16 c = 1; c < classes; c++)
+      {
+        uInt8 child = next[state][c];
+        if (child)
+        {
+          fail[child] = next[fail[state]][c];
+          queue[tail++] = child;
+        }
+        else
+        {
+          next[state][c] = next[fail[state]][c];
+        }
+      }
+    }
+  }
+};
+
+static constexpr CartSignatureScanner cartScanner;
+
+// ---------------------------------------------------------------------------------------------------------
+// The 128K and bigger images only ever get asked two or three questions (CDF, DF/BF and the like) and the
+// plain search loops are quicker than one pass of the automaton for so few - so those are left to them.
+// ---------------------------------------------------------------------------------------------------------
+#define CART_SCAN_LIMIT    (64*1024)
+
+// The image the counts are for (NULL until the first search) and whether we use them at all
+static const uInt8* mySignatureImage = NULL;
+static uInt32       mySignatureSize = 0;
+static bool         bSignatureScan = true;
+static uInt32       mySignatureCounts[CART_SIGNATURES];
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static void CartScanSignatures(const uInt8* image, uInt32 size)
+{
+  memset(mySignatureCounts, 0x00, sizeof(mySignatureCounts));
+
+  uInt8 state = 0;
+  for (uInt32 i = 0; i < size; ++i)
+  {
+    state = cartScanner.next[state][cartScanner.byteClass[image[i]]];
+    u64 found = cartScanner.matches[state];
+    while (found)
+    {
+      mySignatureCounts[__builtin_ctzll(found)]++;
+      found &= found - 1;
+    }
+  }
+
+  mySignatureImage = image;
+  mySignatureSize = size;
+}
+
+// ---------------------------------------------------------------------------------------------------------
+// The number of times the given bytes appear in the image - or -1 if they aren't one of the signatures
+// (or the image is too big to be worth it, or we've been asked to search the old way) and the caller has to
+// go and look for itself.
+// ---------------------------------------------------------------------------------------------------------
+static Int32 CartSignatureCount(const uInt8* image, uInt32 size, const uInt8* bytes, uInt8 length)
+{
+  if (!bSignatureScan || (size > CART_SCAN_LIMIT)) return -1;
+
+  for (uInt8 id = 0; id < CART_SIGNATURES; id++)
+  {
+    if ((cartSignatures[id].length == length) && (memcmp(cartSignatures[id].bytes, bytes, length) == 0))
+    {
+      if ((image != mySignatureImage) || (size != mySignatureSize)) CartScanSignatures(image, size);
+      return mySignatureCounts[id];
+    }
+  }
+  return -1;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Cartridge* Cartridge::create(const uInt8* image, uInt32 size)
 {
@@ -2376,6 +2786,14 @@ Cartridge* Cartridge::create(const uInt8* image, uInt32 size)
       dsWarnIncompatibileCart();
   }
 
+  // An ARM cart over 256K needs heap for the Thumbulator's decoded ops - if there wasn't room for them go no further
+  if (((banking == BANK_DPCP) || (banking == BANK_CDFJ)) && (thumbDecoded == NULL))
+  {
+      delete cartridge;
+      cartridge = new Cartridge4K(image);
+      dsWarnOutOfMemory();
+  }
+
   return cartridge;
 }
 
@@ -2412,7 +2830,7 @@ void SetOtherDatabaseFieldDefaults(void)
   myCartInfo.bus_driver = (isDSiMode() ? 1:0);
   myCartInfo.clearRAM = (myCartInfo.special == SPEC_AR) ? 1:0;  // Supercharger AR games generally want RAM CLEAR
   myCartInfo.xStretch = 0;
-  myCartInfo.spare5_0 = 0;
+  myCartInfo.noIdleSkip = 0;
   myCartInfo.spare6_0 = 0;
   myCartInfo.spare7_0 = 0;
   myCartInfo.spare8_0 = 0;
@@ -2434,6 +2852,7 @@ uInt8 Cartridge::autodetectType(const uInt8* image, uInt32 size)
 
   // Get the MD5 message-digest for the ROM image
   strcpy(md5, MD5(image, size).c_str());
+  mySignatureImage = NULL;    // Any signature counts are for the last image loaded
 
   // Defaults for the selected cart... this may change up below...
   if (tv_type_requested == PAL)
@@ -2450,46 +2869,34 @@ uInt8 Cartridge::autodetectType(const uInt8* image, uInt32 size)
   bFoundInDAT = false;
 
   // Try finding it in the external configuration database...
-  for (int idx = 0; idx < MAX_CONFIGS; idx++)
+  Int16 slot = CartFindConfigSlot(md5);
+  if (slot >= 0)
   {
-    if (strcmp(allConfigs.cart[idx].md5, md5) == 0)   // String compare...
-    {
-        myCartInfo = allConfigs.cart[idx];
-        bFound = true;
-        bFoundInDAT = true;
-        break;
-    }
+      myCartInfo = allConfigs.cart[slot];
+      bFound = true;
+      bFoundInDAT = true;
   }
 
+  const CartInfo* entry = CartFindInternalDatabase(md5);
   if (!bFound)   // Try finding it in the internal database...
   {
-      // First we'll see if its type is listed in the table above
-      for(const CartInfo* entry = table; (entry->special != 99); ++entry)
+      if (entry)
       {
-        if (strcmp(entry->md5, md5) == 0)   // String compare...
-        {
-            myCartInfo = *entry;
+          myCartInfo = *entry;
 
-            // These are the fields not set directly in the Database Entry
-            SetOtherDatabaseFieldDefaults();
+          // These are the fields not set directly in the Database Entry
+          SetOtherDatabaseFieldDefaults();
 
-            bFound = true;
-            break;
-        }
+          bFound = true;
       }
   }
   else  // Even if the entry was found in the config file, we search the internal database for the gameID and special entries
   {
-      // First we'll see if its type is listed in the table above
-      for(const CartInfo* entry = table; (entry->special != 99); ++entry)
+      if (entry)
       {
-        if (strcmp(entry->md5, md5) == 0)   // String compare...
-        {
-            // Since these two can change and aren't configurable, always get the latest from the internal database...
-            strcpy(myCartInfo.gameID, entry->gameID);
-            myCartInfo.special = entry->special;
-            break;
-        }
+          // Since these two can change and aren't configurable, always get the latest from the internal database...
+          strcpy(myCartInfo.gameID, entry->gameID);
+          myCartInfo.special = entry->special;
       }
   }
 
@@ -2563,125 +2970,7 @@ uInt8 Cartridge::autodetectType(const uInt8* image, uInt32 size)
   if(!bFound)
   {
     strcpy(myCartInfo.md5, md5);
-    if((size % 8448) == 0)
-    {
-      myCartInfo.banking = BANK_AR;
-      myCartInfo.special= SPEC_AR;
-    }
-    else if((size <= 2048) || (size == 4096 && memcmp(image, image + 2048, 2048) == 0))
-    {
-      myCartInfo.banking = BANK_2K;
-    }
-    else if(size == 4096)
-    {
-      myCartInfo.banking = BANK_4K;
-    }
-    else if(size == 8192)  // 8K
-    {
-      if(isProbablySC(image, size))
-        myCartInfo.banking = BANK_F8SC;
-      else if(memcmp(image, image + 4096, 4096) == 0)
-        myCartInfo.banking = BANK_4K;
-      else if(isProbablyE0(image, size))
-        myCartInfo.banking = BANK_E0;
-      else if(isProbably3F(image, size))
-        myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
-      else if(isProbablyUA(image, size))
-        myCartInfo.banking = BANK_UA;
-      else if(isProbablyFE(image, size))
-        myCartInfo.banking = BANK_FE;
-      else if (isProbably0840(image, size))
-          myCartInfo.banking = BANK_0840;
-      else if (isProbably03E0(image, size))
-          myCartInfo.banking = BANK_03E0;
-      else if (isProbably0FA0(image, size))
-          myCartInfo.banking = BANK_0FA0;
-      else
-        myCartInfo.banking = BANK_F8;
-    }
-    else if((size == 10495) || (size == 10496) || (size == 10240))  // 10K - Pitfall2
-    {
-      myCartInfo.banking = BANK_DPC;
-    }
-    else if(size == 12288)
-    {
-      // For now, we assume that all carts of 12K are CBS RAM Plus/FASC.
-      myCartInfo.banking = BANK_FASC;
-    }
-    else if(size == 16384)  // 16K
-    {
-      if(isProbablySC(image, size))
-        myCartInfo.banking = BANK_F6SC;
-      else if(isProbablyE7(image, size))
-        myCartInfo.banking = BANK_E7;
-      else if(isProbably3EPlus(image, size))
-        myCartInfo.banking = BANK_3EPLUS;
-      else if(isProbably3F(image, size))
-        myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
-      else
-        myCartInfo.banking = BANK_F6;
-    }
-    else if(size == 28672) // 28K
-    {
-        myCartInfo.banking = BANK_FA2;  // 28K is probably FA2 (Star Castle)
-    }
-    else if(size == 32*1024)  // 32K
-    {
-      if(isProbablySC(image, size))
-        myCartInfo.banking = BANK_F4SC;
-      else if (isProbablyDPCplus(image, size))
-        myCartInfo.banking = BANK_DPCP;
-      else if (isProbablyCDF(image, size))
-        myCartInfo.banking = BANK_CDFJ;
-      else if(isProbably3EPlus(image, size))
-        myCartInfo.banking = BANK_3EPLUS;
-      else if(isProbably3F(image, size))
-        myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
-      else if (isProbablyFA2(image, size))
-        myCartInfo.banking = BANK_FA2;
-      else
-        myCartInfo.banking = BANK_F4;
-    }
-    else if (size == 64*1024) // 64K
-    {
-      if (isProbablyCDF(image, size))
-        myCartInfo.banking = BANK_CDFJ;
-      else if(isProbably3EPlus(image, size))
-        myCartInfo.banking = BANK_3EPLUS;
-      else if(isProbably3F(image, size))
-        myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
-      else if (isProbablyEF(image, size))
-          myCartInfo.banking = BANK_EF;
-      else if (isProbablyEFSC(image, size))
-          myCartInfo.banking = BANK_EFSC;
-      else myCartInfo.banking = BANK_EF;        // Could be F0/MegaBoy but this is growing in popularity...
-    }
-    else if(size == (128*1024)) // 128K
-    {
-        if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
-        else if (isProbablyDFSC(image, size)) myCartInfo.banking = BANK_DFSC;
-        else myCartInfo.banking = ((isProbablyDF(image, size)) ? BANK_DF : BANK_SB);          // 128K games generally use either DFSC or, more commonly SuperBanking
-    }
-    else if(size == (256*1024)) // 256K
-    {
-        if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
-        else if (isProbablyBF(image,size)) myCartInfo.banking = BANK_BF;
-        else myCartInfo.banking = ((isProbablyBFSC(image,size)) ? BANK_BFSC : BANK_SB);       // 256K games are either BFSC or, more commonly SuperBanking
-    }
-    else if(size == (480*1024)) // 480K
-    {
-        myCartInfo.banking = BANK_3E;                                                       // Most games at 480K are 3E
-    }
-    else // 512K or some odd-size...
-    {
-      if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
-      else if(isProbably3EPlus(image, size))
-        myCartInfo.banking = BANK_3EPLUS;
-      else if(isProbably3F(image, size))
-        myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;                 // Many games > 256K are 3E or 3F
-      else
-        myCartInfo.banking = BANK_3F;  // Best guess...
-    }
+    guessBanking(image, size);
   }
 
   bElevatorAgent = false;
@@ -3126,8 +3415,143 @@ uInt8 Cartridge::autodetectType(const uInt8* image, uInt32 size)
   return myCartInfo.banking;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uInt8 Cartridge::guessBanking(const uInt8* image, uInt32 size, bool scan)
+{
+  bSignatureScan = scan;
+  mySignatureImage = NULL;    // The image may be a new one in the same buffer
+
+  if((size % 8448) == 0)
+  {
+    myCartInfo.banking = BANK_AR;
+    myCartInfo.special= SPEC_AR;
+  }
+  else if((size <= 2048) || (size == 4096 && memcmp(image, image + 2048, 2048) == 0))
+  {
+    myCartInfo.banking = BANK_2K;
+  }
+  else if(size == 4096)
+  {
+    myCartInfo.banking = BANK_4K;
+  }
+  else if(size == 8192)  // 8K
+  {
+    if(isProbablySC(image, size))
+      myCartInfo.banking = BANK_F8SC;
+    else if(memcmp(image, image + 4096, 4096) == 0)
+      myCartInfo.banking = BANK_4K;
+    else if(isProbablyE0(image, size))
+      myCartInfo.banking = BANK_E0;
+    else if(isProbably3F(image, size))
+      myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
+    else if(isProbablyUA(image, size))
+      myCartInfo.banking = BANK_UA;
+    else if(isProbablyFE(image, size))
+      myCartInfo.banking = BANK_FE;
+    else if (isProbably0840(image, size))
+        myCartInfo.banking = BANK_0840;
+    else if (isProbably03E0(image, size))
+        myCartInfo.banking = BANK_03E0;
+    else if (isProbably0FA0(image, size))
+        myCartInfo.banking = BANK_0FA0;
+    else
+      myCartInfo.banking = BANK_F8;
+  }
+  else if((size == 10495) || (size == 10496) || (size == 10240))  // 10K - Pitfall2
+  {
+    myCartInfo.banking = BANK_DPC;
+  }
+  else if(size == 12288)
+  {
+    // For now, we assume that all carts of 12K are CBS RAM Plus/FASC.
+    myCartInfo.banking = BANK_FASC;
+  }
+  else if(size == 16384)  // 16K
+  {
+    if(isProbablySC(image, size))
+      myCartInfo.banking = BANK_F6SC;
+    else if(isProbablyE7(image, size))
+      myCartInfo.banking = BANK_E7;
+    else if(isProbably3EPlus(image, size))
+      myCartInfo.banking = BANK_3EPLUS;
+    else if(isProbably3F(image, size))
+      myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
+    else
+      myCartInfo.banking = BANK_F6;
+  }
+  else if(size == 28672) // 28K
+  {
+      myCartInfo.banking = BANK_FA2;  // 28K is probably FA2 (Star Castle)
+  }
+  else if(size == 32*1024)  // 32K
+  {
+    if(isProbablySC(image, size))
+      myCartInfo.banking = BANK_F4SC;
+    else if (isProbablyDPCplus(image, size))
+      myCartInfo.banking = BANK_DPCP;
+    else if (isProbablyCDF(image, size))
+      myCartInfo.banking = BANK_CDFJ;
+    else if(isProbably3EPlus(image, size))
+      myCartInfo.banking = BANK_3EPLUS;
+    else if(isProbably3F(image, size))
+      myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
+    else if (isProbablyFA2(image, size))
+      myCartInfo.banking = BANK_FA2;
+    else
+      myCartInfo.banking = BANK_F4;
+  }
+  else if (size == 64*1024) // 64K
+  {
+    if (isProbablyCDF(image, size))
+      myCartInfo.banking = BANK_CDFJ;
+    else if(isProbably3EPlus(image, size))
+      myCartInfo.banking = BANK_3EPLUS;
+    else if(isProbably3F(image, size))
+      myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;
+    else if (isProbablyEF(image, size))
+        myCartInfo.banking = BANK_EF;
+    else if (isProbablyEFSC(image, size))
+        myCartInfo.banking = BANK_EFSC;
+    else myCartInfo.banking = BANK_EF;        // Could be F0/MegaBoy but this is growing in popularity...
+  }
+  else if(size == (128*1024)) // 128K
+  {
+      if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
+      else if (isProbablyDFSC(image, size)) myCartInfo.banking = BANK_DFSC;
+      else myCartInfo.banking = ((isProbablyDF(image, size)) ? BANK_DF : BANK_SB);          // 128K games generally use either DFSC or, more commonly SuperBanking
+  }
+  else if(size == (256*1024)) // 256K
+  {
+      if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
+      else if (isProbablyBF(image,size)) myCartInfo.banking = BANK_BF;
+      else myCartInfo.banking = ((isProbablyBFSC(image,size)) ? BANK_BFSC : BANK_SB);       // 256K games are either BFSC or, more commonly SuperBanking
+  }
+  else if(size == (480*1024)) // 480K
+  {
+      myCartInfo.banking = BANK_3E;                                                       // Most games at 480K are 3E
+  }
+  else // 512K or some odd-size...
+  {
+    if (isProbablyCDF(image, size)) myCartInfo.banking = BANK_CDFJ;
+    else if(isProbably3EPlus(image, size))
+      myCartInfo.banking = BANK_3EPLUS;
+    else if(isProbably3F(image, size))
+      myCartInfo.banking = isProbably3E(image, size) ? BANK_3E : BANK_3F;                 // Many games > 256K are 3E or 3F
+    else
+      myCartInfo.banking = BANK_3F;  // Best guess...
+  }
+
+  bSignatureScan = true;
+  return myCartInfo.banking;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 int Cartridge::searchForBytes(const uInt8* image, uInt32 size, uInt8 byte1, uInt8 byte2)
 {
+  const uInt8 bytes[] = {byte1, byte2};
+  Int32 found = CartSignatureCount(image, size, bytes, 2);
+  if (found >= 0) return found;
+
   uInt32 count = 0;
   for(uInt32 i = 0; i < size - 1; ++i)
   {
@@ -3142,6 +3566,10 @@ int Cartridge::searchForBytes(const uInt8* image, uInt32 size, uInt8 byte1, uInt
 
 int Cartridge::searchForBytes3(const uInt8* image, uInt32 size, uInt8 byte1, uInt8 byte2, uInt8 byte3)
 {
+  const uInt8 bytes[] = {byte1, byte2, byte3};
+  Int32 found = CartSignatureCount(image, size, bytes, 3);
+  if (found >= 0) return found;
+
   uInt32 count = 0;
   for(uInt32 i = 0; i < size - 2; ++i)
   {
@@ -3156,6 +3584,10 @@ int Cartridge::searchForBytes3(const uInt8* image, uInt32 size, uInt8 byte1, uIn
 
 int Cartridge::searchForBytes4(const uInt8* image, uInt32 size, uInt8 byte1, uInt8 byte2, uInt8 byte3, uInt8 byte4)
 {
+  const uInt8 bytes[] = {byte1, byte2, byte3, byte4};
+  Int32 found = CartSignatureCount(image, size, bytes, 4);
+  if (found >= 0) return found;
+
   uInt32 count = 0;
   for(uInt32 i = 0; i < size - 3; ++i)
   {
@@ -3170,6 +3602,10 @@ int Cartridge::searchForBytes4(const uInt8* image, uInt32 size, uInt8 byte1, uIn
 
 int Cartridge::searchForBytes5(const uInt8* image, uInt32 size, uInt8 byte1, uInt8 byte2, uInt8 byte3, uInt8 byte4, uInt8 byte5)
 {
+  const uInt8 bytes[] = {byte1, byte2, byte3, byte4, byte5};
+  Int32 found = CartSignatureCount(image, size, bytes, 5);
+  if (found >= 0) return found;
+
   uInt32 count = 0;
   for(uInt32 i = 0; i < size - 4; ++i)
   {
@@ -3249,16 +3685,7 @@ bool Cartridge::isProbablySC(const uInt8* image, uInt32 size)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool Cartridge::isProbably3F(const uInt8* image, uInt32 size)
 {
-  uInt32 count = 0;
-  for(uInt32 i = 0; i < size - 1; ++i)
-  {
-    if((image[i] == 0x85) && (image[i + 1] == 0x3F))
-    {
-      ++count;
-    }
-  }
-
-  return (count > 2);
+  return (searchForBytes(image, size, 0x85, 0x3F) > 2);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -3484,14 +3911,11 @@ void CartSetDefaultFromInternalDatabase(void)
     strcpy(md5, myCartInfo.md5);
     myCartInfo = table[(tv_type_requested == PAL) ? 1:0];   // Default
     // First we'll see if its type is listed in the table above
-    for(const CartInfo* entry = table; (entry->special != 99); ++entry)
+    const CartInfo* entry = CartFindInternalDatabase(md5);
+    if (entry)
     {
-        if (strcmp(entry->md5, md5) == 0)   // String compare...
-        {
-            myCartInfo = *entry;
-            bFound = true;
-            break;
-        }
+        myCartInfo = *entry;
+        bFound = true;
     }
 
     if (!bFound)
@@ -83,7 +83,7 @@ struct CartInfo
   uInt8 bus_driver;
   uInt8 clearRAM;
   uInt8 xStretch;
-  uInt8 spare5_0;
+  uInt8 noIdleSkip;
   uInt8 spare6_0;
   uInt8 spare7_0;
   uInt8 spare8_0;
@@ -97,6 +97,18 @@ struct CartInfo
 
 extern CartInfo myCartInfo;
 
+// ---------------------------------------------------------------------------------
+// MD5 lookups. The internal database is indexed by the binary digest (sorted by the
+// compiler - see Cart.cpp) and the StellaDS.DAT slots by a small open-addressed hash
+// built whenever the configuration is loaded or wiped. Both return what the old
+// linear strcmp() walks did - the first entry or slot with that MD5.
+// ---------------------------------------------------------------------------------
+extern const CartInfo* CartFindInternalDatabase(const char *md5);
+extern const CartInfo* CartInternalDatabase(void);    // All of it - ends with an entry whose special is 99
+extern void  CartIndexConfigs(void);
+extern Int16 CartFindConfigSlot(const char *md5);
+extern Int16 CartClaimConfigSlot(const char *md5);
+
 struct GlobalCartInfo
 {
     uInt8                   palette;
@@ -265,6 +277,18 @@ class Cartridge : public Device
     */
     static Cartridge* create(const uInt8* image, uInt32 size);
 
+    /**
+      Guess the bankswitching type of a cart that isn't in either database
+      from its size and the bankswitching signatures found in it
+
+      @param image A pointer to the ROM image
+      @param size The size of the ROM image 
+      @param scan Find every signature in one pass over the image (false
+                  searches the whole image again for each one)
+      @return The "best guess" for the cartridge type
+    */
+    static uInt8 guessBanking(const uInt8* image, uInt32 size, bool scan = true);
+
   public:
     /**
       Create a new cartridge
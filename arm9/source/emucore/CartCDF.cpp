@@ -253,8 +253,8 @@ CartridgeCDF::CartridgeCDF(const uInt8* image, uInt32 size)
   myStartBank = (isCDFJPlus ? 0:6);
   bank(myStartBank);
     
-  fastDataStreamBase = (uInt32)&myARMRAM[myDatastreamBase];
-  fastIncStreamBase = (uInt32)&myARMRAM[myDatastreamIncrementBase];
+  fastDataStreamBase = (uintptr_t)&myARMRAM[myDatastreamBase];
+  fastIncStreamBase = (uintptr_t)&myARMRAM[myDatastreamIncrementBase];
     
   commPtr32 = (uInt32*) ((uInt32)fastDataStreamBase + (COMMSTREAM << 2));
     
@@ -262,7 +262,7 @@ CartridgeCDF::CartridgeCDF(const uInt8* image, uInt32 size)
   myDataStreamFetch = 0x00;
     
   // Create Thumbulator ARM emulator
-  myThumbEmulator = new Thumbulator((uInt16*)image); // The Thumbulator gets the full image no matter how big...
+  myThumbEmulator = new Thumbulator((uInt16*)image, size); // The Thumbulator gets the full image no matter how big...
   
   myCartCDF = this;
 }
@@ -131,7 +131,7 @@ CartridgeDPCPlus::CartridgeDPCPlus(const uInt8* image, uInt32 size)
   myFastFetch = false;
 
   // Create Thumbulator ARM emulator
-  myThumbEmulator = new Thumbulator((uInt16*)(myProgramImage-MEM_3KB));
+  myThumbEmulator = new Thumbulator((uInt16*)(myProgramImage-MEM_3KB), size);
   
   myFractionalLowMask = (myCartInfo.special == SPEC_OLDDPCP) ? 0x0F0000 : 0x0F00FF;  
         
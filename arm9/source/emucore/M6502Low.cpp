@@ -79,13 +79,174 @@ const char* M6502Low::name() const
 }
 
 // -----------------------------------------------------------------------------------
-// These handle what are known as 'phantom reads and writes'. This is a side-effect
-// of some 6502 instructions where the bus contains an intermediate value. Generally
-// its not needed to emulate this perfectly so we skip the actual read which takes
-// time and just chew up the cycles that would be required. Speed over accuracy here.
+// Cycle accounting. Normally every bus access bumps gSystemCycles as it happens, so
+// a 6 cycle instruction does six read-modify-writes of the global. With
+// M6502_CYCLE_ACCOUNTING the drivers that define PREPAID_CYCLES around the .ins
+// instead add the whole instruction from the table below once at the opcode fetch
+// (opcode_cycles) and their peek/poke handlers count nothing (bus_cycle). Since
+// the TIA/RIOT access is the last cycle of nearly every instruction it lands on
+// exactly the same cycle either way - the few exceptions (read-modify-write, page
+// crossing, JSR/BRK pushes) are trimmed here and made up in M6502Low.ins.
 // -----------------------------------------------------------------------------------
-#define fake_peek()  gSystemCycles++;
-#define fake_poke()  gSystemCycles++;
+#ifdef M6502_CYCLE_ACCOUNTING
+static const uInt8 ourInstructionCycles[256] =
+{
+ // 0  1  2  3  4  5  6  7  8  9  A  B  C  D  E  F
+    3, 6, 1, 6, 3, 3, 3, 3, 3, 2, 2, 2, 4, 4, 4, 4,   // 0
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5,   // 1
+    4, 6, 1, 6, 3, 3, 3, 3, 4, 2, 2, 2, 4, 4, 4, 4,   // 2
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5,   // 3
+    6, 6, 1, 6, 3, 3, 3, 3, 3, 2, 2, 2, 3, 4, 4, 4,   // 4
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5,   // 5
+    6, 6, 1, 6, 3, 3, 3, 3, 4, 2, 2, 2, 5, 4, 4, 4,   // 6
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5,   // 7
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,   // 8
+    2, 6, 1, 6, 4, 4, 4, 4, 2, 5, 2, 5, 5, 5, 5, 5,   // 9
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,   // A
+    2, 5, 1, 5, 4, 4, 4, 4, 2, 4, 2, 4, 4, 4, 4, 4,   // B
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,   // C
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5,   // D
+    2, 6, 2, 6, 3, 3, 3, 3, 2, 2, 2, 2, 4, 4, 4, 4,   // E
+    2, 5, 1, 6, 4, 4, 4, 4, 2, 4, 2, 5, 4, 4, 5, 5    // F
+};
+  #define bus_cycle()
+  #define opcode_cycles()  gSystemCycles += ourInstructionCycles[operand];
+#else
+  #define bus_cycle()      gSystemCycles++;
+  #define opcode_cycles()
+#endif
+
+// -------------------------------------------------------------------------------
+// Instruction dispatch. Each execute_xxx() driver below defines M6502_FETCH to
+// read the next opcode into 'operand' (the fetch is what differs per driver)
+// and then wraps the M6502Low.ins handlers in M6502_DISPATCH_BEGIN/END.
+//
+// By default this is a while() loop around a switch(). With the threaded
+// dispatch enabled (see M6502Low.hxx) every handler ends by fetching the next
+// opcode and jumping straight to its handler through a label table - this
+// replicates the indirect branch at the tail of every handler so the
+// branch predictor gets far more context than a single shared switch jump
+// and we also skip the switch bounds check on every instruction.
+// -------------------------------------------------------------------------------
+#ifdef M6502_INSTRUCTION_COUNT
+  uInt32 gTotalInstructions = 0;
+  #define M6502_COUNT_INSTRUCTION  gTotalInstructions++;
+#else
+  #define M6502_COUNT_INSTRUCTION
+#endif
+
+#ifdef M6502_THREADED_DISPATCH
+
+#define M6502_DISPATCH_TABLE \
+    &&op_00, &&op_01, &&op_xx, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07, &&op_08, &&op_09, &&op_0a, &&op_0b, &&op_0c, &&op_0d, &&op_0e, &&op_0f, \
+    &&op_10, &&op_11, &&op_xx, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17, &&op_18, &&op_19, &&op_1a, &&op_1b, &&op_1c, &&op_1d, &&op_1e, &&op_1f, \
+    &&op_20, &&op_21, &&op_xx, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27, &&op_28, &&op_29, &&op_2a, &&op_2b, &&op_2c, &&op_2d, &&op_2e, &&op_2f, \
+    &&op_30, &&op_31, &&op_xx, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37, &&op_38, &&op_39, &&op_3a, &&op_3b, &&op_3c, &&op_3d, &&op_3e, &&op_3f, \
+    &&op_40, &&op_41, &&op_xx, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47, &&op_48, &&op_49, &&op_4a, &&op_4b, &&op_4c, &&op_4d, &&op_4e, &&op_4f, \
+    &&op_50, &&op_51, &&op_xx, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57, &&op_58, &&op_59, &&op_5a, &&op_5b, &&op_5c, &&op_5d, &&op_5e, &&op_5f, \
+    &&op_60, &&op_61, &&op_xx, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67, &&op_68, &&op_69, &&op_6a, &&op_6b, &&op_6c, &&op_6d, &&op_6e, &&op_6f, \
+    &&op_70, &&op_71, &&op_xx, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77, &&op_78, &&op_79, &&op_7a, &&op_7b, &&op_7c, &&op_7d, &&op_7e, &&op_7f, \
+    &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87, &&op_88, &&op_89, &&op_8a, &&op_8b, &&op_8c, &&op_8d, &&op_8e, &&op_8f, \
+    &&op_90, &&op_91, &&op_xx, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97, &&op_98, &&op_99, &&op_9a, &&op_9b, &&op_9c, &&op_9d, &&op_9e, &&op_9f, \
+    &&op_a0, &&op_a1, &&op_a2, &&op_a3, &&op_a4, &&op_a5, &&op_a6, &&op_a7, &&op_a8, &&op_a9, &&op_aa, &&op_ab, &&op_ac, &&op_ad, &&op_ae, &&op_af, \
+    &&op_b0, &&op_b1, &&op_xx, &&op_b3, &&op_b4, &&op_b5, &&op_b6, &&op_b7, &&op_b8, &&op_b9, &&op_ba, &&op_bb, &&op_bc, &&op_bd, &&op_be, &&op_bf, \
+    &&op_c0, &&op_c1, &&op_c2, &&op_c3, &&op_c4, &&op_c5, &&op_c6, &&op_c7, &&op_c8, &&op_c9, &&op_ca, &&op_cb, &&op_cc, &&op_cd, &&op_ce, &&op_cf, \
+    &&op_d0, &&op_d1, &&op_xx, &&op_d3, &&op_d4, &&op_d5, &&op_d6, &&op_d7, &&op_d8, &&op_d9, &&op_da, &&op_db, &&op_dc, &&op_dd, &&op_de, &&op_df, \
+    &&op_e0, &&op_e1, &&op_e2, &&op_e3, &&op_e4, &&op_e5, &&op_e6, &&op_e7, &&op_e8, &&op_e9, &&op_ea, &&op_eb, &&op_ec, &&op_ed, &&op_ee, &&op_ef, \
+    &&op_f0, &&op_f1, &&op_xx, &&op_f3, &&op_f4, &&op_f5, &&op_f6, &&op_f7, &&op_f8, &&op_f9, &&op_fa, &&op_fb, &&op_fc, &&op_fd, &&op_fe, &&op_ff, \
+
+#define INS_OP(op)              op_##op:
+#define INS_NEXT                M6502_DISPATCH_NEXT
+#define M6502_DISPATCH_NEXT     { if (unlikely(myExecutionStatus)) goto dispatch_done; M6502_COUNT_INSTRUCTION M6502_FETCH; goto *dispatch_table[operand]; }
+#define M6502_DISPATCH_BEGIN    static const void * const dispatch_table[256] = { M6502_DISPATCH_TABLE }; M6502_DISPATCH_NEXT;
+#define M6502_DISPATCH_END      op_xx: M6502_DISPATCH_NEXT; dispatch_done: ;
+
+#else
+
+#define INS_OP(op)              case 0x##op:
+#define INS_NEXT                break
+#define M6502_DISPATCH_BEGIN    while (!myExecutionStatus) { M6502_COUNT_INSTRUCTION M6502_FETCH; switch (operand) {
+#define M6502_DISPATCH_END      } }
+
+#endif
+
+// -------------------------------------------------------------------------------
+// Idle loop fast-forward. A huge number of 2600 games wait out the RIOT timer
+// with a tight two instruction spin such as:
+//
+//      LDA INTIM / BNE -5      or      BIT TIMINT / BPL -5
+//
+// When one of the drivers that define IDLE_LOOP_SKIP takes a branch back 5 bytes
+// we look to see if it landed on one of these loads. If so we know exactly what
+// every trip around the loop is going to read, so we skip all the trips that
+// would read the same timer value and land on the cycle of the first trip that
+// sees it change. Whole trips are skipped so the loop phase is unchanged and
+// the game sees exactly the same timer reads as before - just sooner. This
+// can be turned off on a per-game basis with the CartInfo noIdleSkip flag.
+//
+// Each driver defines IDLE_LOOP_SKIP(a) to point at the code at 'a' exactly as
+// its own opcode fetch would read it. The fast F8/F6/F4 drivers bank switch
+// without ever touching the page table, so only their fetch knows which bank
+// the CPU is really running.
+// -------------------------------------------------------------------------------
+#ifdef M6502_INSTRUCTION_COUNT
+  uInt32 gIdleCyclesSkipped = 0;
+#endif
+
+// The normal driver reads its code through the page table - the loop must be sitting in
+// directly readable (ROM/RAM) memory so looking at it has no side-effects
+inline const uInt8 *idle_code(uInt16 address)
+{
+  PageAccess& access = myPageAccessTable[(address & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
+  if ((access.directPeekBase == 0) || ((address & MY_PAGE_MASK) > (MY_PAGE_MASK-2))) return 0;
+  return access.directPeekBase + (address & MY_PAGE_MASK);
+}
+
+ITCM_CODE void idle_skip(uInt16 loopPC, const uInt8 *code)
+{
+  if (myCartInfo.noIdleSkip) return;
+
+  // Nothing to look at, or too near the top of the bank where the three bytes could wrap or land on a hotspot
+  if ((code == 0) || ((loopPC & 0xFFF) >= 0xFF0)) return;
+
+  if ((code[0] != 0xAD) && (code[0] != 0x2C)) return;   // LDA abs or BIT abs only
+
+  // And it must be reading the RIOT timer (INTIM, TIMINT or any of their mirrors)
+  uInt16 timerAddress = code[1] | (code[2] << 8);
+  if ((timerAddress & 0x1284) != 0x0284) return;
+  PageAccess& access = myPageAccessTable[(timerAddress & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
+  if ((access.directPeekBase != 0) || (access.device != &theM6532)) return;
+
+  // One trip around the loop is LDA/BIT abs (4) + taken branch (3) + 1 if the branch crosses a page
+  uInt32 period = 7 + ((((loopPC + 5) ^ loopPC) & 0xFF00) ? 1:0);
+
+  // The next trip will read the timer 4 cycles from now...
+  Int32 timer = myTimer - ((gSystemCycles + 4) - myCyclesWhenTimerSet);
+  uInt8 value;
+  Int32 sameCycles;
+  if (timerAddress & 0x01)      // TIMINT - only changes when the timer expires
+  {
+      if (timer < 0) return;
+      value = 0x00;
+      sameCycles = timer;
+  }
+  else                          // INTIM - changes every interval (or every cycle once expired)
+  {
+      if (timer & 0x40000) return;
+      value = (timer >> myIntervalShift) & 0xFF;
+      sameCycles = timer - ((timer >> myIntervalShift) << myIntervalShift);
+  }
+
+  // The branch was taken on the last read (held in N for both LDA and BIT) - the skipped trips must read the same thing
+  if (value != N) return;
+
+  uInt32 trips = (sameCycles / period) + 1;
+  gSystemCycles += trips * period;
+#ifdef M6502_INSTRUCTION_COUNT
+  gIdleCyclesSkipped += trips * period;
+  gTotalInstructions += trips * 2;
+#endif
+}
 
 // -------------------------------------------------------------------------------
 // This is the normal driver - optimized as best we can. Note that this is the 
@@ -100,7 +261,7 @@ const char* M6502Low::name() const
 // -------------------------------------------------------------------------------
 inline uInt8 peek(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   PageAccess& access = myPageAccessTable[(address & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
   if(access.directPeekBase != 0) myDataBusState =  *(access.directPeekBase + (address & MY_PAGE_MASK));
@@ -112,7 +273,7 @@ inline uInt8 peek(uInt16 address)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 inline uInt8 peek_PC(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   PageAccess& access = myPageAccessTable[(address & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
   if(access.directPeekBase != 0) myDataBusState = *(access.directPeekBase + (address & MY_PAGE_MASK));
@@ -124,7 +285,7 @@ inline uInt8 peek_PC(uInt16 address)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 inline void poke(uInt16 address, uInt8 value)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   PageAccess& access = myPageAccessTable[(address & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
   if(access.directPokeBase != 0) *(access.directPokeBase + (address & MY_PAGE_MASK)) = value;
@@ -136,7 +297,7 @@ inline void poke(uInt16 address, uInt8 value)
 
 inline uInt8 peek_zpg(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x80) myDataBusState = myRAM[address & 0x7F];
   else
@@ -158,26 +319,27 @@ void M6502Low::execute(void)
 
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    #define operand myDataBusState
+
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  { PageAccess& access = myPageAccessTable[(PC & MY_ADDR_MASK) >> MY_PAGE_SHIFT]; bus_cycle(); \
+                           if (access.directPeekBase != 0) operand = *(access.directPeekBase + (PC & MY_PAGE_MASK)); \
+                           else operand = access.device->peek(PC); \
+                           PC++; opcode_cycles(); }
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      #define operand myDataBusState
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      PageAccess& access = myPageAccessTable[(PC & MY_ADDR_MASK) >> MY_PAGE_SHIFT];
-      if (access.directPeekBase != 0) operand = *(access.directPeekBase + (PC & MY_PAGE_MASK));
-      else operand = access.device->peek(PC);
-      PC++;
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
+        #define IDLE_LOOP_SKIP(a) idle_code(a)
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
-      }
-      #undef operand
-    }
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+    #undef operand
+
     gPC = PC;
 }
 
@@ -194,14 +356,14 @@ void M6502Low::execute(void)
 // ==============================================================================
 inline uInt8 peek_4K_PC(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
   return fast_cart_buffer[address & 0xFFF];
 }
 
 
 inline uInt8 peek_4K(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (unlikely(address & 0x1000))
   {
@@ -220,7 +382,7 @@ inline uInt8 peek_4K(uInt16 address)
 
 inline void poke_4K(uInt16 address, uInt8 value)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   // Note: this is not perfectly accurate to mimic the real Atari 2600 incomplete decoding address to
   // provide a true representation of lower memory mirrors. But it's good enough for well-behaved carts.
@@ -231,35 +393,36 @@ inline void poke_4K(uInt16 address, uInt8 value)
 
 void M6502Low::execute_4K(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     // Clear all of the execution status bits
     myExecutionStatus = 0;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  bus_cycle(); operand = fast_cart_buffer[PC++ & 0xFFF]; opcode_cycles();
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = fast_cart_buffer[PC++ & 0xFFF];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "NB" cart versions. This improves speed for non-bank-switched carts.
         #define peek     peek_4K
         #define peek_zpg peek_4K
         #define peek_PC  peek_4K_PC
         #define poke     poke_4K
+        #define IDLE_LOOP_SKIP(a) &fast_cart_buffer[(a) & 0xFFF]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef peek
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -271,14 +434,14 @@ void M6502Low::execute_4K(void)
 
 inline uInt8 peek_PCF8(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
   return fast_cart_buffer[address & f8_bankbit];
 }
 
 
 inline uInt8 peek_F8(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x1000)
   {
@@ -299,7 +462,7 @@ inline uInt8 peek_F8(uInt16 address)
 
 inline void poke_F8(uInt16 address, uInt8 value)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (unlikely(address & 0x1000))
   {
@@ -319,69 +482,69 @@ inline void poke_F8(uInt16 address, uInt8 value)
 
 void M6502Low::execute_F8(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  bus_cycle(); operand = fast_cart_buffer[PC & f8_bankbit]; PC++; opcode_cycles();
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = fast_cart_buffer[PC & f8_bankbit];
-      PC++;
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "F8" cart versions. This improves speed for non-bank-switched carts.
         #define peek     peek_F8
         #define peek_zpg peek_F8
         #define peek_PC  peek_PCF8
         #define poke     poke_F8
+        #define IDLE_LOOP_SKIP(a) &fast_cart_buffer[(a) & f8_bankbit]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef peek
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_F8SC(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  bus_cycle(); operand = fast_cart_buffer[PC & f8_bankbit]; PC++; opcode_cycles();
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = fast_cart_buffer[PC & f8_bankbit];
-      PC++;
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define peek_PC    peek_PCF8
         #define peek_zpg   peek_F8
+        #define IDLE_LOOP_SKIP(a) &fast_cart_buffer[(a) & f8_bankbit]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef  peek_zpg
         #undef peek_PC
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -392,20 +555,20 @@ void M6502Low::execute_F8SC(void)
 // -------------------------------------------------------------------------------
 inline uInt8 peek_PCF6(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
   return cart_buffer[myCurrentOffset | (address & 0xFFF)];
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 inline uInt8 peek_PCF6SC(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
   return cart_buffer[myCurrentOffset | (address & 0xFFF)];
 }
 
 inline uInt8 peek_F6(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x1000)
   {
@@ -432,7 +595,7 @@ inline uInt8 peek_F6(uInt16 address)
 
 inline void poke_F6(uInt16 address, uInt8 value)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x1000)
   {
@@ -462,37 +625,32 @@ void M6502Low::execute_F6(void)
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
+    #define M6502_FETCH  { if (PC & 0x800) operand = peek_F6(PC++); \
+                           else { bus_cycle(); operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)]; } \
+                           opcode_cycles(); }
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
-      if (PC & 0x800)
-      {
-          operand = peek_F6(PC++);
-      }
-      else
-      {
-          gSystemCycles++;
-          operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)];
-      }
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "F6" cart versions. This improves speed for non-bank-switched carts.
         #define peek     peek_F6
         #define peek_zpg peek_F6
         #define peek_PC  peek_PCF6
         #define poke     poke_F6
+        #define IDLE_LOOP_SKIP(a) &cart_buffer[myCurrentOffset | ((a) & 0xFFF)]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef peek
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -501,39 +659,34 @@ void M6502Low::execute_F6(void)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_F6SC(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
+    #define M6502_FETCH  { if (PC & 0x800) operand = peek_F6(PC++); \
+                           else { bus_cycle(); operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)]; } \
+                           opcode_cycles(); }
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt8 operand;
-      // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
-      if (PC & 0x800)
-      {
-          operand = peek_F6(PC++);
-      }
-      else
-      {
-          gSystemCycles++;
-          operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)];
-      }
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define peek_PC    peek_PCF6SC
         #define peek_zpg   peek_F6
+        #define IDLE_LOOP_SKIP(a) &cart_buffer[myCurrentOffset | ((a) & 0xFFF)]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef  peek_zpg
         #undef peek_PC
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -544,14 +697,14 @@ void M6502Low::execute_F6SC(void)
 // -------------------------------------------------------------------------------
 inline uInt8 peek_PCF4(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
   return cart_buffer[myCurrentOffset | (address & 0xFFF)];
 }
 
 
 inline uInt8 peek_F4(uInt16 address)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x1000)
   {
@@ -582,7 +735,7 @@ inline uInt8 peek_F4(uInt16 address)
 
 inline void poke_F4(uInt16 address, uInt8 value)
 {
-  gSystemCycles++;
+  bus_cycle();
 
   if (address & 0x1000)
   {
@@ -612,44 +765,39 @@ inline void poke_F4(uInt16 address, uInt8 value)
 
 void M6502Low::execute_F4(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
+    #define M6502_FETCH  { if (PC & 0x800) operand = peek_F4(PC++); \
+                           else { bus_cycle(); operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)]; } \
+                           opcode_cycles(); }
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt8 operand;
-      // Get the next 6502 instruction - do this the fast way unless we're in a possible hotspot situation
-      if (PC & 0x800)
-      {
-          operand = peek_F4(PC++);
-      }
-      else
-      {
-          gSystemCycles++;
-          operand = cart_buffer[myCurrentOffset | (PC++ & 0xFFF)];
-      }
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "F4" cart versions. This improves speed for non-bank-switched carts.
         #define peek     peek_F4
         #define peek_zpg peek_F4
         #define peek_PC  peek_PCF4
         #define poke     poke_F4
+        #define IDLE_LOOP_SKIP(a) &cart_buffer[myCurrentOffset | ((a) & 0xFFF)]
+        #define PREPAID_CYCLES
         #include "M6502Low.ins"
+        #undef PREPAID_CYCLES
+        #undef IDLE_LOOP_SKIP
         #undef peek
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -812,26 +960,21 @@ inline void poke_AR(uInt16 address, uInt8 value)
 
 void M6502Low::execute_AR(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction
+    #define M6502_FETCH  { if (bWriteOrLoadPossibleAR) operand = peek_AR(PC++); \
+                           else operand = peek_AR_PC(PC++); }
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      // Get the next 6502 instruction
-      uInt8 operand;
-      
-      if (bWriteOrLoadPossibleAR) operand = peek_AR(PC++);
-      else operand = peek_AR_PC(PC++);
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "AR" cart versions.
         #define peek     peek_AR
         #define peek_zpg peek_AR_zpg
@@ -842,8 +985,9 @@ void M6502Low::execute_AR(void)
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1087,23 +1231,19 @@ inline void poke_DPCP(uInt16 address, uInt8 value)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_DPCP(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     // Clear all of the execution status bits
     myExecutionStatus = 0;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  ++gSystemCycles; operand = myDPCptr[(PC++ & 0xFFF)];
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = myDPCptr[(PC++ & 0xFFF)];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define DPC_PLUS_FAST_FETCH
         #define peek     peek_DPCP
         #define peek_zpg peek_DPCP_zpg
@@ -1115,8 +1255,9 @@ void M6502Low::execute_DPCP(void)
         #undef peek_PC
         #undef poke
         #undef DPC_PLUS_FAST_FETCH
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1182,24 +1323,20 @@ inline void poke_DPC(uInt16 address, uInt8 value)
 
 void M6502Low::execute_DPC(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
     // Clear all of the execution status bits
     myExecutionStatus = 0;
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  ++gSystemCycles; operand = fast_cart_buffer[PC++ & f8_bankbit];
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = fast_cart_buffer[PC++ & f8_bankbit];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         // A trick of the light... here we map peek/poke to the "F8" cart versions. This improves speed for non-bank-switched carts.
         #define peek     peek_DPC
         #define peek_zpg peek_DPC
@@ -1210,8 +1347,9 @@ void M6502Low::execute_DPC(void)
         #undef peek_zpg
         #undef peek_PC
         #undef poke
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1311,23 +1449,19 @@ inline void poke_small(uInt8 address, uInt8 value)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_CDFJ(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     // Clear all of the execution status bits
     myExecutionStatus = 0;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  ++gSystemCycles; operand = myDPCptr[(PC++ & 0xFFF)];
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = myDPCptr[(PC++ & 0xFFF)];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define DATA_STREAMS
         #define peek      peek_CDFJ
         #define peek_zpg  peek_CDFJzpg
@@ -1339,8 +1473,9 @@ void M6502Low::execute_CDFJ(void)
         #undef peek_PC
         #undef poke
         #undef DATA_STREAMS
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1372,23 +1507,19 @@ inline uInt16 peek_JumpStreamPlus(uInt8 address)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_CDFJPlus(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     // Clear all of the execution status bits
     myExecutionStatus = 0;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  ++gSystemCycles; operand = myDPCptr[(PC++ & 0xFFF)];
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // Get the next 6502 instruction - do this the fast way!
-      ++gSystemCycles;
-      uInt8 operand = myDPCptr[(PC++ & 0xFFF)];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define DATA_STREAMS_PLUS
         #define peek      peek_CDFJ
         #define peek_zpg  peek_CDFJzpg
@@ -1400,8 +1531,9 @@ void M6502Low::execute_CDFJPlus(void)
         #undef peek_PC
         #undef poke
         #undef DATA_STREAMS_PLUS
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1413,7 +1545,7 @@ inline uInt8 peek_DataStreamPlusPlus(uInt8 address)
   // We place the ARMRAM for the CDFJ++ (>32K) games at a very specific
   // alginment such that the myDisplayImageCDF[] will always be aligned
   // on a 16K boundary which allows us to just do simplified math/OR here.
-  uInt16 *ptr = (uInt16*)((uInt32)&xl_ram_buffer[0x98+2] + (address << 2));
+  uInt16 *ptr = (uInt16*)((uintptr_t)&xl_ram_buffer[0x98+2] + (address << 2));
   uInt8 value = xl_ram_buffer[2048 + *ptr];
   *ptr += 1;
 
@@ -1429,27 +1561,23 @@ inline uInt8 peek_CDFJPCPlusPlus(uInt16 address)
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void M6502Low::execute_CDFJPlusPlus(void)
 {
+    uInt16 operandAddress;
+    uInt8 operand;
     // Clear all of the execution status bits
     myExecutionStatus = 0;
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // ----------------------------------------------------------------------------------
+    // Get the next 6502 instruction - do this the fast way!  This is a special driver
+    // that requires the CDFJ+ game have no more than 2 banks (8K) of normal Atari
+    // 6502 code... this is generally true of the biggest CDFJ+ games from Champ Games.
+    // ----------------------------------------------------------------------------------
+    #define M6502_FETCH  ++gSystemCycles; operand = fast_cart_buffer[(PC++ & f8_bankbit)];
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      uInt16 operandAddress;
-      // ----------------------------------------------------------------------------------
-      // Get the next 6502 instruction - do this the fast way!  This is a special driver
-      // that requires the CDFJ+ game have no more than 2 banks (8K) of normal Atari
-      // 6502 code... this is generally true of the biggest CDFJ+ games from Champ Games.
-      // ----------------------------------------------------------------------------------
-      ++gSystemCycles;
-      uInt8 operand = fast_cart_buffer[(PC++ & f8_bankbit)];
-
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define DATA_STREAMS_PLUS
         #define DATA_STREAMS_PLUS_PLUS
         #define peek      peek_CDFJ
@@ -1463,8 +1591,9 @@ void M6502Low::execute_CDFJPlusPlus(void)
         #undef poke
         #undef DATA_STREAMS_PLUS
         #undef DATA_STREAMS_PLUS_PLUS
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
@@ -1499,9 +1628,21 @@ inline uInt8 peek_CTY_PC(uInt16 address)
   else return access.device->peek(address);
 }
 
+// Same as the normal peek_zpg() but always counts its own cycle - that one doesn't with M6502_CYCLE_ACCOUNTING
+inline uInt8 peek_CTY_zpg(uInt16 address)
+{
+  gSystemCycles++;
+
+  if (address & 0x80) myDataBusState = myRAM[address & 0x7F];
+  else myDataBusState = myPageAccessTable[0].device->peek(address);
+
+  return myDataBusState;
+}
+
 
 void M6502Low::execute_CTY(void)
 {
+    uInt8 operand;
     uInt16 operandAddress;
 
     // Clear all of the execution status bits
@@ -1509,28 +1650,27 @@ void M6502Low::execute_CTY(void)
 
     uInt16 PC = gPC;  // Move PC local so compiler can optimize/registerize
 
+    // Get the next 6502 instruction - do this the fast way!
+    #define M6502_FETCH  operand = peek_CTY_PC(PC++);
+
     // -------------------------------------------------------------------------------------------------------------
     // vBlankIntr() will check for more than 32K instructions in a frame and issue the STOP bit in ExecutionStatus
     // -------------------------------------------------------------------------------------------------------------
-    while (!myExecutionStatus)
-    {
-      // Get the next 6502 instruction - do this the fast way!
-      uInt8 operand = peek_CTY_PC(PC++);
-      
-      // 6502 instruction emulation is generated by an M4 macro file
-      switch (operand)
-      {
+    M6502_DISPATCH_BEGIN
         #define peek      peek_CTY
+        #define peek_zpg  peek_CTY_zpg
         #define poke      poke_CTY
         #define peek_PC   peek_CTY_PC
         #define CTY_LDA_F2
         #include "M6502Low.ins"
         #undef CTY_LDA_F2
         #undef peek
+        #undef peek_zpg
         #undef poke
         #undef peek_PC
-      }
-    }
+    M6502_DISPATCH_END
+    #undef M6502_FETCH
+
     gPC = PC;
 }
 
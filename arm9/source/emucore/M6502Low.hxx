@@ -28,6 +28,24 @@ class M6507Low;
 #include "bspf.hxx"
 #include "M6502.hxx"
 
+// ---------------------------------------------------------------------------------
+// Uncomment to have the execute_xxx() drivers use threaded (GCC computed goto)
+// dispatch instead of a switch() - can also be set with -D in the Makefile.
+// M6502_INSTRUCTION_COUNT keeps a running count of instructions executed in
+// gTotalInstructions so we can measure instructions-per-second on the host.
+// M6502_CYCLE_ACCOUNTING has the normal and fast F8/F6/F4/4K drivers add each
+// instruction's cycles once at the opcode fetch rather than bumping gSystemCycles
+// on every bus access (see the top of M6502Low.ins for how that stays exact).
+// ---------------------------------------------------------------------------------
+//#define M6502_THREADED_DISPATCH   TRUE
+//#define M6502_INSTRUCTION_COUNT   TRUE
+//#define M6502_CYCLE_ACCOUNTING    TRUE
+
+#ifdef M6502_INSTRUCTION_COUNT
+extern uInt32 gTotalInstructions;
+extern uInt32 gIdleCyclesSkipped;
+#endif
+
 /**
   This class provides a low compatibility 6502 microprocessor emulator.  
   The memory accesses and cycle updates of this emulator are not 100% 
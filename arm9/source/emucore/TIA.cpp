@@ -32,6 +32,7 @@
 #include "M6502.hxx"
 #include "System.hxx"
 #include "TIA.hxx"
+#include "TIATables.hxx"
 #include "TIASound.hxx"
 #include "Cart.hxx"
 
@@ -39,6 +40,94 @@
 
 //#define TIA_HMOVE_DEBUG
 
+// ---------------------------------------------------------------------------------------------------------
+// An AUDx register is about to change - with the block, ARM7 or WAVE DIRECT log sound the change has to
+// go in time order with the sound made so far. The register is the TIA address less 0x15 and the value is
+// masked as stored.
+// ---------------------------------------------------------------------------------------------------------
+#if defined(TIA_SOUND_BLOCKS)
+#define TIA_SOUND_RING_WRITE(reg, value)   if (bBlockSound) Tia_process_block(gSystemCycles)
+#elif defined(TIA_SOUND_ARM7)
+#define TIA_SOUND_RING_WRITE(reg, value)   if (bArm7Sound) Tia_sound_record(gSystemCycles, (reg), (value))
+#else
+#define TIA_SOUND_RING_WRITE(reg, value)
+#endif
+#ifdef TIA_SOUND_WAVE_LOG
+#define TIA_SOUND_WAVE_WRITE(reg, value)   if (bWaveLogSound) Tia_wave_record(gSystemCycles, (reg), (value))
+#else
+#define TIA_SOUND_WAVE_WRITE(reg, value)
+#endif
+#define TIA_SOUND_WRITE(reg, value)   { TIA_SOUND_RING_WRITE(reg, value); TIA_SOUND_WAVE_WRITE(reg, value); }
+
+#ifdef TIA_WRITE_DIGEST
+uInt32 gTIAWrites = 0;
+uInt32 gTIAWriteDigest = 2166136261;
+#define TIA_DIGEST(x)  gTIAWriteDigest = (gTIAWriteDigest ^ (x)) * 16777619;
+#endif
+
+#ifdef TIA_DEFERRED_RENDER
+// ---------------------------------------------------------------------------------------------------------
+// The scanline write log - the color clock each display register write takes effect on along with the
+// register (upper byte) and value (lower byte). A scanline can't hold more than about 25 writes.
+// ---------------------------------------------------------------------------------------------------------
+#define WRITE_LOG_SIZE  32
+Int32   myWriteLogClock[WRITE_LOG_SIZE]   __attribute__((section(".dtcm")));
+uInt16  myWriteLogData[WRITE_LOG_SIZE]    __attribute__((section(".dtcm")));
+Int32   myWriteLogLineEnd                 __attribute__((section(".dtcm")));
+uInt8   myWriteLogCount                   __attribute__((section(".dtcm"))) = 0;
+#ifdef TIA_STATS
+uInt32  gTIAWritesDeferred = 0;
+uInt32  gTIAWriteLogFlushes = 0;
+#endif
+#endif
+
+#ifdef TIA_COLLISION_SPANS
+// ---------------------------------------------------------------------------------------------------------
+// A span of the frame that was drawn (or skipped) without collision checks. The mask pointers are already moved along
+// to the first pixel of the span - they point into the static mask tables so they stay good until used.
+// ---------------------------------------------------------------------------------------------------------
+struct CollisionSpan
+{
+  uInt32* maskPF;
+  const uInt8* maskBL;
+  const uInt8* maskM0;
+  const uInt8* maskM1;
+  const uInt8* maskP0;
+  const uInt8* maskP1;
+  uInt32  pf;
+  uInt8   grp0;
+  uInt8   grp1;
+  uInt8   enabled;
+  uInt8   clocks;
+};
+
+#define COLLISION_SPANS  1024
+CollisionSpan myCollisionSpan[COLLISION_SPANS];
+uInt16  myCollisionSpans = 0;
+#ifdef TIA_LAZY_COLLISIONS
+uInt8   bLazyCollisions = 1;
+uInt8   bCollisionRead = 0;
+#endif
+#ifdef TIA_STATS
+uInt32  gCollisionReads = 0;
+uInt32  gCollisionSpansResolved = 0;
+uInt32  gCollisionSpansSkipped = 0;
+#endif
+#endif
+
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+// ---------------------------------------------------------------------------------------------------------
+// How far behind the emulation is (in whatever units the front end times frames in) along with the length
+// of the current run of drawn or skipped frames so we can keep the skips spread out. See tiaFrameTime().
+// ---------------------------------------------------------------------------------------------------------
+uInt8   bFrameSkipAdaptive          __attribute__((section(".dtcm"))) = 0;
+uInt8   bFrameSkipNext = 0;
+uInt8   bFrameSkipBehind = 0;
+Int8    myFrameRun = 0;
+Int32   myFrameDebt = 0;
+uInt32  gFramesSkipped = 0;
+#endif
+
 // ---------------------------------------------------------------------------------------------------------
 // All of this used to be in the TIA class but for maximum speed, this is moved it out into fast memory...
 // ---------------------------------------------------------------------------------------------------------
@@ -52,20 +141,20 @@ uInt8*  myCurrentFrameBuffer[2]     __attribute__((section(".dtcm")));
 uInt8*  myFramePointer              __attribute__((section(".dtcm")));
 uInt16* myDSFramePointer            __attribute__((section(".dtcm")));
 Int32   myLastHMOVEClock            __attribute__((section(".dtcm")));
-uInt32  ourPlayfieldTable[2][160]   __attribute__((section(".dtcm")));
+TIAPlayfieldTable playfieldTable   __attribute__((section(".dtcm")));   // Worked out by the compiler - see TIATables.hxx
 Int32   myClockWhenFrameStarted     __attribute__((section(".dtcm")));
 Int32   myCyclesWhenFrameStarted    __attribute__((section(".dtcm")));
 Int32   myClockStartDisplay         __attribute__((section(".dtcm")));
 Int32   myClockStopDisplay          __attribute__((section(".dtcm")));
 Int32   myClockAtLastUpdate         __attribute__((section(".dtcm")));
 Int32   myClocksToEndOfScanLine     __attribute__((section(".dtcm")));
-uInt8*  myCurrentBLMask             __attribute__((section(".dtcm")));
-uInt8*  myCurrentM0Mask             __attribute__((section(".dtcm")));
-uInt8*  myCurrentM1Mask             __attribute__((section(".dtcm")));
-uInt8*  myCurrentP0Mask             __attribute__((section(".dtcm")));
-uInt8*  myCurrentP1Mask             __attribute__((section(".dtcm")));
+const uInt8* myCurrentBLMask        __attribute__((section(".dtcm")));
+const uInt8* myCurrentM0Mask        __attribute__((section(".dtcm")));
+const uInt8* myCurrentM1Mask        __attribute__((section(".dtcm")));
+const uInt8* myCurrentP0Mask        __attribute__((section(".dtcm")));
+const uInt8* myCurrentP1Mask        __attribute__((section(".dtcm")));
 uInt32* myCurrentPFMask             __attribute__((section(".dtcm")));
-uInt16  ourCollisionTable[256]      __attribute__((section(".dtcm")));
+TIACollisionTable collisionTable   __attribute__((section(".dtcm")));
 uInt16  myCollision                 __attribute__((section(".dtcm")));
 Int16   myPOSP0                     __attribute__((section(".dtcm")));
 Int16   myPOSP1                     __attribute__((section(".dtcm")));
@@ -78,7 +167,7 @@ uInt8   myCurrentFrame              __attribute__((section(".dtcm")));
 uInt8   myNUSIZ0                    __attribute__((section(".dtcm")));
 uInt8   myNUSIZ1                    __attribute__((section(".dtcm")));
 uInt32  myPlayfieldPriorityAndScore __attribute__((section(".dtcm")));
-uInt8   myPriorityEncoder[2][256]   __attribute__((section(".dtcm")));
+TIAPriorityEncoder priorityEncoder __attribute__((section(".dtcm")));
 uInt8   myCTRLPF                    __attribute__((section(".dtcm")));
 uInt8   myREFP0                     __attribute__((section(".dtcm")));
 uInt8   myREFP1                     __attribute__((section(".dtcm")));
@@ -112,7 +201,7 @@ uInt32  lastTiaPokeCycles           __attribute__((section(".dtcm"))) = 0;
 uInt8   bWaveDirectSound            __attribute__((section(".dtcm"))) = 0;
 uInt8   bFrameSkipCDFJ              __attribute__((section(".dtcm"))) = 0;
 uInt8   bNoCollisionDetection       __attribute__((section(".dtcm"))) = 0;
-uInt8   ourPlayerReflectTable[256];
+static constexpr TIAPlayerReflectTable playerReflectTable;
 
 uInt8 ourPokeDelayTable[64] __attribute__ ((aligned (4))) __attribute__((section(".dtcm"))) = {
   0,  // VSYNC
@@ -174,7 +263,14 @@ uInt8 delay_tab[] __attribute__ ((aligned (4))) __attribute__((section(".dtcm"))
         4, 4, 4, 5, 5, 5, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 5, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 5, 2, 2, 2, 3, 3, 3
 };
 
-uInt32  color_repeat_table[256];
+static constexpr TIAColorRepeatTable colorRepeatTable;
+
+// The tables above under the names the rest of the emulator knows them by
+uInt32 (&ourPlayfieldTable)[2][160] = playfieldTable.table;
+uInt16 (&ourCollisionTable)[256] = collisionTable.table;
+uInt8  (&myPriorityEncoder)[2][256] = priorityEncoder.table;
+const uInt8  (&ourPlayerReflectTable)[256] = playerReflectTable.table;
+const uInt32 (&color_repeat_table)[256] = colorRepeatTable.table;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 uInt8 ourHMOVEBlankEnableCycles[76] __attribute__((section(".dtcm"))) = {
@@ -273,6 +369,38 @@ Int8 ourCompleteMotionTable[76][16] = {
 // -----------------------------------------------------------
 uInt8 __attribute__ ((aligned (4))) videoBuf0[160 * 300];
 uInt8 __attribute__ ((aligned (4))) videoBuf1[160 * 300];
+
+#ifdef TIA_DIRTY_LINES
+// -----------------------------------------------------------------------------
+// A hash of every line of both frame buffers as it was drawn along with a hash
+// of what was last copied onto each line of the DS screen. When the two match
+// there is no need to DMA the line out again. A short run of forced frames
+// (after a reset, a blended frame or the screen being redrawn by the menus)
+// copies everything out no matter what.
+// -----------------------------------------------------------------------------
+uInt32  myLineHash[2][300];
+uInt32  myScreenHash[300];
+uInt16  myScanLine = 0;
+uInt8   myForcePushFrames = 2;
+#ifdef TIA_STATS
+uInt16  myLinesPushed = 0;
+uInt32  gLinesPushed = 0;
+uInt32  gLinesSkipped = 0;
+uInt16  gLinesPushedLastFrame = 0;
+#endif
+
+static inline uInt32 hashLine(const uInt8* line)
+{
+    const uInt32* words = (const uInt32*)line;
+    uInt32 hash = 0x811C9DC5;
+    for (uInt8 i = 0; i < 40; i++)
+    {
+        hash = (hash + words[i]) * 0x9E3779B1;
+        hash ^= (hash >> 15);
+    }
+    return hash;
+}
+#endif
 #define MYCOLUBK  0
 #define MYCOLUPF  1
 #define MYCOLUP0  2
@@ -293,62 +421,8 @@ TIA::TIA()
   myCurrentFrameBuffer[0] = videoBuf0;
   myCurrentFrameBuffer[1] = videoBuf1;
 
-  for(uInt16 x = 0; x < 2; ++x)
-  {
-    for(uInt16 enabled = 0; enabled < 256; ++enabled)
-    {
-      if(enabled & PriorityBit)
-      {
-        uInt8 color = 0;
-
-        if((enabled & (myP1Bit | myM1Bit)) != 0)
-          color = 3;
-        if((enabled & (myP0Bit | myM0Bit)) != 0)
-          color = 2;
-        if((enabled & myBLBit) != 0)
-          color = 1;
-        if((enabled & myPFBit) != 0)
-          color = 1;  // NOTE: Playfield has priority so ScoreBit isn't used
-
-        myPriorityEncoder[x][enabled] = color;
-      }
-      else
-      {
-        uInt8 color = 0;
-
-        if((enabled & myBLBit) != 0)
-          color = 1;
-        if((enabled & myPFBit) != 0)
-          color = (enabled & ScoreBit) ? ((x == 0) ? 2 : 3) : 1;
-        if((enabled & (myP1Bit | myM1Bit)) != 0)
-          color = 3;
-        if((enabled & (myP0Bit | myM0Bit)) != 0)
-          color = 2;
-
-        myPriorityEncoder[x][enabled] = color;
-      }
-    }
-  }
-
-  for(uInt32 i = 0; i < 640; ++i)
-  {
-    ourDisabledMaskTable[i] = 0;
-  }
-
-  for (uInt32 i=0; i<256; i += 2)
-  {
-      color_repeat_table[i]   = (uInt32)(i<<24) | (uInt32)(i<<16) | (uInt32)(i<<8) | (uInt32)i;
-      color_repeat_table[i+1] = (uInt32)(i<<24) | (uInt32)(i<<16) | (uInt32)(i<<8) | (uInt32)i;
-  }
-
-  // Compute all of the mask tables
-  computeBallMaskTable();
-  computeCollisionTable();
-  computeMissleMaskTable();
-  computePlayerMaskTable();
-  computePlayerPositionResetWhenTable();
-  computePlayerReflectTable();
-  computePlayfieldMaskTable();
+  // All of the lookup tables are worked out at compile time (TIATables.hxx) except
+  // for the player masks which depend on the cart and are built by reset()
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -374,6 +448,28 @@ void TIA::reset()
   }
   myCurrentFrame = 0;
 
+#ifdef TIA_DEFERRED_RENDER
+  myWriteLogCount = 0;
+#endif
+
+#ifdef TIA_COLLISION_SPANS
+  myCollisionSpans = 0;
+#endif
+
+#ifdef TIA_DIRTY_LINES
+  uInt32 blankHash = hashLine(myCurrentFrameBuffer[0]);
+  for (uInt16 i = 0; i < 300; i++)
+  {
+    myLineHash[0][i] = blankHash;
+    myLineHash[1][i] = blankHash;
+  }
+  myScanLine = 0;
+  myForcePushFrames = 2;
+#ifdef TIA_STATS
+  myLinesPushed = 0;
+#endif
+#endif
+
   // Bumper Bash requires shorter NUSIZx delay
   if (myCartInfo.special == SPEC_BUMPBASH)
   {
@@ -499,6 +595,19 @@ void TIA::systemCyclesReset()
 
   // This one just goes back to zero...
   lastTiaPokeCycles = 0;
+
+#ifdef TIA_SOUND_BLOCKS
+  // Finish the frame's sound before the cycle count it is timed against goes back to zero
+  if (bBlockSound) Tia_process_frame(cycles);
+#endif
+#ifdef TIA_SOUND_ARM7
+  // Let the ARM7 know the frame is over (and how long it was) before the cycle count goes back to zero
+  if (bArm7Sound) Tia_sound_record(cycles, TIA_SYNTH_FRAME, 0);
+#endif
+#ifdef TIA_SOUND_WAVE_LOG
+  // Make the frame's WAVE DIRECT sound from its logged writes before the cycle count goes back to zero
+  if (bWaveLogSound) Tia_wave_frame(cycles);
+#endif
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -526,6 +635,41 @@ void TIA::install(System& system)
     }
   }
 }
+
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Called by the front end after each frame with how long it took to emulate
+// and how long it had (any units - a budget of 0 means we're not keeping time
+// at all). Decides whether the next frame gets drawn.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void tiaFrameTime(uInt32 elapsed, uInt32 budget)
+{
+  if (budget == 0)
+  {
+    myFrameDebt = 0;
+    bFrameSkipBehind = 0;
+    bFrameSkipNext = 0;
+    return;
+  }
+
+  // Length of the run of drawn (positive) or skipped (negative) frames this one belongs to
+  if (bFrameSkipAdaptive) myFrameRun = (myFrameRun < 0) ? myFrameRun-1 : -1;
+  else if (myFrameRun < 100) myFrameRun = (myFrameRun > 0) ? myFrameRun+1 : 1;
+
+  // Spare time doesn't bank and a long stall (loading a state, the menus) is soon forgotten
+  myFrameDebt += (Int32)elapsed - (Int32)budget;
+  if (myFrameDebt < 0) myFrameDebt = 0;
+  if (myFrameDebt > (Int32)(4*budget)) myFrameDebt = 4*budget;
+
+  // Start skipping half a frame behind and keep at it until we've fully caught up
+  if (myFrameDebt > (Int32)(budget/2)) bFrameSkipBehind = 1;
+  else if (myFrameDebt == 0) bFrameSkipBehind = 0;
+
+  // Two drawn frames before any skip - and a second skip in a row only if we're still a whole frame behind
+  bFrameSkipNext = bFrameSkipBehind && ((myFrameRun >= 2) || ((myFrameRun == -1) && (myFrameDebt > (Int32)budget)));
+}
+#endif
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 ITCM_CODE void TIA::update()
 {
@@ -550,12 +694,38 @@ ITCM_CODE void TIA::update()
   myClockAtLastUpdate = myClockStartDisplay;
   myClocksToEndOfScanLine = 228;
 
+#ifdef TIA_DIRTY_LINES
+  // The frame may have ended part way into a line - hash whatever is there now
+  if (myScanLine < 300)
+  {
+    myLineHash[myCurrentFrame][myScanLine] = hashLine(myCurrentFrameBuffer[myCurrentFrame] + (myScanLine * 160));
+  }
+  myScanLine = 0;
+#ifdef TIA_STATS
+  gLinesPushedLastFrame = myLinesPushed;
+  myLinesPushed = 0;
+#endif
+
+  // Blended frames are written to the screen directly so those lines can't be trusted afterwards
+  if (myCartInfo.frame_mode != MODE_NO) myForcePushFrames = 2;
+  else if (myForcePushFrames) myForcePushFrames--;
+#endif
+
   // Reset frame buffer pointer
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+  // A skipped frame left its buffer alone (it still has the frame before last in it, which is what
+  // goes out to the screen) so we draw into that one again - otherwise the screen would step back a frame
+  if (!bFrameSkipAdaptive)
+#endif
   myCurrentFrame = (myCurrentFrame + 1) % 2;
   myFramePointer = myCurrentFrameBuffer[myCurrentFrame];
   myDSFramePointer = BG_GFX;
 
+#ifdef TIA_SOUND_WAVE_LOG
+  bWaveDirectSound = (myCartInfo.soundQuality == SOUND_WAVE) && !bWaveLogSound;   // The logged writes make the sound instead
+#else
   bWaveDirectSound = (myCartInfo.soundQuality == SOUND_WAVE);
+#endif
   
   bNoCollisionDetection = (myCartInfo.thumbOptimize & 2) ? 1:0;
   
@@ -572,6 +742,18 @@ ITCM_CODE void TIA::update()
   }
   else bFrameSkipCDFJ = 0;
 
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+  // Carts with their own skip pattern above and blended frames (which need both frames) are left alone
+  bFrameSkipAdaptive = bFrameSkipNext && (myCartInfo.thumbOptimize != 3) && (myCartInfo.frame_mode == MODE_NO);
+  if (bFrameSkipAdaptive) gFramesSkipped++;
+#endif
+
+#ifdef TIA_LAZY_COLLISIONS
+  // A game that read a collision register last frame will likely do so again - check those as we draw
+  bLazyCollisions = !bCollisionRead;
+  bCollisionRead = 0;
+#endif
+
   // --------------------------------------------------------------------
   // Execute instructions until frame is finished
   // --------------------------------------------------------------------
@@ -594,6 +776,11 @@ ITCM_CODE void TIA::update()
       case 13: mySystem->m6502().execute_CTY();          break;   // If we are CTY (Cherity), we can run faster here...
       default: mySystem->m6502().execute();              break;   // Otherwise the normal execute driver
   }
+
+#ifdef TIA_DEFERRED_RENDER
+  // Anything still in the scanline write log belongs to the frame we just finished
+  if (myWriteLogCount) flushWriteLog();
+#endif
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -627,203 +814,6 @@ uInt32 TIA::height() const
   return 210;
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computeBallMaskTable()
-{
-  // First, calculate masks for alignment 0
-  for(Int32 size = 0; size < 4; ++size)
-  {
-    Int32 x;
-
-    // Set all of the masks to false to start with
-    for(x = 0; x < 160; ++x)
-    {
-      ourBallMaskTable[0][size][x] = false;
-    }
-
-    // Set the necessary fields true
-    for(x = 0; x < 160 + 8; ++x)
-    {
-      if((x >= 0) && (x < (1 << size)))
-      {
-        ourBallMaskTable[0][size][x % 160] = true;
-      }
-    }
-
-    // Copy fields into the wrap-around area of the mask
-    for(x = 0; x < 160; ++x)
-    {
-      ourBallMaskTable[0][size][x + 160] = ourBallMaskTable[0][size][x];
-    }
-  }
-
-  // Now, copy data for alignments of 1, 2 and 3
-  for(uInt32 align = 1; align < 4; ++align)
-  {
-    for(uInt32 size = 0; size < 4; ++size)
-    {
-      for(uInt32 x = 0; x < 320; ++x)
-      {
-        ourBallMaskTable[align][size][x] =
-            ourBallMaskTable[0][size][(x + 320 - align) % 320];
-      }
-    }
-  }
-}
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computeCollisionTable()
-{
-  for(uInt8 i = 0; i < 64; ++i)
-  {
-    ourCollisionTable[i] = 0;
-
-    if((i & myM0Bit) && (i & myP1Bit))    // M0-P1
-      ourCollisionTable[i] |= 0x0001;
-
-    if((i & myM0Bit) && (i & myP0Bit))    // M0-P0
-      ourCollisionTable[i] |= 0x0002;
-
-    if((i & myM1Bit) && (i & myP0Bit))    // M1-P0
-      ourCollisionTable[i] |= 0x0004;
-
-    if((i & myM1Bit) && (i & myP1Bit))    // M1-P1
-      ourCollisionTable[i] |= 0x0008;
-
-    if((i & myP0Bit) && (i & myPFBit))    // P0-PF
-      ourCollisionTable[i] |= 0x0010;
-
-    if((i & myP0Bit) && (i & myBLBit))    // P0-BL
-      ourCollisionTable[i] |= 0x0020;
-
-    if((i & myP1Bit) && (i & myPFBit))    // P1-PF
-      ourCollisionTable[i] |= 0x0040;
-
-    if((i & myP1Bit) && (i & myBLBit))    // P1-BL
-      ourCollisionTable[i] |= 0x0080;
-
-    if((i & myM0Bit) && (i & myPFBit))    // M0-PF
-      ourCollisionTable[i] |= 0x0100;
-
-    if((i & myM0Bit) && (i & myBLBit))    // M0-BL
-      ourCollisionTable[i] |= 0x0200;
-
-    if((i & myM1Bit) && (i & myPFBit))    // M1-PF
-      ourCollisionTable[i] |= 0x0400;
-
-    if((i & myM1Bit) && (i & myBLBit))    // M1-BL
-      ourCollisionTable[i] |= 0x0800;
-
-    if((i & myBLBit) && (i & myPFBit))    // BL-PF
-      ourCollisionTable[i] |= 0x1000;
-
-    if((i & myP0Bit) && (i & myP1Bit))    // P0-P1
-      ourCollisionTable[i] |= 0x2000;
-
-    if((i & myM0Bit) && (i & myM1Bit))    // M0-M1
-      ourCollisionTable[i] |= 0x4000;
-  }
-
-  for(int i = 64; i < 256; i++)
-  {
-        ourCollisionTable[i] = ourCollisionTable[i%64];
-  }
-}
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computeMissleMaskTable()
-{
-  // First, calculate masks for alignment 0
-  Int32 x, size, number;
-
-  // Clear the missle table to start with
-  for(number = 0; number < 8; ++number)
-    for(size = 0; size < 4; ++size)
-      for(x = 0; x < 160; ++x)
-        ourMissleMaskTable[0][number][size][x] = false;
-
-  for(number = 0; number < 8; ++number)
-  {
-    for(size = 0; size < 4; ++size)
-    {
-      for(x = 0; x < 160 + 72; ++x)
-      {
-        // Only one copy of the missle
-        if((number == 0x00) || (number == 0x05) || (number == 0x07))
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-        // Two copies - close
-        else if(number == 0x01)
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 16) >= 0) && ((x - 16) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-        // Two copies - medium
-        else if(number == 0x02)
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-        // Three copies - close
-        else if(number == 0x03)
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 16) >= 0) && ((x - 16) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-        // Two copies - wide
-        else if(number == 0x04)
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 64) >= 0) && ((x - 64) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-        // Three copies - medium
-        else if(number == 0x06)
-        {
-          if((x >= 0) && (x < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-          else if(((x - 64) >= 0) && ((x - 64) < (1 << size)))
-            ourMissleMaskTable[0][number][size][x % 160] = true;
-        }
-      }
-
-      // Copy data into wrap-around area
-      for(x = 0; x < 160; ++x)
-        ourMissleMaskTable[0][number][size][x + 160] =
-          ourMissleMaskTable[0][number][size][x];
-    }
-  }
-
-  // Now, copy data for alignments of 1, 2 and 3
-  for(uInt32 align = 1; align < 4; ++align)
-  {
-    for(number = 0; number < 8; ++number)
-    {
-      for(size = 0; size < 4; ++size)
-      {
-        for(x = 0; x < 320; ++x)
-        {
-          ourMissleMaskTable[align][number][size][x] =
-            ourMissleMaskTable[0][number][size][(x + 320 - align) % 320];
-        }
-      }
-    }
-  }
-}
-
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void TIA::computePlayerMaskTable()
 {
@@ -949,247 +939,142 @@ void TIA::computePlayerMaskTable()
   }
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computePlayerPositionResetWhenTable()
-{
-  uInt32 mode, oldx, newx;
-
-  // Loop through all player modes, all old player positions, and all new
-  // player positions and determine where the new position is located:
-  // 1 means the new position is within the display of an old copy of the
-  // player, -1 means the new position is within the delay portion of an
-  // old copy of the player, and 0 means it's neither of these two
-  for(mode = 0; mode < 8; ++mode)
-  {
-    for(oldx = 0; oldx < 160; ++oldx)
-    {
-      // Set everything to 0 for non-delay/non-display section
-      for(newx = 0; newx < 160; ++newx)
-      {
-        ourPlayerPositionResetWhenTable[mode][oldx][newx] = 0;
-      }
-
-      // Now, we'll set the entries for non-delay/non-display section
-      for(newx = 0; newx < 160 + 72 + 5; ++newx)
-      {
-        if(mode == 0x00)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x01)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 16)) && (newx < (oldx + 16 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 16 + 4) && (newx < (oldx + 16 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x02)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x03)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 16)) && (newx < (oldx + 16 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 16 + 4) && (newx < (oldx + 16 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x04)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 64)) && (newx < (oldx + 64 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 64 + 4) && (newx < (oldx + 64 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x05)
-        {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
+// -----------------------------------------------------------------------
+// Word-wide drawing for the object combinations that don't have a hand
+// tuned loop in TIA.inc. We work out four pixels per step:
+//
+//  - Playfield pixels are 4 wide and start on a multiple of 4 so the PF
+//    mask is the same for all four pixels of an aligned word.
+//  - For the byte-wide object masks we pick out the non-zero bytes of a
+//    32-bit load with the usual ((x & 0x7F7F7F7F) + 0x7F7F7F7F) | x trick
+//    and scale the resulting 0x01 per byte up to the object bit.
+//
+// That leaves four 'enabled' bytes in one word. Most of the time all four
+// are the same (long runs of background or of a single object) so it's one
+// priority lookup, one collision lookup and one 32-bit store - myColor[] is
+// already replicated across all four bytes. Otherwise we merge the four
+// colors lane by lane. Any leading/trailing pixels that are not on a word
+// boundary are done one at a time the same way. The frame buffer and the
+// object masks line up (hpos & 3) so an aligned frame pointer means aligned
+// mask pointers too.
+//
+// COLLISIONS picks whether myCollision gets updated and SCORE whether the
+// right half of the screen uses the second priority encoder (score mode).
+// -----------------------------------------------------------------------
+#define NONZERO_BYTES(x)    ((((((x) & 0x7F7F7F7F) + 0x7F7F7F7F) | (x)) >> 7) & 0x01010101)
 
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 16)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-        }
-        else if(mode == 0x06)
+template <uInt8 OBJECTS, bool COLLISIONS, bool SCORE>
+static inline __attribute__((always_inline)) void drawObjectsWordWide(uInt8* ending, Int32 hpos)
+{
+    uInt32* mPF = &myCurrentPFMask[hpos];
+    const uInt8*  mBL = &myCurrentBLMask[hpos];
+    const uInt8*  mM0 = &myCurrentM0Mask[hpos];
+    const uInt8*  mM1 = &myCurrentM1Mask[hpos];
+    const uInt8*  mP0 = &myCurrentP0Mask[hpos];
+    const uInt8*  mP1 = &myCurrentP1Mask[hpos];
+
+    // The catch-all case has every object in OBJECTS so the ball/missile masks need their enable bit too
+    uInt32 enBL = (myEnabledObjects & myBLBit) ? 0xFFFFFFFF : 0;
+    uInt32 enM0 = (myEnabledObjects & myM0Bit) ? 0xFFFFFFFF : 0;
+    uInt32 enM1 = (myEnabledObjects & myM1Bit) ? 0xFFFFFFFF : 0;
+    uInt32 grp0 = myCurrentGRP0 * 0x01010101;
+    uInt32 grp1 = myCurrentGRP1 * 0x01010101;
+
+    while (((uintptr_t)myFramePointer & 0x03) && (myFramePointer < ending))
+    {
+        uInt8 enabled = myPlayfieldPriorityAndScore;
+        if ((OBJECTS & myPFBit) && (myPF & *mPF))   enabled |= myPFBit;
+        if ((OBJECTS & myBLBit) && (enBL & *mBL))   enabled |= myBLBit;
+        if ((OBJECTS & myM1Bit) && (enM1 & *mM1))   enabled |= myM1Bit;
+        if ((OBJECTS & myM0Bit) && (enM0 & *mM0))   enabled |= myM0Bit;
+        if ((OBJECTS & myP1Bit) && (grp1 & *mP1))   enabled |= myP1Bit;
+        if ((OBJECTS & myP0Bit) && (grp0 & *mP0))   enabled |= myP0Bit;
+        *myFramePointer++ = myColor[myPriorityEncoder[(SCORE && (hpos >= 80)) ? 1:0][enabled]];
+        if (COLLISIONS) myCollision |= ourCollisionTable[enabled];
+        mPF++; mBL++; mM0++; mM1++; mP0++; mP1++; hpos++;
+    }
+
+    while (myFramePointer < (ending - 3))
+    {
+        uInt32 enabled = myPlayfieldPriorityAndScore * 0x01010101;
+        if ((OBJECTS & myPFBit) && (myPF & *mPF))   enabled |= myPFBit * 0x01010101;
+        if (OBJECTS & myBLBit) enabled |= NONZERO_BYTES(enBL & *(uInt32*)mBL) * myBLBit;
+        if (OBJECTS & myM1Bit) enabled |= NONZERO_BYTES(enM1 & *(uInt32*)mM1) * myM1Bit;
+        if (OBJECTS & myM0Bit) enabled |= NONZERO_BYTES(enM0 & *(uInt32*)mM0) * myM0Bit;
+        if (OBJECTS & myP1Bit) enabled |= NONZERO_BYTES(grp1 & *(uInt32*)mP1) * myP1Bit;
+        if (OBJECTS & myP0Bit) enabled |= NONZERO_BYTES(grp0 & *(uInt32*)mP0) * myP0Bit;
+
+        uInt8* encoder = myPriorityEncoder[(SCORE && (hpos >= 80)) ? 1:0];
+        uInt8 e0 = enabled;
+        if (enabled == (e0 * 0x01010101))
         {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-          else if((newx >= (oldx + 64)) && (newx < (oldx + 64 + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
-          else if((newx >= oldx + 64 + 4) && (newx < (oldx + 64 + 4 + 8)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
+            *(uInt32*)myFramePointer = myColor[encoder[e0]];
+            if (COLLISIONS) myCollision |= ourCollisionTable[e0];
         }
-        else if(mode == 0x07)
+        else
         {
-          if((newx >= oldx) && (newx < (oldx + 4)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = -1;
-
-          if((newx >= oldx + 4) && (newx < (oldx + 4 + 32)))
-            ourPlayerPositionResetWhenTable[mode][oldx][newx % 160] = 1;
+            uInt8 e1 = enabled >> 8;
+            uInt8 e2 = enabled >> 16;
+            uInt8 e3 = enabled >> 24;
+            *(uInt32*)myFramePointer = (myColor[encoder[e0]] & 0x000000FF) | (myColor[encoder[e1]] & 0x0000FF00) |
+                                       (myColor[encoder[e2]] & 0x00FF0000) | (myColor[encoder[e3]] & 0xFF000000);
+            if (COLLISIONS) myCollision |= ourCollisionTable[e0] | ourCollisionTable[e1] | ourCollisionTable[e2] | ourCollisionTable[e3];
         }
-      }
-
-      // Let's do a sanity check on our table entries
-      uInt32 s1 = 0, s2 = 0;
-      for(newx = 0; newx < 160; ++newx)
-      {
-        if(ourPlayerPositionResetWhenTable[mode][oldx][newx] == -1)
-          ++s1;
-        if(ourPlayerPositionResetWhenTable[mode][oldx][newx] == 1)
-          ++s2;
-      }
-      assert((s1 % 4 == 0) && (s2 % 8 == 0));
+        myFramePointer += 4;
+        mPF += 4; mBL += 4; mM0 += 4; mM1 += 4; mP0 += 4; mP1 += 4; hpos += 4;
     }
-  }
-}
-
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computePlayerReflectTable()
-{
-  for(uInt16 i = 0; i < 256; ++i)
-  {
-    uInt8 r = 0;
 
-    for(uInt16 t = 1; t <= 128; t *= 2)
+    while (myFramePointer < ending)
     {
-      r = (r << 1) | ((i & t) ? 0x01 : 0x00);
+        uInt8 enabled = myPlayfieldPriorityAndScore;
+        if ((OBJECTS & myPFBit) && (myPF & *mPF))   enabled |= myPFBit;
+        if ((OBJECTS & myBLBit) && (enBL & *mBL))   enabled |= myBLBit;
+        if ((OBJECTS & myM1Bit) && (enM1 & *mM1))   enabled |= myM1Bit;
+        if ((OBJECTS & myM0Bit) && (enM0 & *mM0))   enabled |= myM0Bit;
+        if ((OBJECTS & myP1Bit) && (grp1 & *mP1))   enabled |= myP1Bit;
+        if ((OBJECTS & myP0Bit) && (grp0 & *mP0))   enabled |= myP0Bit;
+        *myFramePointer++ = myColor[myPriorityEncoder[(SCORE && (hpos >= 80)) ? 1:0][enabled]];
+        if (COLLISIONS) myCollision |= ourCollisionTable[enabled];
+        mPF++; mBL++; mM0++; mM1++; mP0++; mP1++; hpos++;
     }
-
-    ourPlayerReflectTable[i] = r;
-  }
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-void TIA::computePlayfieldMaskTable()
+#define DRAW_OBJECTS_WORD_WIDE(objects)   drawObjectsWordWide<(objects), true, true>(ending, hpos)
+
+// -----------------------------------------------------------------------
+// We spent a LOT of time in here... so we've done our best to keep this
+// as streamlined as possible. We could reduce this to about 10 lines of
+// code if source-code / memory was at a premium. But it's not - instead
+// we are after speed of execution and are willing to trade off these
+// large if-then-else blocks to help with code execution to get as many
+// games running at full frame rate as possible...
+// -----------------------------------------------------------------------
+void TIA::handleObjectsAndCollisions(Int32 clocksToUpdate, Int32 hpos)
 {
-  Int32 x;
+    uInt8* ending = myFramePointer + clocksToUpdate;  // Calculate the ending frame pointer value
 
-  // Compute playfield mask table for non-reflected mode
-  for(x = 0; x < 160; ++x)
-  {
-    if(x < 16)
-    {
-      int tmp = 0x00001 << (x / 4);
-      ourPlayfieldTable[0][x] = tmp;
-      ourPlayfieldTable[1][x] = tmp;
-    }
-    else if(x < 48)
-    {
-      int tmp = 0x00800 >> ((x - 16) / 4);
-      ourPlayfieldTable[0][x] = tmp;
-      ourPlayfieldTable[1][x] = tmp;
-    }
-    else if(x < 80)
+    switch (myEnabledObjects)
     {
-      int tmp = 0x01000 << ((x - 48) / 4);
-      ourPlayfieldTable[0][x] = tmp;
-      ourPlayfieldTable[1][x] = tmp;
+    #include "TIA.inc"
     }
-    else if(x < 96)
-    {
-      ourPlayfieldTable[0][x] = 0x00001 << ((x - 80) / 4);
-    }
-    else if(x < 128)
-    {
-      ourPlayfieldTable[0][x] = 0x00800 >> ((x - 96) / 4);
-    }
-    else if(x < 160)
-    {
-      ourPlayfieldTable[0][x] = 0x01000 << ((x - 128) / 4);
-    }
-  }
-
-  // Compute playfield mask table for reflected mode
-  for(x = 80; x < 160; ++x)
-  {
-     if(x < 112)
-      ourPlayfieldTable[1][x] = 0x80000 >> ((x - 80) / 4);
-    else if(x < 144)
-      ourPlayfieldTable[1][x] = 0x00010 << ((x - 112) / 4);
-    else if(x < 160)
-      ourPlayfieldTable[1][x] = 0x00008 >> ((x - 144) / 4);
-  }
+    myFramePointer = ending;
 }
 
 // -----------------------------------------------------------------------
-// Magic! This helps speedup rendering as it assumes the last color
-// is likely to be the next color drawn - and corrects if that's
-// not true. We keep track of the last enabled bits and if those
-// bits have not changed, there is no reason to update the myCollision
-// register and we can just blast out the last known color.
+// For some of the DPC+ and many of the CDF/CDFJ we don't need to handle
+// any special color or collisions so we can do this the fast way..
+// Note that we are purposely ignoring the ScoreBit handling here which
+// provides a bit more speed and nobody is using that for the ARM-Assisted
+// games that also don't provide any collision usage. It's not a safe
+// way to do this... but nothing has broken it and we need the speed.
 // -----------------------------------------------------------------------
-#define HANDLE_COLOR_AND_COLLISIONS  \
-              if (enabled == last_enabled)  \
-              {  \
-                  *myFramePointer = last_color;  \
-                  if (++hpos == 80) last_enabled=255;  \
-              }  \
-              else  \
-              {  \
-                  myCollision |= ourCollisionTable[enabled];  \
-                  if (hpos < 80)  \
-                  {  \
-                      last_color = myColor[myPriorityEncoder[0][enabled]];  \
-                      hpos++;  \
-                  }  \
-                  else  \
-                  {  \
-                      last_color = myColor[myPriorityEncoder[1][enabled]];  \
-                  }  \
-                  *myFramePointer = last_color;  \
-                  last_enabled = enabled;  \
-              }
+#undef DRAW_OBJECTS_WORD_WIDE
+#define DRAW_OBJECTS_WORD_WIDE(objects)   drawObjectsWordWide<(objects), false, false>(ending, hpos)
 
-// -----------------------------------------------------------------------
-// We spent a LOT of time in here... so we've done our best to keep this
-// as streamlined as possible. We could reduce this to about 10 lines of
-// code if source-code / memory was at a premium. But it's not - instead
-// we are after speed of execution and are willing to trade off these
-// large if-then-else blocks to help with code execution to get as many
-// games running at full frame rate as possible...
-// -----------------------------------------------------------------------
-void TIA::handleObjectsAndCollisions(Int32 clocksToUpdate, Int32 hpos)
+void TIA::handleObjectsNoCollisions(Int32 clocksToUpdate, Int32 hpos)
 {
-    uInt8 last_color=0;
-    uInt8 last_enabled=255;
     uInt8* ending = myFramePointer + clocksToUpdate;  // Calculate the ending frame pointer value
+    #define COLLISIONS_OFF
 
     switch (myEnabledObjects)
     {
@@ -1198,21 +1083,88 @@ void TIA::handleObjectsAndCollisions(Int32 clocksToUpdate, Int32 hpos)
     myFramePointer = ending;
 }
 
+#ifdef TIA_COLLISION_SPANS
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Note this span down if it could possibly add a collision we don't already
+// have. Only a skipped frame can fill the list up (a drawn frame checks
+// collisions as it draws once it's full) so then we work out what we have.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+inline __attribute__((always_inline)) void TIA::noteCollisionSpan(Int32 clocksToUpdate, Int32 hpos)
+{
+    if (ourCollisionTable[myEnabledObjects] & ~myCollision)
+    {
+        if (unlikely(myCollisionSpans == COLLISION_SPANS)) resolveCollisions();
+
+        CollisionSpan &span = myCollisionSpan[myCollisionSpans++];
+        span.maskPF  = &myCurrentPFMask[hpos];
+        span.maskBL  = &myCurrentBLMask[hpos];
+        span.maskM0  = &myCurrentM0Mask[hpos];
+        span.maskM1  = &myCurrentM1Mask[hpos];
+        span.maskP0  = &myCurrentP0Mask[hpos];
+        span.maskP1  = &myCurrentP1Mask[hpos];
+        span.pf      = myPF;
+        span.grp0    = myCurrentGRP0;
+        span.grp1    = myCurrentGRP1;
+        span.enabled = myEnabledObjects;
+        span.clocks  = clocksToUpdate;
+    }
+#ifdef TIA_STATS
+    else gCollisionSpansSkipped++;
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Work out the collision bits the noted down spans would have set. This is
+// the slow pixel-by-pixel way but it only happens when a collision register
+// is read (or a skipped frame fills the list up) and we stop on a span as
+// soon as it can't add anything new.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ITCM_CODE void TIA::resolveCollisions()
+{
+  for (uInt16 i = 0; i < myCollisionSpans; i++)
+  {
+    CollisionSpan &span = myCollisionSpan[i];
+    uInt8 objects = span.enabled;
+    uInt16 wanted = ourCollisionTable[objects];
+
+    for (uInt8 x = 0; x < span.clocks; x++)
+    {
+      if ((myCollision & wanted) == wanted) break;  // Nothing more this span can add
+
+      uInt8 enabled = 0;
+      if ((objects & myPFBit) && (span.pf & span.maskPF[x]))   enabled |= myPFBit;
+      if ((objects & myBLBit) && span.maskBL[x])               enabled |= myBLBit;
+      if ((objects & myM1Bit) && span.maskM1[x])               enabled |= myM1Bit;
+      if ((objects & myM0Bit) && span.maskM0[x])               enabled |= myM0Bit;
+      if ((objects & myP1Bit) && (span.grp1 & span.maskP1[x])) enabled |= myP1Bit;
+      if ((objects & myP0Bit) && (span.grp0 & span.maskP0[x])) enabled |= myP0Bit;
+      myCollision |= ourCollisionTable[enabled];
+    }
+  }
+
+#ifdef TIA_STATS
+  gCollisionSpansResolved += myCollisionSpans;
+#endif
+  myCollisionSpans = 0;
+}
+#endif
+
+#ifdef TIA_LAZY_COLLISIONS
 // -----------------------------------------------------------------------
-// For some of the DPC+ and many of the CDF/CDFJ we don't need to handle
-// any special color or collisions so we can do this the fast way..
-// Note that we are purposely ignoring the ScoreBit handling here which
-// provides a bit more speed and nobody is using that for the ARM-Assisted
-// games that also don't provide any collision usage. It's not a safe
-// way to do this... but nothing has broken it and we need the speed.
+// Same drawing as handleObjectsAndCollisions() - including the score and
+// priority handling - but without touching myCollision. The span is noted
+// down by updateFrame() so resolveCollisions() can fill in the collision
+// bits later on if the game asks for them. COLLISIONS_OFF is still set
+// from above so the inline collision checks in TIA.inc are left out too.
 // -----------------------------------------------------------------------
-#undef HANDLE_COLOR_AND_COLLISIONS
-#define HANDLE_COLOR_AND_COLLISIONS  *myFramePointer = (enabled ? myColor[myPriorityEncoder[0][enabled]] : myColor[0]);
+#undef DRAW_OBJECTS_WORD_WIDE
+#define DRAW_OBJECTS_WORD_WIDE(objects)   drawObjectsWordWide<(objects), false, true>(ending, hpos)
 
-void TIA::handleObjectsNoCollisions(Int32 clocksToUpdate, Int32 hpos)
+void TIA::handleObjectsLazyCollisions(Int32 clocksToUpdate, Int32 hpos)
 {
     uInt8* ending = myFramePointer + clocksToUpdate;  // Calculate the ending frame pointer value
-    #define COLLISIONS_OFF
+
+    noteCollisionSpan(clocksToUpdate, hpos);
 
     switch (myEnabledObjects)
     {
@@ -1220,6 +1172,101 @@ void TIA::handleObjectsNoCollisions(Int32 clocksToUpdate, Int32 hpos)
     }
     myFramePointer = ending;
 }
+#endif
+
+#ifdef TIA_DIRTY_LINES
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void TIA::invalidateScreen()
+{
+  // Whatever is left of this frame plus one full frame gets copied out
+  myForcePushFrames = 2;
+}
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Draw clocksToUpdate pixels of the current scanline starting at hpos with the
+// registers as they stand - picking the quickest way to do it.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+inline __attribute__((always_inline)) void TIA::drawSpan(Int32 clocksToUpdate, Int32 hpos)
+{
+    // If we are updating, make sure the Enabled Objects register is up to date...
+    if(myPF != 0)
+      myEnabledObjects |= myPFBit;
+    else
+      myEnabledObjects &= ~myPFBit;
+
+    // See if we're in the vertical blank region
+    if(myVBLANK & 0x02)
+    {
+        // -------------------------------------------------------------------------------------------
+        // Some games present a fairly static screen from frame to frame and so there is really no
+        // reason to blank the memory which can be time consuming... so check the flag for the cart
+        // currently being emulated...
+        // -------------------------------------------------------------------------------------------
+        if (myCartInfo.vblankZero || !(gAtariFrames & 0x0E))    // Every 16 frames we will do two frames proper vBlank despite the cartInfo (two is needed as some games display different data on alternating frames)
+        {
+            memset(myFramePointer, 0x00, clocksToUpdate);
+        }
+        myFramePointer += clocksToUpdate;
+    }
+    else if (myEnabledObjects == 0x00)  // Background handling...
+    {
+        memset(myFramePointer, myColor[MYCOLUBK], clocksToUpdate);
+        myFramePointer += clocksToUpdate;
+    }
+    else  // All other possibilities... this is expensive CPU-wise
+    {
+        if (bNoCollisionDetection)  // If we are Optimizing the ARM Thumb with NO collisions...
+        {
+            if ((myEnabledObjects|myPlayfieldPriorityAndScore) == myPFBit) // Playfield bit set... without priority/score (common in CDF/J/+ games)
+            {
+                   uInt8* ending = myFramePointer + clocksToUpdate;  // Calculate the ending frame pointer value
+                   uInt32* mask = &myCurrentPFMask[hpos];
+                   // Since a 32-bit access to main memory is always split as 16-bits, we can just align to 16 bits
+                   if ((uintptr_t)myFramePointer & 1)
+                   {
+                       *myFramePointer++ = myColor[(myPF & *mask++) ? MYCOLUPF:MYCOLUBK];
+                   }
+                   // Now, update a uInt32 at a time
+                   for(; myFramePointer < ending; myFramePointer += 4, mask += 4)
+                   {
+                     *((uInt32*)myFramePointer) = myColor[(myPF & *mask) ? MYCOLUPF:MYCOLUBK];
+                   }
+                   myFramePointer = ending;
+            }
+            else
+            {
+                handleObjectsNoCollisions(clocksToUpdate, hpos);
+            }
+        }
+        else    // Normal handling...
+        {
+#ifdef TIA_LAZY_COLLISIONS
+            // Once the span list is full we check collisions as we draw until the next read or CXCLR
+            if (bLazyCollisions && (myCollisionSpans < COLLISION_SPANS)) handleObjectsLazyCollisions(clocksToUpdate, hpos);
+            else
+#endif
+            handleObjectsAndCollisions(clocksToUpdate, hpos);
+        }
+    }
+}
+
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// A skipped frame draws nothing but the game can still read the collision
+// registers - so note down the spans drawSpan() would have checked instead.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+inline __attribute__((always_inline)) void TIA::skipSpan(Int32 clocksToUpdate, Int32 hpos)
+{
+    if(myPF != 0)
+      myEnabledObjects |= myPFBit;
+    else
+      myEnabledObjects &= ~myPFBit;
+
+    if (!(myVBLANK & 0x02) && !bNoCollisionDetection) noteCollisionSpan(clocksToUpdate, hpos);
+    myFramePointer += clocksToUpdate;
+}
+#endif
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 ITCM_CODE void TIA::updateFrame(Int32 clock)
@@ -1296,62 +1343,11 @@ ITCM_CODE void TIA::updateFrame(Int32 clock)
 
     if (clocksToUpdate)
     {
-        // If we are updating, make sure the Enabled Objects register is up to date...
-        if(myPF != 0)
-          myEnabledObjects |= myPFBit;
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+        if (bFrameSkipAdaptive) skipSpan(clocksToUpdate, clocksFromStartOfScanLine - HBLANK);
         else
-          myEnabledObjects &= ~myPFBit;
-
-        // See if we're in the vertical blank region
-        if(myVBLANK & 0x02)
-        {
-            // -------------------------------------------------------------------------------------------
-            // Some games present a fairly static screen from frame to frame and so there is really no
-            // reason to blank the memory which can be time consuming... so check the flag for the cart
-            // currently being emulated...
-            // -------------------------------------------------------------------------------------------
-            if (myCartInfo.vblankZero || !(gAtariFrames & 0x0E))    // Every 16 frames we will do two frames proper vBlank despite the cartInfo (two is needed as some games display different data on alternating frames)
-            {
-                memset(myFramePointer, 0x00, clocksToUpdate);
-            }
-            myFramePointer += clocksToUpdate;
-        }
-        else if (myEnabledObjects == 0x00)  // Background handling...
-        {
-            memset(myFramePointer, myColor[MYCOLUBK], clocksToUpdate);
-            myFramePointer += clocksToUpdate;
-        }
-        else  // All other possibilities... this is expensive CPU-wise
-        {
-            Int32 hpos = clocksFromStartOfScanLine - HBLANK;
-            if (bNoCollisionDetection)  // If we are Optimizing the ARM Thumb with NO collisions...
-            {
-                if ((myEnabledObjects|myPlayfieldPriorityAndScore) == myPFBit) // Playfield bit set... without priority/score (common in CDF/J/+ games)
-                {
-                       uInt8* ending = myFramePointer + clocksToUpdate;  // Calculate the ending frame pointer value
-                       uInt32* mask = &myCurrentPFMask[hpos];
-                       // Since a 32-bit access to main memory is always split as 16-bits, we can just align to 16 bits
-                       if ((uInt32)myFramePointer & 1)
-                       {
-                           *myFramePointer++ = myColor[(myPF & *mask++) ? MYCOLUPF:MYCOLUBK];
-                       }
-                       // Now, update a uInt32 at a time
-                       for(; myFramePointer < ending; myFramePointer += 4, mask += 4)
-                       {
-                         *((uInt32*)myFramePointer) = myColor[(myPF & *mask) ? MYCOLUPF:MYCOLUBK];
-                       }
-                       myFramePointer = ending;
-                }
-                else
-                {
-                    handleObjectsNoCollisions(clocksToUpdate, hpos);
-                }
-            }
-            else    // Normal handling...
-            {
-                handleObjectsAndCollisions(clocksToUpdate, hpos);
-            }
-        }
+#endif
+        drawSpan(clocksToUpdate, clocksFromStartOfScanLine - HBLANK);
     }
 
     // Handle HMOVE blanks if they are enabled
@@ -1360,6 +1356,9 @@ ITCM_CODE void TIA::updateFrame(Int32 clock)
         Int32 blanks = (HBLANK + 8) - clocksFromStartOfScanLine;
         if (blanks > 0)
         {
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+            if (!bFrameSkipAdaptive)
+#endif
             memset(oldFramePointer, 0, blanks);
 
             if((clocksToUpdate + clocksFromStartOfScanLine) >= (HBLANK + 8))
@@ -1380,6 +1379,14 @@ ITCM_CODE void TIA::updateFrame(Int32 clock)
     // See if we're at the end of a scanline
     if(myClocksToEndOfScanLine == 228)
     {
+#ifdef TIA_DIRTY_LINES
+      // Remember what the line we just finished looks like (a skipped line is left as it was)
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+      if (!bFrameSkipAdaptive)
+#endif
+      if (myScanLine < 300) myLineHash[myCurrentFrame][myScanLine] = hashLine(myFramePointer - 160);
+#endif
+
       // Yes, so set PF mask based on current CTRLPF reflection state
       myCurrentPFMask = ourPlayfieldTable[myCTRLPF & 0x01];
 
@@ -1509,16 +1516,40 @@ ITCM_CODE void TIA::updateFrame(Int32 clock)
               break;
           }
       }
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+      else if (!bFrameSkipAdaptive)     // A skipped frame has nothing new to show - leave the DS screen as it is
+#else
       else
+#endif
       {
           // ------------------------------------------------------------------------------------------------------------------------
           // To help with caching issues and DMA transfers, we are actually copying the 160 pixel scanline of the previous frame.
           // By using slightly "stale" data, we ensure that we are outputting the right data and not something previously cached.
           // DMA and ARM9 is tricky stuff... I'll admit I don't fully understand it and there is some voodoo... but this works.
           // ------------------------------------------------------------------------------------------------------------------------
+#ifdef TIA_DIRTY_LINES
+          // The line going out was drawn two frames ago (see above) so its hash is already known
+          uInt32 hash = (myScanLine < 298) ? myLineHash[myCurrentFrame][myScanLine + 2] : 0;
+          if (myForcePushFrames || (myScanLine >= 298) || (myScreenHash[myScanLine] != hash))
+          {
+              if (myScanLine < 298) myScreenHash[myScanLine] = hash;
+              dmaCopyWordsAsynch(3, myFramePointer+160, myDSFramePointer, 160);
+#ifdef TIA_STATS
+              myLinesPushed++;
+              gLinesPushed++;
+#endif
+          }
+#ifdef TIA_STATS
+          else gLinesSkipped++;
+#endif
+#else
           dmaCopyWordsAsynch(3, myFramePointer+160, myDSFramePointer, 160);
+#endif
       }
       myDSFramePointer += 128;  // 16-bit address... so this is 256 bytes
+#ifdef TIA_DIRTY_LINES
+      myScanLine++;
+#endif
     }
   }
   while(myClockAtLastUpdate < clock);
@@ -1568,7 +1599,19 @@ ITCM_CODE uInt8 TIA::peek(uInt16 addr)
     if (addr < 8)
     {
         // Update frame to current color clock before we look at anything!
+#ifdef TIA_DEFERRED_RENDER
+        if (myWriteLogCount) flushWriteLog();
+#endif
         updateFrame((3*gSystemCycles));
+#ifdef TIA_COLLISION_SPANS
+#ifdef TIA_STATS
+        gCollisionReads++;
+#endif
+#ifdef TIA_LAZY_COLLISIONS
+        bCollisionRead = 1;
+#endif
+        if (myCollisionSpans) resolveCollisions();
+#endif
         if (!myCollision) {return noise;}
         switch(addr)
         {
@@ -1711,114 +1754,361 @@ ITCM_CODE uInt8 TIA::peek(uInt16 addr)
       }
     }
 
-    case 0x0C:    // INPT4
-      return myConsole->controller(Controller::Left).read(Controller::Six) ? (0x80 | noise) : noise;
+    case 0x0C:    // INPT4
+      return myConsole->controller(Controller::Left).read(Controller::Six) ? (0x80 | noise) : noise;
+
+    case 0x0D:    // INPT5
+      return myConsole->controller(Controller::Right).read(Controller::Six) ? (0x80 | noise) : noise;
+
+    default:
+      return noise;
+    }
+}
+
+uInt8 poke_needs_update_display[] __attribute__((section(".dtcm"))) =
+{
+    1,1,0,1,1,1,1,1,   1,1,1,1,1,1,1,1,
+    1,1,1,1,1,0,0,0,   0,0,0,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,   1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,   1,1,1,1,1,1,1,1
+};
+
+#ifdef TIA_DEFERRED_RENDER
+// The registers handled by pokeDisplayRegister() - these go into the scanline write log
+uInt8 poke_deferred[] __attribute__((section(".dtcm"))) =
+{
+    0,0,0,0,0,0,1,1,   1,1,0,0,0,1,1,1,
+    0,0,0,0,0,0,0,0,   0,0,0,1,1,1,1,1,
+    0,0,0,0,0,0,0,0,   0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,   0,0,0,0,0,0,0,0
+};
+#endif
+
+uInt8 player_reset_pos[] =
+{
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,  16,
+   17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,
+   37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,
+   57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
+   77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,
+   97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116,
+  117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136,
+  137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156,
+  157, 158, 159,   0,   1,   2,   3,   4
+};
+
+void __attribute__ ((noinline))  ResetBallEarlyHack(Int32 clock, uInt8 hpos)
+{
+  // This is a special hack for Escape from the Mindmaster (AR) and Mission Survive (4K)
+  if((clock - myLastHMOVEClock) == (18 * 3))
+  {
+    if ((hpos == 60) || (hpos == 69))  myPOSBL = 10; // Escape from the Mindmaster (01/09/99)
+    else if (hpos == 63)
+    {
+          if (myCartInfo.special == SPEC_AR) myPOSBL = 9; // Labyrinth AR (prototype)
+          else  myPOSBL = 7; // Mission Survive (04/11/08)
+    }
+  }
+  // This is a special hack for Escape from the Mindmaster 
+  else if(((clock - myLastHMOVEClock) == (15 * 3)) && (hpos == 60))
+  {
+    myPOSBL = 10;
+  }
+  // This is a special hack for Decathlon 
+  else if(((clock - myLastHMOVEClock) == (3 * 3)) && (hpos == 18))
+  {
+    myPOSBL = 3;
+  }
+  // This is a special hack for Robot Tank 
+  else if(((clock - myLastHMOVEClock) == (7 * 3)) && (hpos == 30))
+  {
+    myPOSBL = 6;
+  }
+  // This is a special hack for Hole Hunter
+  else if(((clock - myLastHMOVEClock) == (6 * 3)) && (hpos == 27))
+  {
+    myPOSBL = 5;
+  }
+  // This is a special hack for Swoops! 
+  else if(((clock - myLastHMOVEClock) == (9 * 3)) && (hpos == 36))
+  {
+    myPOSBL = 7;
+  }
+  // This is a special hack for Solaris 
+  else if(((clock - myLastHMOVEClock) == (12 * 3)) && (hpos == 45))
+  {
+    myPOSBL = 8;
+  }
+  // This is a special hack for Pole Position
+  else if(((clock - myLastHMOVEClock) == (21 * 3)) && (hpos == 72))
+  {
+    myPOSBL = 8;
+  }
+  // This is a special hack for Moon Patrol
+  else if(((clock - myLastHMOVEClock) == (20 * 3)) && (hpos == 69))
+  {
+      myPOSBL = 8;
+  }          
+#ifdef TIA_HMOVE_DEBUG
+  else if ((clock - myLastHMOVEClock) <= (23 * 3))
+  {
+      debug[8] = (clock - myLastHMOVEClock)/3;
+      debug[9] = hpos;
+  }
+#endif      
+}
+
+// Hack to GI Joe for early hits of Missile Position during HMOVE... this helps to fix the massive graphical glitches though it's not perfect
+void HackGIJoe(Int32 clock)
+{
+    if ((clock - myLastHMOVEClock) == (8 * 3))
+    {
+      myHMP1 = (myHMP1 + 1) % 160;
+    }
+    else if ((clock - myLastHMOVEClock) == (21 * 3))
+    {
+      myHMP1 = (myHMP1 + 2) % 160;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The registers that only change what gets drawn. This is shared between
+// poke() - which always calls it with a constant register so the switch
+// folds away - and the scanline write log playback.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static inline __attribute__((always_inline)) void pokeDisplayRegister(uInt8 addr, uInt8 value)
+{
+  switch(addr)
+  {
+    case 0x06:    // Color-Luminance Player 0
+    {
+      myColor[MYCOLUP0] = color_repeat_table[value];
+      break;
+    }
+
+    case 0x07:    // Color-Luminance Player 1
+    {
+      myColor[MYCOLUP1] = color_repeat_table[value];
+      break;
+    }
+
+    case 0x08:    // Color-Luminance Playfield
+    {
+      myColor[MYCOLUPF] = color_repeat_table[value];
+      break;
+    }
+
+    case 0x09:    // Color-Luminance Background
+    {
+      myColor[MYCOLUBK] = color_repeat_table[value];
+      break;
+    }
+
+    case 0x0D:    // Playfield register byte 0
+    {
+      myPF = (myPF & 0x000FFFF0) | ((value >> 4) & 0x0F);
+      break;
+    }
+
+    case 0x0E:    // Playfield register byte 1
+    {
+      myPF = (myPF & 0x000FF00F) | ((uInt32)value << 4);
+      break;
+    }
+
+    case 0x0F:    // Playfield register byte 2
+    {
+      myPF = (myPF & 0x00000FFF) | ((uInt32)value << 12);
+      break;
+    }
+
+    case 0x1B: // Graphics Player 0
+    {
+      // Set player 0 graphics
+      myGRP0 = value;
+
+      // Copy player 1 graphics into its delayed register
+      myDGRP1 = myGRP1;
+
+      // Get the "current" data for GRP0 base on delay register and reflect
+      uInt8 grp0 = myVDELP0 ? myDGRP0 : myGRP0;
+      myCurrentGRP0 = myREFP0 ? ourPlayerReflectTable[grp0] : grp0;
+
+      // Get the "current" data for GRP1 base on delay register and reflect
+      uInt8 grp1 = myVDELP1 ? myDGRP1 : myGRP1;
+      myCurrentGRP1 = myREFP1 ? ourPlayerReflectTable[grp1] : grp1;
+
+      // Set enabled object bits
+      if(myCurrentGRP0 != 0)
+        myEnabledObjects |= myP0Bit;
+      else
+        myEnabledObjects &= ~myP0Bit;
+
+      if(myCurrentGRP1 != 0)
+        myEnabledObjects |= myP1Bit;
+      else
+        myEnabledObjects &= ~myP1Bit;
+      break;
+    }
+
+    case 0x1C: // Graphics Player 1
+    {
+      // Set player 1 graphics
+      myGRP1 = value;
+
+      // Copy player 0 graphics into its delayed register
+      myDGRP0 = myGRP0;
+
+      // Copy ball graphics into its delayed register
+      myDENABL = myENABL;
+
+      // Get the "current" data for GRP0 base on delay register
+      uInt8 grp0 = myVDELP0 ? myDGRP0 : myGRP0;
+      myCurrentGRP0 = myREFP0 ? ourPlayerReflectTable[grp0] : grp0;
+
+      // Get the "current" data for GRP1 base on delay register
+      uInt8 grp1 = myVDELP1 ? myDGRP1 : myGRP1;
+      myCurrentGRP1 = myREFP1 ? ourPlayerReflectTable[grp1] : grp1;
+
+      // Set enabled object bits
+      if(myCurrentGRP0 != 0)
+        myEnabledObjects |= myP0Bit;
+      else
+        myEnabledObjects &= ~myP0Bit;
+
+      if(myCurrentGRP1 != 0)
+        myEnabledObjects |= myP1Bit;
+      else
+        myEnabledObjects &= ~myP1Bit;
+
+      if(myVDELBL ? myDENABL : myENABL)
+        myEnabledObjects |= myBLBit;
+      else
+        myEnabledObjects &= ~myBLBit;
+      break;
+    }
+
+    case 0x1D:    // Enable Missle 0 graphics
+    {
+      myENAM0 = value & 0x02;
+
+      if(myENAM0 && !myRESMP0)
+        myEnabledObjects |= myM0Bit;
+      else
+        myEnabledObjects &= ~myM0Bit;
+      break;
+    }
+
+    case 0x1E:    // Enable Missle 1 graphics
+    {
+      myENAM1 = value & 0x02;
+
+      if(myENAM1 && !myRESMP1)
+        myEnabledObjects |= myM1Bit;
+      else
+        myEnabledObjects &= ~myM1Bit;
+      break;
+    }
+
+    case 0x1F:    // Enable Ball graphics
+    {
+      myENABL = value & 0x02;
 
-    case 0x0D:    // INPT5
-      return myConsole->controller(Controller::Right).read(Controller::Six) ? (0x80 | noise) : noise;
+      if(myVDELBL ? myDENABL : myENABL)
+        myEnabledObjects |= myBLBit;
+      else
+        myEnabledObjects &= ~myBLBit;
 
-    default:
-      return noise;
+      break;
     }
+  }
 }
 
-uInt8 poke_needs_update_display[] __attribute__((section(".dtcm"))) =
+#ifdef TIA_DEFERRED_RENDER
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Play back the scanline write log. Everything in the log is on the same
+// scanline so once the frame is brought up to the first write the rest of
+// the line up to the last write is drawn in a single pass - each write is
+// made to the registers as the pass reaches its clock, exactly as poke()
+// would have done at the time, without going back through updateFrame()
+// for every span. While VBLANK is on (nothing we log can change a blanked
+// pixel) the writes just land in the registers. Anything the single pass
+// doesn't cover (frame skipping or a log running off the edge of the display)
+// plays back the slow way a write at a time.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ITCM_CODE void TIA::flushWriteLog()
 {
-    1,1,0,1,1,1,1,1,   1,1,1,1,1,1,1,1,
-    1,1,1,1,1,0,0,0,   0,0,0,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,   1,1,1,1,1,1,1,1,
-    1,1,1,1,1,1,1,1,   1,1,1,1,1,1,1,1
-};
+  uInt8 count = myWriteLogCount;
+  uInt8 i = 0;
 
-uInt8 player_reset_pos[] =
-{
-    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
-    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
-    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
-    3,   3,   3,   3,   3,   3,   3,   3,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,  15,  16,
-   17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,
-   37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51,  52,  53,  54,  55,  56,
-   57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,  72,  73,  74,  75,  76,
-   77,  78,  79,  80,  81,  82,  83,  84,  85,  86,  87,  88,  89,  90,  91,  92,  93,  94,  95,  96,
-   97,  98,  99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116,
-  117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127, 128, 129, 130, 131, 132, 133, 134, 135, 136,
-  137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156,
-  157, 158, 159,   0,   1,   2,   3,   4
-};
+  myWriteLogCount = 0;
+#ifdef TIA_STATS
+  gTIAWriteLogFlushes++;
+#endif
 
-void __attribute__ ((noinline))  ResetBallEarlyHack(Int32 clock, uInt8 hpos)
-{
-  // This is a special hack for Escape from the Mindmaster (AR) and Mission Survive (4K)
-  if((clock - myLastHMOVEClock) == (18 * 3))
-  {
-    if ((hpos == 60) || (hpos == 69))  myPOSBL = 10; // Escape from the Mindmaster (01/09/99)
-    else if (hpos == 63)
-    {
-          if (myCartInfo.special == SPEC_AR) myPOSBL = 9; // Labyrinth AR (prototype)
-          else  myPOSBL = 7; // Mission Survive (04/11/08)
-    }
-  }
-  // This is a special hack for Escape from the Mindmaster 
-  else if(((clock - myLastHMOVEClock) == (15 * 3)) && (hpos == 60))
-  {
-    myPOSBL = 10;
-  }
-  // This is a special hack for Decathlon 
-  else if(((clock - myLastHMOVEClock) == (3 * 3)) && (hpos == 18))
-  {
-    myPOSBL = 3;
-  }
-  // This is a special hack for Robot Tank 
-  else if(((clock - myLastHMOVEClock) == (7 * 3)) && (hpos == 30))
-  {
-    myPOSBL = 6;
-  }
-  // This is a special hack for Hole Hunter
-  else if(((clock - myLastHMOVEClock) == (6 * 3)) && (hpos == 27))
-  {
-    myPOSBL = 5;
-  }
-  // This is a special hack for Swoops! 
-  else if(((clock - myLastHMOVEClock) == (9 * 3)) && (hpos == 36))
-  {
-    myPOSBL = 7;
-  }
-  // This is a special hack for Solaris 
-  else if(((clock - myLastHMOVEClock) == (12 * 3)) && (hpos == 45))
+  updateFrame(myWriteLogClock[0]);
+
+  if (myVBLANK & 0x02)
   {
-    myPOSBL = 8;
+      for (; i < count-1; i++)
+      {
+          pokeDisplayRegister(myWriteLogData[i] >> 8, myWriteLogData[i] & 0xFF);
+      }
   }
-  // This is a special hack for Pole Position
-  else if(((clock - myLastHMOVEClock) == (21 * 3)) && (hpos == 72))
+  else if ((myClockAtLastUpdate == myWriteLogClock[0]) && (myWriteLogClock[count-1] <= myClockStopDisplay) &&
+           ((myWriteLogClock[count-1] - myClockAtLastUpdate) < myClocksToEndOfScanLine) && !bFrameSkipCDFJ
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+           && !bFrameSkipAdaptive
+#endif
+          )
   {
-    myPOSBL = 8;
+      Int32 lineStart = myClockAtLastUpdate - (228 - myClocksToEndOfScanLine);
+      Int32 from = 228 - myClocksToEndOfScanLine;                 // Clocks from the start of the line drawn so far
+      Int32 firstDrawn = (from < HBLANK) ? HBLANK : from;         // ...and where the pixels we draw start
+      uInt8* firstPixel = myFramePointer;
+
+      for (; i < count; i++)
+      {
+          Int32 to = myWriteLogClock[i] - lineStart;
+          if (to > from)
+          {
+              if (to > HBLANK)
+              {
+                  Int32 hpos = ((from < HBLANK) ? HBLANK : from) - HBLANK;
+                  drawSpan(to - HBLANK - hpos, hpos);
+              }
+              if ((228 - to) < 190) myBlendBk = myColor[MYCOLUBK];
+              from = to;
+          }
+          pokeDisplayRegister(myWriteLogData[i] >> 8, myWriteLogData[i] & 0xFF);
+      }
+
+      myClocksToEndOfScanLine = 228 - from;
+      myClockAtLastUpdate = lineStart + from;
+
+      // The HMOVE blank over the first 8 pixels - the same as updateFrame() leaves it
+      if (myHMOVEBlankEnabled)
+      {
+          Int32 blanks = (HBLANK + 8) - firstDrawn;
+          if (blanks > 0)
+          {
+              memset(firstPixel, 0, blanks);
+              if (from >= (HBLANK + 8)) myHMOVEBlankEnabled = false;
+          }
+      }
+      return;
   }
-  // This is a special hack for Moon Patrol
-  else if(((clock - myLastHMOVEClock) == (20 * 3)) && (hpos == 69))
-  {
-      myPOSBL = 8;
-  }          
-#ifdef TIA_HMOVE_DEBUG
-  else if ((clock - myLastHMOVEClock) <= (23 * 3))
+
+  for (; i < count; i++)
   {
-      debug[8] = (clock - myLastHMOVEClock)/3;
-      debug[9] = hpos;
+      updateFrame(myWriteLogClock[i]);
+      pokeDisplayRegister(myWriteLogData[i] >> 8, myWriteLogData[i] & 0xFF);
   }
-#endif      
-}
-
-// Hack to GI Joe for early hits of Missile Position during HMOVE... this helps to fix the massive graphical glitches though it's not perfect
-void HackGIJoe(Int32 clock)
-{
-    if ((clock - myLastHMOVEClock) == (8 * 3))
-    {
-      myHMP1 = (myHMP1 + 1) % 160;
-    }
-    else if ((clock - myLastHMOVEClock) == (21 * 3))
-    {
-      myHMP1 = (myHMP1 + 2) % 160;
-    }
 }
+#endif
 
 #ifndef TIA_HMOVE_DEBUG
 ITCM_CODE 
@@ -1829,6 +2119,12 @@ void TIA::poke(uInt16 addr, uInt8 value)
   Int32 delta_clock;
   addr = addr & 0x003f;
 
+#ifdef TIA_WRITE_DIGEST
+  gTIAWrites++;
+  TIA_DIGEST(gSystemCycles);
+  TIA_DIGEST((addr << 8) | value);
+#endif
+
   // Update frame to current CPU cycle before we make any changes!
   if (poke_needs_update_display[addr])
   {
@@ -1845,7 +2141,36 @@ void TIA::poke(uInt16 addr, uInt8 value)
       {
         delay = delay_tab[delta_clock % 228];
       }
+#ifdef TIA_DEFERRED_RENDER
+      if (poke_deferred[addr])
+      {
+          // ------------------------------------------------------------------------
+          // Just log the write... a new scanline (or a full log) plays back the
+          // old one first so the log never holds more than the current scanline.
+          // ------------------------------------------------------------------------
+          clock += delay;
+          if (myWriteLogCount && ((clock >= myWriteLogLineEnd) || (myWriteLogCount == WRITE_LOG_SIZE)))
+          {
+              flushWriteLog();
+          }
+          if (myWriteLogCount == 0)
+          {
+              myWriteLogLineEnd = clock - ((clock - myClockWhenFrameStarted) % 228) + 228;
+          }
+          myWriteLogClock[myWriteLogCount] = clock;
+          myWriteLogData[myWriteLogCount++] = (addr << 8) | value;
+#ifdef TIA_STATS
+          gTIAWritesDeferred++;
+#endif
+      }
+      else
+      {
+          if (myWriteLogCount) flushWriteLog();
+          updateFrame(clock + delay);
+      }
+#else
       updateFrame(clock + delay);
+#endif
   }
   else
   {
@@ -1862,6 +2187,10 @@ void TIA::poke(uInt16 addr, uInt8 value)
       }
   }
 
+#ifdef TIA_DEFERRED_RENDER
+  if (poke_deferred[addr]) return;  // The register change itself happens when the log is played back
+#endif
+
   switch(addr)
   {
     case 0x00:    // Vertical sync set-clear
@@ -1941,28 +2270,20 @@ void TIA::poke(uInt16 addr, uInt8 value)
     }
 
     case 0x06:    // Color-Luminance Player 0
-    {
-      myColor[MYCOLUP0] = color_repeat_table[value];
+      pokeDisplayRegister(0x06, value);
       break;
-    }
 
     case 0x07:    // Color-Luminance Player 1
-    {
-      myColor[MYCOLUP1] = color_repeat_table[value];
+      pokeDisplayRegister(0x07, value);
       break;
-    }
 
     case 0x08:    // Color-Luminance Playfield
-    {
-      myColor[MYCOLUPF] = color_repeat_table[value];
+      pokeDisplayRegister(0x08, value);
       break;
-    }
 
     case 0x09:    // Color-Luminance Background
-    {
-      myColor[MYCOLUBK] = color_repeat_table[value];
+      pokeDisplayRegister(0x09, value);
       break;
-    }
 
     case 0x0A:    // Control Playfield, Ball size, Collisions
     {
@@ -2011,22 +2332,16 @@ void TIA::poke(uInt16 addr, uInt8 value)
     }
 
     case 0x0D:    // Playfield register byte 0
-    {
-      myPF = (myPF & 0x000FFFF0) | ((value >> 4) & 0x0F);
+      pokeDisplayRegister(0x0D, value);
       break;
-    }
 
     case 0x0E:    // Playfield register byte 1
-    {
-      myPF = (myPF & 0x000FF00F) | ((uInt32)value << 4);
+      pokeDisplayRegister(0x0E, value);
       break;
-    }
 
     case 0x0F:    // Playfield register byte 2
-    {
-      myPF = (myPF & 0x00000FFF) | ((uInt32)value << 12);
+      pokeDisplayRegister(0x0F, value);
       break;
-    }
 
     case 0x10:    // Reset Player 0
     {
@@ -2062,7 +2377,7 @@ void TIA::poke(uInt16 addr, uInt8 value)
 #endif      
 
       // Find out under what condition the player is being reset
-      Int8 when = ourPlayerPositionResetWhenTable[myNUSIZ0 & 7][myPOSP0][newx];
+      Int8 when = playerPositionResetWhen(myNUSIZ0 & 7, myPOSP0, newx);
 
       // Player is being reset in neither the delay nor display section
       if (when == 0)
@@ -2131,7 +2446,7 @@ void TIA::poke(uInt16 addr, uInt8 value)
 #endif
 
       // Find out under what condition the player is being reset
-      Int8 when = ourPlayerPositionResetWhenTable[myNUSIZ1 & 7][myPOSP1][newx];
+      Int8 when = playerPositionResetWhen(myNUSIZ1 & 7, myPOSP1, newx);
 
       // Player is being reset in neither the delay nor display section
       if (when == 0)
@@ -2259,132 +2574,58 @@ void TIA::poke(uInt16 addr, uInt8 value)
     }
 
     case 0x15:    // Audio control 0
+          TIA_SOUND_WRITE(0, value & 0x0f);
           AUDC[0] = value & 0x0f;
           Update_tia_sound_0();
           break;
     case 0x16:    // Audio control 1
+          TIA_SOUND_WRITE(1, value & 0x0f);
           AUDC[1] = value & 0x0f;
           Update_tia_sound_1();
           break;
 
     case 0x17:    // Audio frequency 0
+          TIA_SOUND_WRITE(2, value & 0x1f);
           AUDF[0] = value & 0x1f;
           Update_tia_sound_0();
           break;
     case 0x18:    // Audio frequency 1
+          TIA_SOUND_WRITE(3, value & 0x1f);
           AUDF[1] = value & 0x1f;
           Update_tia_sound_1();
           break;
 
     case 0x19:    // Audio volume 0
+          TIA_SOUND_WRITE(4, value & 0x0f);
           AUDV[0] = (value & 0x0f) << 3;
           Update_tia_sound_0();
           break;
 
     case 0x1A:    // Audio volume 1
+          TIA_SOUND_WRITE(5, value & 0x0f);
           AUDV[1] = (value & 0x0f) << 3;
           Update_tia_sound_1();
           break;
 
     case 0x1B: // Graphics Player 0
-    {
-      // Set player 0 graphics
-      myGRP0 = value;
-
-      // Copy player 1 graphics into its delayed register
-      myDGRP1 = myGRP1;
-
-      // Get the "current" data for GRP0 base on delay register and reflect
-      uInt8 grp0 = myVDELP0 ? myDGRP0 : myGRP0;
-      myCurrentGRP0 = myREFP0 ? ourPlayerReflectTable[grp0] : grp0;
-
-      // Get the "current" data for GRP1 base on delay register and reflect
-      uInt8 grp1 = myVDELP1 ? myDGRP1 : myGRP1;
-      myCurrentGRP1 = myREFP1 ? ourPlayerReflectTable[grp1] : grp1;
-
-      // Set enabled object bits
-      if(myCurrentGRP0 != 0)
-        myEnabledObjects |= myP0Bit;
-      else
-        myEnabledObjects &= ~myP0Bit;
-
-      if(myCurrentGRP1 != 0)
-        myEnabledObjects |= myP1Bit;
-      else
-        myEnabledObjects &= ~myP1Bit;
+      pokeDisplayRegister(0x1B, value);
       break;
-    }
 
     case 0x1C: // Graphics Player 1
-    {
-      // Set player 1 graphics
-      myGRP1 = value;
-
-      // Copy player 0 graphics into its delayed register
-      myDGRP0 = myGRP0;
-
-      // Copy ball graphics into its delayed register
-      myDENABL = myENABL;
-
-      // Get the "current" data for GRP0 base on delay register
-      uInt8 grp0 = myVDELP0 ? myDGRP0 : myGRP0;
-      myCurrentGRP0 = myREFP0 ? ourPlayerReflectTable[grp0] : grp0;
-
-      // Get the "current" data for GRP1 base on delay register
-      uInt8 grp1 = myVDELP1 ? myDGRP1 : myGRP1;
-      myCurrentGRP1 = myREFP1 ? ourPlayerReflectTable[grp1] : grp1;
-
-      // Set enabled object bits
-      if(myCurrentGRP0 != 0)
-        myEnabledObjects |= myP0Bit;
-      else
-        myEnabledObjects &= ~myP0Bit;
-
-      if(myCurrentGRP1 != 0)
-        myEnabledObjects |= myP1Bit;
-      else
-        myEnabledObjects &= ~myP1Bit;
-
-      if(myVDELBL ? myDENABL : myENABL)
-        myEnabledObjects |= myBLBit;
-      else
-        myEnabledObjects &= ~myBLBit;
+      pokeDisplayRegister(0x1C, value);
       break;
-    }
 
     case 0x1D:    // Enable Missle 0 graphics
-    {
-      myENAM0 = value & 0x02;
-
-      if(myENAM0 && !myRESMP0)
-        myEnabledObjects |= myM0Bit;
-      else
-        myEnabledObjects &= ~myM0Bit;
+      pokeDisplayRegister(0x1D, value);
       break;
-    }
 
     case 0x1E:    // Enable Missle 1 graphics
-    {
-      myENAM1 = value & 0x02;
-
-      if(myENAM1 && !myRESMP1)
-        myEnabledObjects |= myM1Bit;
-      else
-        myEnabledObjects &= ~myM1Bit;
+      pokeDisplayRegister(0x1E, value);
       break;
-    }
 
     case 0x1F:    // Enable Ball graphics
-    {
-      myENABL = value & 0x02;
-
-      if(myVDELBL ? myDENABL : myENABL)
-        myEnabledObjects |= myBLBit;
-      else
-        myEnabledObjects &= ~myBLBit;
-
+      pokeDisplayRegister(0x1F, value);
       break;
-    }
 
     case 0x20:    // Horizontal Motion Player 0
     {
@@ -2640,6 +2881,9 @@ void TIA::poke(uInt16 addr, uInt8 value)
     case 0x2c:    // Clear collision latches
     {
       myCollision = 0;
+#ifdef TIA_COLLISION_SPANS
+      myCollisionSpans = 0;   // Nothing drawn before the clear matters now
+#endif
       break;
     }
 
@@ -2651,19 +2895,22 @@ void TIA::poke(uInt16 addr, uInt8 value)
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt8 TIA::ourBallMaskTable[4][4][320];
+static constexpr TIABallMaskTable ballMaskTable;
+const uInt8 (&TIA::ourBallMaskTable)[4][4][320] = ballMaskTable.table;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt8 TIA::ourDisabledMaskTable[640];
+const uInt8 TIA::ourDisabledMaskTable[640] __attribute__ ((aligned (4))) = {0};
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt8 TIA::ourMissleMaskTable[4][8][4][320];
+static constexpr TIAMissleMaskTable missleMaskTable;
+const uInt8 (&TIA::ourMissleMaskTable)[4][8][4][320] = missleMaskTable.table;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-uInt8 TIA::ourPlayerMaskTable[4][2][8][320];
+uInt8 TIA::ourPlayerMaskTable[4][2][8][320] __attribute__ ((aligned (4)));   // Mask pointers must stay on a uInt32 boundary
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-Int8 TIA::ourPlayerPositionResetWhenTable[8][160][160];
+static constexpr TIAPlayerPositionResetWhenTable playerPositionResetWhenTable;
+const Int8 (&TIA::ourPlayerPositionResetWhenTable)[8][160] = playerPositionResetWhenTable.table;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 const uInt32 TIA::ourNTSCPalette[256] =
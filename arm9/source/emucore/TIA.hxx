@@ -45,9 +45,104 @@ class System;
 #define     NUSIZ0          4
 #define     NUSIZ1          5
 
+// ---------------------------------------------------------------------------------
+// Uncomment to keep a running FNV-1a hash of every TIA register write along with
+// the CPU cycle it landed on - used on the host to check that two builds of the
+// core (e.g. with and without M6502_CYCLE_ACCOUNTING) write the same values on
+// exactly the same cycles. See host/cyclecheck.sh
+// ---------------------------------------------------------------------------------
+//#define TIA_WRITE_DIGEST   TRUE
+
+#ifdef TIA_WRITE_DIGEST
+extern uInt32 gTIAWrites;
+extern uInt32 gTIAWriteDigest;
+#endif
+
+// ---------------------------------------------------------------------------------
+// Uncomment to have the optional renderers below count what they do (writes
+// deferred, collision spans worked out, lines pushed) for the headless runner to
+// report. Always on in the host build - on the DS each count would just be one
+// more main RAM write on the drawing path.
+// ---------------------------------------------------------------------------------
+//#define TIA_STATS   TRUE
+
+#if defined(HOST_BUILD) && !defined(TIA_STATS)
+#define TIA_STATS   TRUE
+#endif
+
+// ---------------------------------------------------------------------------------
+// Uncomment to have writes to the registers that only change what gets drawn
+// (COLUxx, PF0-PF2, GRP0/GRP1 and ENAM0/ENAM1/ENABL) appended to a small log for
+// the current scanline instead of bringing the frame up to date on every write.
+// The log is played back once the scanline is done or as soon as anything else
+// needs the frame to be current - any other display register write, a collision
+// register read or the end of the frame. The whole line is then drawn in one go
+// from the log (and while VBLANK is on the writes just land in the registers).
+// ---------------------------------------------------------------------------------
+//#define TIA_DEFERRED_RENDER   TRUE
+
+#if defined(TIA_DEFERRED_RENDER) && defined(TIA_STATS)
+extern uInt32 gTIAWritesDeferred;
+extern uInt32 gTIAWriteLogFlushes;
+#endif
+
+// ---------------------------------------------------------------------------------
+// Uncomment to draw the frame without collision checks and only work out the
+// collision bits when the game actually reads a collision register. While the
+// frame is drawn we just note down each span that could add a new collision
+// (the object state and mask pointers for it) - most games read the collision
+// registers once a frame if at all so usually that's all the work we ever do.
+// ---------------------------------------------------------------------------------
+//#define TIA_LAZY_COLLISIONS   TRUE
+
+// ---------------------------------------------------------------------------------
+// Uncomment to keep a hash of every scanline as it is drawn and only copy a line
+// out to the DS screen when it is different from what is already there. Static
+// screens (title screens, paused games, lots of puzzle games) then cost almost
+// nothing to put on the screen and the DMA stays off the bus for the CPU core.
+// ---------------------------------------------------------------------------------
+//#define TIA_DIRTY_LINES   TRUE
+
+#if defined(TIA_DIRTY_LINES) && defined(TIA_STATS)
+extern uInt32 gLinesPushed;
+extern uInt32 gLinesSkipped;
+extern uInt16 gLinesPushedLastFrame;
+#endif
+
+// ---------------------------------------------------------------------------------
+// Uncomment to skip drawing frames (for any cart - not just the ones flagged with
+// thumbOptimize 3) when the emulation falls behind. The front end tells us how long
+// each frame took to emulate against the time a frame has (1/50 or 1/60 sec) and we
+// keep a running total of how far behind that leaves us. Once we are more than half
+// a frame behind we start skipping and carry on until we have caught back up. The
+// 6502 (and ARM) still run every frame and all TIA register writes still land - we
+// just don't draw. Skips come in runs of at most two with at least two drawn frames
+// in between so games that flicker on alternate frames still show everything. The
+// collision registers still work on a skipped frame - the spans that could collide
+// are noted down as with TIA_LAZY_COLLISIONS and worked out if the game reads one.
+// ---------------------------------------------------------------------------------
+//#define TIA_ADAPTIVE_FRAMESKIP   TRUE
+
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+extern uInt8  bFrameSkipAdaptive;
+extern uInt32 gFramesSkipped;
+extern void   tiaFrameTime(uInt32 elapsed, uInt32 budget);
+#endif
+
+// Both of the above work out collisions later from a list of noted down spans
+#if defined(TIA_LAZY_COLLISIONS) || defined(TIA_ADAPTIVE_FRAMESKIP)
+#define TIA_COLLISION_SPANS   TRUE
+extern uInt16 myCollisionSpans;     // Spans drawn since the collision bits were last worked out
+#ifdef TIA_STATS
+extern uInt32 gCollisionReads;
+extern uInt32 gCollisionSpansResolved;
+extern uInt32 gCollisionSpansSkipped;
+#endif
+#endif
+
 // Used to set the collision register to the correct value
-extern uInt16 ourCollisionTable[256];
-extern uInt8 myPriorityEncoder[2][256];
+extern uInt16 (&ourCollisionTable)[256];
+extern uInt8 (&myPriorityEncoder)[2][256];
 
 extern uInt32 gAtariFrames, gTotalAtariFrames;
 
@@ -107,14 +202,14 @@ extern    uInt32 myCurrentGRP0;                  // Graphics for Player 0 that s
 extern    uInt32 myCurrentGRP1;                  // Graphics for Player 1 that should be displayed.  This will be reflected if the player is being reflected.
 
 // It's VERY important that the BL, M0, M1, P0 and P1 current mask pointers are always on a uInt32 boundary.  Otherwise, the TIA code will fail on a good number of CPUs.
-extern    uInt8* myCurrentBLMask;               // Pointer to the currently active mask array for the ball
-extern    uInt8* myCurrentM0Mask;               // Pointer to the currently active mask array for missle 0
-extern    uInt8* myCurrentM1Mask;               // Pointer to the currently active mask array for missle 1
-extern    uInt8* myCurrentP0Mask;               // Pointer to the currently active mask array for player 0
-extern    uInt8* myCurrentP1Mask;               // Pointer to the currently active mask array for player 1
+extern    const uInt8* myCurrentBLMask;             // Pointer to the currently active mask array for the ball
+extern    const uInt8* myCurrentM0Mask;             // Pointer to the currently active mask array for missle 0
+extern    const uInt8* myCurrentM1Mask;             // Pointer to the currently active mask array for missle 1
+extern    const uInt8* myCurrentP0Mask;             // Pointer to the currently active mask array for player 0
+extern    const uInt8* myCurrentP1Mask;             // Pointer to the currently active mask array for player 1
 extern    uInt32* myCurrentPFMask;                // Pointer to the currently active mask array for the playfield
-extern    uInt8 ourPlayerReflectTable[256];        // Used to reflect a players graphics
-extern    uInt32 ourPlayfieldTable[2][160];        // Playfield mask table for reflected and non-reflected playfields
+extern    const uInt8 (&ourPlayerReflectTable)[256];// Used to reflect a players graphics
+extern    uInt32 (&ourPlayfieldTable)[2][160];     // Playfield mask table for reflected and non-reflected playfields
 extern    uInt8 myNUSIZ0;       // Number and size of player 0 and missle 0
 extern    uInt8 myNUSIZ1;       // Number and size of player 1 and missle 1
 
@@ -225,36 +320,55 @@ class TIA : public Device
     */
     uInt32 width() const;
 
-  private:
-    // Compute the ball mask table
-    void computeBallMaskTable();
+#ifdef TIA_COLLISION_SPANS
+    // Work out the collision bits for all the spans drawn since the last time
+    void resolveCollisions();
+#endif
 
-    // Compute the collision decode table
-    void computeCollisionTable();
+#ifdef TIA_DIRTY_LINES
+    // The DS screen was changed behind our back - copy every line out again
+    void invalidateScreen();
+#endif
 
-    // Compute the missle mask table
-    void computeMissleMaskTable();
+    // Is a player (NUSIZ mode) at oldx being reset to newx during the delay (-1) or display (1) of one of its copies?
+    static inline Int8 playerPositionResetWhen(uInt8 mode, Int16 oldx, Int16 newx)
+    {
+      Int16 distance = newx - oldx;
+      if (distance < 0) distance += 160;
+      return ourPlayerPositionResetWhenTable[mode][distance];
+    }
 
+  private:
     // Compute the player mask table
     void computePlayerMaskTable();
 
-    // Compute the player position reset when table
-    void computePlayerPositionResetWhenTable();
-
-    // Compute the player reflect table
-    void computePlayerReflectTable();
-
-    // Compute playfield mask table
-    void computePlayfieldMaskTable();
-
     // Update the current frame buffer for objects and collisions
     void handleObjectsAndCollisions(Int32 clocksToUpdate, Int32 hpos);
     void handleObjectsNoCollisions(Int32 clocksToUpdate, Int32 hpos);
+#ifdef TIA_LAZY_COLLISIONS
+    void handleObjectsLazyCollisions(Int32 clocksToUpdate, Int32 hpos);
+#endif
+#ifdef TIA_COLLISION_SPANS
+    // Note down a span for resolveCollisions() if it could add a new collision
+    inline void noteCollisionSpan(Int32 clocksToUpdate, Int32 hpos);
+#endif
     
 
+    // Draw part of the current scanline with the registers as they stand
+    inline void drawSpan(Int32 clocksToUpdate, Int32 hpos);
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+    // Same as drawSpan() on a skipped frame - nothing is drawn but collisions are noted down
+    inline void skipSpan(Int32 clocksToUpdate, Int32 hpos);
+#endif
+
     // Update the current frame buffer to the specified color clock
     void updateFrame(Int32 clock);
 
+#ifdef TIA_DEFERRED_RENDER
+    // Play back any display register writes held in the scanline write log
+    void flushWriteLog();
+#endif
+
   private:
     // Console the TIA is associated with
     Console *myConsole;
@@ -268,19 +382,19 @@ class TIA : public Device
 
   private:
     // Ball mask table (entries are true or false)
-    static uInt8 ourBallMaskTable[4][4][320];
+    static const uInt8 (&ourBallMaskTable)[4][4][320];
 
     // A mask table which can be used when an object is disabled
-    static uInt8 ourDisabledMaskTable[640];
+    static const uInt8 ourDisabledMaskTable[640];
 
     // Missle mask table (entries are true or false)
-    static uInt8 ourMissleMaskTable[4][8][4][320];
+    static const uInt8 (&ourMissleMaskTable)[4][8][4][320];
 
     // Player mask table
     static uInt8 ourPlayerMaskTable[4][2][8][320];
 
-    // Indicates if player is being reset during delay, display or other times
-    static Int8 ourPlayerPositionResetWhenTable[8][160][160];
+    // Indicates if player is being reset during delay, display or other times - indexed by mode and distance (newx - oldx)
+    static const Int8 (&ourPlayerPositionResetWhenTable)[8][160];
 
     // Table of RGB values for NTSC
     static const uInt32 ourNTSCPalette[256];
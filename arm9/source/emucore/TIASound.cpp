@@ -139,6 +139,49 @@ uInt16 *tia_buf = (uInt16*) 0x06890000; // Use VRAM
 extern uInt16 *aptr;
 extern uInt16 *bptr;
 
+#ifdef TIA_SOUND_BLOCKS
+uInt8  bBlockSound        __attribute__((section(".dtcm"))) = 0;   // Set when this cart's sound is generated a block at a time
+uInt16 *tia_ring          __attribute__((section(".dtcm"))) = tia_ring_buffer; // The front end points this at an uncached view of the ring
+uInt32 tia_ring_idx       __attribute__((section(".dtcm"))) = 0;   // Next sample to be written (free running - masked on use)
+uInt32 tia_block_cycles   __attribute__((section(".dtcm"))) = 0;   // The 6502 cycle the sound has been generated up to
+uInt16 tia_ring_buffer[TIA_RING_SIZE] __attribute__ ((aligned (4))) = {0};  // Can't be placed in fast memory as ARM7 needs to access it...
+
+uInt32 gSoundBlocks = 0;        // Calls to Tia_process_block() that produced at least one audio clock
+uInt32 gSoundBlockSamples = 0;  // Samples written into the ring
+uInt32 gSoundRingResyncs = 0;   // Times we fell behind (or too far ahead of) the hardware and had to move
+#endif
+
+#ifdef TIA_SOUND_ARM7
+uInt8  bArm7Sound         __attribute__((section(".dtcm"))) = 0;   // Set when this cart's sound is made by the ARM7
+TiaSynthShared *tia_synth __attribute__((section(".dtcm"))) = &tia_synth_shared; // The front end points this at an uncached view
+uInt32 tia_synth_head     __attribute__((section(".dtcm"))) = 0;   // Our copy of tia_synth->head - never goes backwards
+TiaSynthShared tia_synth_shared __attribute__ ((aligned (32)));    // Can't be placed in fast memory as ARM7 needs to access it...
+
+uInt8  tia_synth_frame    __attribute__((section(".dtcm"))) = 0;   // Number of the last end of frame record handed over
+uInt32 tia_synth_frame_cycles[TIA_SYNTH_FRAME_LOG] __attribute__((section(".dtcm"))) = {0}; // And the lengths of the last few frames
+
+uInt32 gSoundRecords = 0;       // Register writes (and frame ends) handed to the ARM7
+uInt32 gSoundFifoFull = 0;      // Ones we had to drop because the ARM7 wasn't keeping up
+#endif
+
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+uInt16 tia_frame_samples  __attribute__((section(".dtcm"))) = 0;   // Samples in one frame - the rings are kept two of these ahead of the hardware
+#endif
+
+#ifdef TIA_SOUND_WAVE_LOG
+uInt8  bWaveLogSound      __attribute__((section(".dtcm"))) = 0;   // Set when this cart is WAVE DIRECT and its writes are logged
+uInt16 *tia_wave_ring     __attribute__((section(".dtcm"))) = tia_wave_ring_buffer; // The front end points this at an uncached view of the ring
+uint32_t tia_wave_idx     __attribute__((section(".dtcm"))) = 0;   // Next sample to be written (free running - masked on use)
+uInt32 tia_wave_count     __attribute__((section(".dtcm"))) = 0;   // AUDx writes logged so far this frame
+uInt32 tia_wave_log[TIA_WAVE_LOG_SIZE];                             // The AUDx writes as TIASynth records
+TiaSynth tia_wave_synth;                                            // Makes the sound from the log
+uInt16 tia_wave_ring_buffer[TIA_SYNTH_RING_SIZE] __attribute__ ((aligned (4))) = {0};  // Can't be placed in fast memory as ARM7 needs to access it...
+
+uInt32 gWaveRecords = 0;        // AUDx writes logged
+uInt32 gWaveSamples = 0;        // Samples made from them
+uInt32 gWaveResyncs = 0;        // Times we fell behind (or too far ahead of) the hardware and had to move
+#endif
+
 /*****************************************************************************/
 /* Module:  Tia_sound_init()                                                 */
 /* Purpose: to handle the power-up initialization functions                  */
@@ -189,6 +232,39 @@ void Tia_sound_init (uInt16 sample_freq, uInt16 playback_freq)
     
    tia_buf_idx = tia_out_idx = 0;
 
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+   tia_frame_samples = playback_freq / ((myCartInfo.tv_type == PAL) ? 50 : 60);
+#endif
+
+#ifdef TIA_SOUND_BLOCKS
+   // WAVE DIRECT keeps to the interrupt driven path - everything else (other than mute) is done in blocks
+   bBlockSound = ((myCartInfo.soundQuality != SOUND_MUTE) && (myCartInfo.soundQuality != SOUND_WAVE));
+   memset(tia_ring_buffer, 0x00, sizeof(tia_ring_buffer));
+   tia_ring_idx = 2 * tia_frame_samples;    // Start two frames ahead of the hardware
+   tia_block_cycles = 0;
+#endif
+
+#ifdef TIA_SOUND_ARM7
+   // WAVE DIRECT keeps to the interrupt driven path - everything else (other than mute) goes to the ARM7
+   bArm7Sound = ((myCartInfo.soundQuality != SOUND_MUTE) && (myCartInfo.soundQuality != SOUND_WAVE));
+   tia_synth_shared.bit9 = Bit9;
+   tia_synth_shared.frame_samples = tia_frame_samples;
+   tia_synth_frame = 0;
+#ifdef TIA_SOUND_BANDLIMITED
+   tia_synth_shared.bandlimited = 1;
+#endif
+#endif
+
+#ifdef TIA_SOUND_WAVE_LOG
+   // WAVE DIRECT is all about AUDV changing faster than any sample rate - so always band-limited
+   bWaveLogSound = (myCartInfo.soundQuality == SOUND_WAVE);
+   TiaSynth_init(&tia_wave_synth, sample_freq, playback_freq, Bit9);
+   TiaSynth_bandlimit(&tia_wave_synth, 1);
+   memset(tia_wave_ring_buffer, 0x00, sizeof(tia_wave_ring_buffer));
+   tia_wave_idx = 2 * tia_frame_samples;    // Start two frames ahead of the hardware
+   tia_wave_count = 0;
+#endif
+
     // A bit of speed-up to have this pre-computed
     for (uInt16 i=0; i<256; i++)
     {
@@ -292,6 +368,94 @@ ITCM_CODE void Update_tia_sound_1 (void)
    }
 }
 
+// -----------------------------------------------------------------------------
+// One tick of the '30 Khz' TIA audio clock for both channels. Shared by the
+// per-interrupt Tia_process() and the block mode Tia_process_block().
+// -----------------------------------------------------------------------------
+static inline __attribute__((always_inline)) void Tia_tick(void)
+{
+    /* Process channel 0 */
+    if (Div_n_cnt[0] > 1)
+    {
+       Div_n_cnt[0]--;
+    }
+    else if (Div_n_cnt[0] == 1)
+    {
+       Div_n_cnt[0] = Div_n_max[0];
+
+       if (++P5[0] == POLY5_SIZE) P5[0] = 0;
+        
+       /* check clock modifier for clock tick */
+       if  ( ((AUDC[0] & 0x02) == 0) ||
+             (((AUDC[0] & 0x01) == 0) && Div31[P5[0]]) ||
+             (((AUDC[0] & Bit5[P5[0]]))) )
+       {
+          if (AUDC[0] & 0x04)       /* pure modified clock selected */
+          {
+              Outvol[0] = (Outvol[0] ? 0:AUDV[0]);  // Toggle outvol
+          }
+          else if (AUDC[0] & 0x08)
+          {
+              if (AUDC[0] == POLY9)    /* check for poly9 */
+              {
+                 if (++P9[0] == POLY9_SIZE) P9[0]=0;
+                 Outvol[0] = Bit9[P9[0]] & AUDV[0];
+              }
+              else // Must be poly5
+              {
+                 Outvol[0] = (Bit5a[P5[0]] & AUDV[0]);
+              }
+          }
+          else  /* poly4 is the only remaining option */
+          {
+             if (++P4[0] == POLY4_SIZE) P4[0] = 0;
+             Outvol[0] = (Bit4[P4[0]] & AUDV[0]);
+          }
+       }
+    }
+
+
+    /* Process channel 1 */
+    if (Div_n_cnt[1] > 1)
+    {
+       Div_n_cnt[1]--;
+    }
+    else if (Div_n_cnt[1] == 1)
+    {
+       Div_n_cnt[1] = Div_n_max[1];
+
+       if (++P5[1] == POLY5_SIZE) P5[1] = 0;
+        
+       /* check clock modifier for clock tick */
+       if  ( ((AUDC[1] & 0x02) == 0) ||
+             (((AUDC[1] & 0x01) == 0) && Div31[P5[1]]) ||
+             (((AUDC[1] & Bit5[P5[1]]))) )
+       {
+          if (AUDC[1] & 0x04)       /* pure modified clock selected */
+          {
+              Outvol[1] = (Outvol[1] ? 0:AUDV[1]);  // Toggle outvol
+          }
+          else if (AUDC[1] & 0x08)
+          {
+              if (AUDC[1] == POLY9)    /* check for poly9 */
+              {
+                 if (++P9[1] == POLY9_SIZE) P9[1]=0;
+                 Outvol[1] = Bit9[P9[1]] & AUDV[1];
+              }
+              else // Must be poly5
+              {
+                 Outvol[1] = (Bit5a[P5[1]] & AUDV[1]);
+              }
+          }
+          else  /* poly4 is the only remaining option */
+          {
+             if (++P4[1] == POLY4_SIZE) P4[1] = 0;
+             Outvol[1] = (Bit4[P4[1]] & AUDV[1]);
+          }
+       }
+    }
+}
+
 /*****************************************************************************/
 /* Module:  Tia_process()                                                    */
 /* Purpose: To fill the output buffer with the sound output based on the     */
@@ -313,86 +477,7 @@ ITCM_CODE void Tia_process(void)
     /* loop until the buffer is filled */
     while (1)
     {
-       /* Process channel 0 */
-       if (Div_n_cnt[0] > 1)
-       {
-          Div_n_cnt[0]--;
-       }
-       else if (Div_n_cnt[0] == 1)
-       {
-          Div_n_cnt[0] = Div_n_max[0];
-
-          if (++P5[0] == POLY5_SIZE) P5[0] = 0;
-           
-          /* check clock modifier for clock tick */
-          if  ( ((AUDC[0] & 0x02) == 0) ||
-                (((AUDC[0] & 0x01) == 0) && Div31[P5[0]]) ||
-                (((AUDC[0] & Bit5[P5[0]]))) )
-          {
-             if (AUDC[0] & 0x04)       /* pure modified clock selected */
-             {
-                 Outvol[0] = (Outvol[0] ? 0:AUDV[0]);  // Toggle outvol
-             }
-             else if (AUDC[0] & 0x08)
-             {
-                 if (AUDC[0] == POLY9)    /* check for poly9 */
-                 {
-                    if (++P9[0] == POLY9_SIZE) P9[0]=0;
-                    Outvol[0] = Bit9[P9[0]] & AUDV[0];
-                 }
-                 else // Must be poly5
-                 {
-                    Outvol[0] = (Bit5a[P5[0]] & AUDV[0]);
-                 }
-             }
-             else  /* poly4 is the only remaining option */
-             {
-                if (++P4[0] == POLY4_SIZE) P4[0] = 0;
-                Outvol[0] = (Bit4[P4[0]] & AUDV[0]);
-             }
-          }
-       }
-
-
-       /* Process channel 1 */
-       if (Div_n_cnt[1] > 1)
-       {
-          Div_n_cnt[1]--;
-       }
-       else if (Div_n_cnt[1] == 1)
-       {
-          Div_n_cnt[1] = Div_n_max[1];
-
-          if (++P5[1] == POLY5_SIZE) P5[1] = 0;
-           
-          /* check clock modifier for clock tick */
-          if  ( ((AUDC[1] & 0x02) == 0) ||
-                (((AUDC[1] & 0x01) == 0) && Div31[P5[1]]) ||
-                (((AUDC[1] & Bit5[P5[1]]))) )
-          {
-             if (AUDC[1] & 0x04)       /* pure modified clock selected */
-             {
-                 Outvol[1] = (Outvol[1] ? 0:AUDV[1]);  // Toggle outvol
-             }
-             else if (AUDC[1] & 0x08)
-             {
-                 if (AUDC[1] == POLY9)    /* check for poly9 */
-                 {
-                    if (++P9[1] == POLY9_SIZE) P9[1]=0;
-                    Outvol[1] = Bit9[P9[1]] & AUDV[1];
-                 }
-                 else // Must be poly5
-                 {
-                    Outvol[1] = (Bit5a[P5[1]] & AUDV[1]);
-                 }
-             }
-             else  /* poly4 is the only remaining option */
-             {
-                if (++P4[1] == POLY4_SIZE) P4[1] = 0;
-                Outvol[1] = (Bit4[P4[1]] & AUDV[1]);
-             }
-          }
-       }
+       Tia_tick();
 
        /* decrement the sample counter - value is 256 since the lower
           byte contains the fractional part */
@@ -454,3 +539,190 @@ ITCM_CODE void Tia_process_wave (void)
     *aptr = *bptr = ((uInt16*)0x06890000)[tia_out_idx++];
     tia_out_idx &= (SOUND_SIZE-1);
 }
+
+#ifdef TIA_SOUND_BLOCKS
+// -----------------------------------------------------------------------------------------
+// Block mode: bring the sound up to date with the 6502. The TIA audio clock runs twice per
+// scanline (every 38 CPU cycles) so we step it as many times as the CPU has moved on since
+// the last call and drop the samples into the ring the ARM7 is looping over. This is called
+// just before any AUDx register changes so every write lands on the right audio clock.
+// -----------------------------------------------------------------------------------------
+ITCM_CODE void Tia_process_block(uInt32 cycles)
+{
+    if ((cycles - tia_block_cycles) < 38) return;
+    gSoundBlocks++;
+
+    do
+    {
+        tia_block_cycles += 38;
+
+        Tia_tick();
+
+        /* decrement the sample counter - value is 256 since the lower
+           byte contains the fractional part */
+        Samp_n_cnt -= 256;
+        if (Samp_n_cnt & 0xFF00) continue;
+        Samp_n_cnt += Samp_n_max;
+
+        tia_ring[tia_ring_idx++ & (TIA_RING_SIZE-1)] = *((uInt16 *)0x068A0000 + (Outvol[0] + Outvol[1])); //sampleExtender[(uInt16)Outvol[0] + (uInt16)Outvol[1]];
+        gSoundBlockSamples++;
+    }
+    while ((cycles - tia_block_cycles) >= 38);
+}
+
+// -----------------------------------------------------------------------------------------
+// End of frame: finish off the frame's samples and, since the 6502 cycle count is about to
+// go back to zero, rebase our position (keeping any part of an audio clock left over).
+// TIMER3 counts the samples the hardware has played (TIMER2 runs at the sample rate and
+// cascades into it) so this is also where we make sure we are still ahead of the hardware
+// but not so far ahead that we'd write over what it hasn't played yet. Normally the 6502
+// and the hardware run at the same rate and this never needs to do anything.
+// -----------------------------------------------------------------------------------------
+ITCM_CODE void Tia_process_frame(uInt32 cycles)
+{
+    Tia_process_block(cycles);
+    tia_block_cycles -= cycles;
+
+    // Keep between half a frame and the ring less a frame ahead - if not, go back to two frames ahead
+    Int16 ahead = (Int16)((uInt16)tia_ring_idx - (uInt16)TIMER3_DATA);
+    if ((ahead < (Int16)(tia_frame_samples / 2)) || (ahead > (TIA_RING_SIZE - tia_frame_samples)))
+    {
+        tia_ring_idx = (uInt16)TIMER3_DATA + (2 * tia_frame_samples);
+        gSoundRingResyncs++;
+    }
+}
+#endif
+
+#ifdef TIA_SOUND_ARM7
+// -----------------------------------------------------------------------------------------
+// Hand one AUDx write (reg 0-5 as the TIA address less 0x15) or the end of the frame over
+// to the ARM7. If the ARM7 has fallen a whole FIFO behind there's nothing sensible to do
+// but drop the write - we never wait on it. Frame ends are numbered and their lengths kept
+// so Tia_sound_ring_ahead() can tell how much we've logged that the ARM7 hasn't played.
+// -----------------------------------------------------------------------------------------
+ITCM_CODE void Tia_sound_record(uInt32 cycles, uInt8 reg, uInt8 value)
+{
+    if ((tia_synth_head - tia_synth->tail) >= TIA_SYNTH_FIFO_SIZE)
+    {
+        gSoundFifoFull++;
+        return;
+    }
+
+    if (reg == TIA_SYNTH_FRAME)
+    {
+        value = ++tia_synth_frame;
+        tia_synth_frame_cycles[value & (TIA_SYNTH_FRAME_LOG-1)] = cycles;
+    }
+
+    tia_synth->records[tia_synth_head & (TIA_SYNTH_FIFO_SIZE-1)] = TIA_SYNTH_RECORD(cycles, reg, value);
+    tia_synth->head = ++tia_synth_head;
+    gSoundRecords++;
+}
+#endif
+
+#ifdef TIA_SOUND_WAVE_LOG
+// -----------------------------------------------------------------------------------------
+// WAVE DIRECT: make the sound for everything logged so far - each write lands on the exact
+// audio clock it was made on and the level changes are resampled down to the output rate.
+// -----------------------------------------------------------------------------------------
+static void Tia_wave_play(void)
+{
+    for (uInt32 i = 0; i < tia_wave_count; i++)
+    {
+        gWaveSamples += TiaSynth_record(&tia_wave_synth, tia_wave_log[i], tia_wave_ring, TIA_SYNTH_RING_SIZE-1, &tia_wave_idx);
+    }
+    tia_wave_count = 0;
+}
+
+// -----------------------------------------------------------------------------------------
+// Log one AUDx write (reg 0-5 as the TIA address less 0x15) with its 6502 cycle. A game
+// that writes more than the log holds in one frame just has the sound made early.
+// -----------------------------------------------------------------------------------------
+ITCM_CODE void Tia_wave_record(uInt32 cycles, uInt8 reg, uInt8 value)
+{
+    if (tia_wave_count == TIA_WAVE_LOG_SIZE) Tia_wave_play();
+    tia_wave_log[tia_wave_count++] = TIA_SYNTH_RECORD(cycles, reg, value);
+    gWaveRecords++;
+}
+
+// -----------------------------------------------------------------------------------------
+// End of frame: make the frame's sound from its log and, as with Tia_process_frame(), make
+// sure we are still ahead of the samples the hardware has played (TIMER3) - but not so far
+// ahead that we'd write over what it hasn't played yet.
+// -----------------------------------------------------------------------------------------
+void Tia_wave_frame(uInt32 cycles)
+{
+    if (tia_wave_count == TIA_WAVE_LOG_SIZE) Tia_wave_play();
+    tia_wave_log[tia_wave_count++] = TIA_SYNTH_RECORD(cycles, TIA_SYNTH_FRAME, 0);
+    Tia_wave_play();
+
+    Int16 ahead = (Int16)((uInt16)tia_wave_idx - (uInt16)TIMER3_DATA);
+    if ((ahead < (Int16)(tia_frame_samples / 2)) || (ahead > (TIA_SYNTH_RING_SIZE - tia_frame_samples)))
+    {
+        tia_wave_idx = (uInt16)TIMER3_DATA + (2 * tia_frame_samples);
+        gWaveResyncs++;
+    }
+}
+#endif
+
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+// -----------------------------------------------------------------------------------------
+// How many samples the ring this cart's sound goes into is ahead of what the hardware has
+// played - what the front end paces its frames by. Returns false if the sound doesn't go
+// through a ring (mute, or the TIMER2 interrupt) so there's nothing to go by.
+// -----------------------------------------------------------------------------------------
+bool Tia_sound_ring_ahead(Int16 *ahead)
+{
+#ifdef TIA_SOUND_WAVE_LOG
+    if (bWaveLogSound)
+    {
+        *ahead = (Int16)((uInt16)tia_wave_idx - (uInt16)TIMER3_DATA);
+        return true;
+    }
+#endif
+#ifdef TIA_SOUND_BLOCKS
+    if (bBlockSound)
+    {
+        *ahead = (Int16)((uInt16)tia_ring_idx - (uInt16)TIMER3_DATA);
+        return true;
+    }
+#endif
+#ifdef TIA_SOUND_ARM7
+    if (bArm7Sound)
+    {
+        extern uInt16 mySoundFreq;
+
+        // The ARM7 has the sample counter and leaves this for us every millisecond - along
+        // with where it had played the log up to. It writes ahead first so if played is the
+        // same either side of reading it the two go together.
+        uInt32 played;
+        Int32 fill;
+        do
+        {
+            played = tia_synth->played;
+            fill = tia_synth->ahead;
+        }
+        while (played != tia_synth->played);
+
+        // Add on the frames we've ended that it hasn't finished making the sound for (less
+        // the part of the oldest one it has) - otherwise we'd be up to a frame short
+        uInt8 behind = tia_synth_frame - TIA_SYNTH_VALUE(played);
+        if (behind && (behind < TIA_SYNTH_FRAME_LOG))
+        {
+            uInt32 cycles = 0;
+            for (uInt8 i = 0; i < behind; i++)
+            {
+                cycles += tia_synth_frame_cycles[(uInt8)(tia_synth_frame - i) & (TIA_SYNTH_FRAME_LOG-1)];
+            }
+            if (cycles > TIA_SYNTH_CYCLE(played))
+            {
+                fill += ((cycles - TIA_SYNTH_CYCLE(played)) / TIA_SYNTH_CYCLES) * mySoundFreq / TIA_SYNTH_CLOCK;
+            }
+        }
+        *ahead = (Int16)fill;
+        return true;
+    }
+#endif
+    return false;
+}
+#endif
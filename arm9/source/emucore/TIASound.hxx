@@ -41,6 +41,56 @@
 #define POLY5_SIZE  0x001f
 #define POLY9_SIZE  0x01ff
 
+/* ------------------------------------------------------------------------- */
+/* Uncomment this to have the sound generated a block at a time instead of   */
+/* one sample per TIMER2 interrupt. The samples are synthesised on the 6502  */
+/* clock - whenever an AUDx register is written and at the end of the frame  */
+/* - into a ring buffer that the ARM7 plays on a loop. TIMER2/TIMER3 are     */
+/* left running without interrupts just to count the samples played so we   */
+/* know how far ahead of the hardware we are. WAVE DIRECT is not affected.   */
+/* ------------------------------------------------------------------------- */
+//#define TIA_SOUND_BLOCKS   TRUE
+
+/* ------------------------------------------------------------------------- */
+/* Uncomment this to have the ARM7 make the sound instead. Each AUDx write   */
+/* (and the end of each frame) is logged with its 6502 cycle into a FIFO in  */
+/* main RAM and the ARM7 plays the log through the TIASynth copy of the      */
+/* sound core (see common/TIASynth.c) into the ring the hardware loops over. */
+/* The ARM9 is left with nothing to do for sound but a few stores. Again,    */
+/* WAVE DIRECT is not affected. Can't be used along with TIA_SOUND_BLOCKS.   */
+/* ------------------------------------------------------------------------- */
+//#define TIA_SOUND_ARM7   TRUE
+
+/* ------------------------------------------------------------------------- */
+/* Uncomment this (along with TIA_SOUND_ARM7) to have the ARM7 make the      */
+/* samples out of band-limited steps instead of taking every Nth audio clock */
+/* so the lower sample rates don't alias. 15kHz then sounds about as clean   */
+/* as 30kHz does without it. See TiaSynth_bandlimit() in common/TIASynth.c.  */
+/* ------------------------------------------------------------------------- */
+//#define TIA_SOUND_BANDLIMITED   TRUE
+
+/* ------------------------------------------------------------------------- */
+/* Uncomment this to give WAVE DIRECT (digitized speech and fast fetcher     */
+/* music) its own path. Instead of stepping the sound a scanline at a time   */
+/* into a buffer that the TIMER2 interrupt empties - spinning when it fills  */
+/* and sampling AUDV whenever the interrupt happens to fire - each AUDx      */
+/* write is logged with its 6502 cycle and the frame's log is resampled      */
+/* (band-limited - see common/TIASynth.c) into a ring at the frame's end.   */
+/* The ARM7 loops over the ring like TIA_SOUND_BLOCKS - no interrupt, no     */
+/* waiting. Can be used with either of the above for the other carts.        */
+/* ------------------------------------------------------------------------- */
+//#define TIA_SOUND_WAVE_LOG   TRUE
+
+#if defined(TIA_SOUND_BLOCKS) && defined(TIA_SOUND_ARM7)
+#error "TIA_SOUND_BLOCKS and TIA_SOUND_ARM7 can't both be used"
+#endif
+#if defined(TIA_SOUND_BANDLIMITED) && !defined(TIA_SOUND_ARM7)
+#error "TIA_SOUND_BANDLIMITED needs TIA_SOUND_ARM7"
+#endif
+
+/* the size (in samples) of the block mode ring buffer - must be a power of 2 */
+#define TIA_RING_SIZE   2048
+
 
 void Tia_sound_init (unsigned short sample_freq, unsigned short playback_freq);
 void Update_tia_sound_0(void);
@@ -68,4 +118,52 @@ extern uInt32 Samp_n_cnt;
 
 extern uInt16 *tia_buf;
 
+#ifdef TIA_SOUND_BLOCKS
+void Tia_process_block (uInt32 cycles);
+void Tia_process_frame (uInt32 cycles);
+
+extern uInt8  bBlockSound;
+extern uInt16 tia_ring_buffer[TIA_RING_SIZE];
+extern uInt16 *tia_ring;
+extern uInt32 gSoundBlocks;
+extern uInt32 gSoundBlockSamples;
+extern uInt32 gSoundRingResyncs;
+#endif
+
+#ifdef TIA_SOUND_ARM7
+#include "TIASynth.h"
+
+#define TIA_SYNTH_FRAME_LOG 4   // Frame lengths kept for working out how far behind the ARM7 is - must be a power of 2
+
+void Tia_sound_record (uInt32 cycles, uInt8 reg, uInt8 value);
+
+extern uInt8  bArm7Sound;
+extern TiaSynthShared tia_synth_shared;
+extern TiaSynthShared *tia_synth;
+extern uInt32 gSoundRecords;
+extern uInt32 gSoundFifoFull;
+#endif
+
+#if defined(TIA_SOUND_BLOCKS) || defined(TIA_SOUND_ARM7) || defined(TIA_SOUND_WAVE_LOG)
+bool Tia_sound_ring_ahead (Int16 *ahead);
+
+extern uInt16 tia_frame_samples;
+#endif
+
+#ifdef TIA_SOUND_WAVE_LOG
+#include "TIASynth.h"
+
+#define TIA_WAVE_LOG_SIZE   1024    // AUDx writes logged before the sound has to be made mid-frame
+
+void Tia_wave_record (uInt32 cycles, uInt8 reg, uInt8 value);
+void Tia_wave_frame (uInt32 cycles);
+
+extern uInt8  bWaveLogSound;
+extern uInt16 tia_wave_ring_buffer[TIA_SYNTH_RING_SIZE];
+extern uInt16 *tia_wave_ring;
+extern uInt32 gWaveRecords;
+extern uInt32 gWaveSamples;
+extern uInt32 gWaveResyncs;
+#endif
+
 #endif
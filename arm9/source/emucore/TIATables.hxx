@@ -0,0 +1,409 @@
+//============================================================================
+//
+//   SSSS    tt          lll  lll
+//  SS  SS   tt           ll   ll
+//  SS     tttttt  eeee   ll   ll   aaaa
+//   SSSS    tt   ee  ee  ll   ll      aa
+//      SS   tt   eeeeee  ll   ll   aaaaa  --  "An Atari 2600 VCS Emulator"
+//  SS  SS   tt   ee      ll   ll  aa  aa
+//   SSSS     ttt  eeeee llll llll  aaaaa
+//
+// Copyright (c) 1995-2024 by Bradford W. Mott, Stephen Anthony
+// and the Stella Team
+//
+// This file has been modified by Dave Bernazzani (wavemotion-dave)
+// for optimized execution on the DS/DSi platform. Please seek the
+// official Stella source distribution which is far cleaner, newer,
+// and better maintained.
+//
+// See the file "License.txt" for information on usage and redistribution of
+// this file, and for a DISCLAIMER OF ALL WARRANTIES.
+//============================================================================
+
+#ifndef TIATABLES_HXX
+#define TIATABLES_HXX
+
+#include "bspf.hxx"
+#include "TIA.hxx"
+
+/**
+  The TIA lookup tables that never change once built. Each one is a small
+  struct with a constexpr constructor holding what used to be the matching
+  TIA::computeXXXTable() so the compiler works the table out and it is
+  loaded with the program instead of being built every time we boot.
+
+  Only TIA.cpp should include this - it places the tables (the hot ones
+  in DTCM) and gives them their usual names.
+
+  @author  Dave Bernazzani
+*/
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIABallMaskTable
+{
+  uInt8 table[4][4][320] __attribute__ ((aligned (4)));   // Mask pointers must stay on a uInt32 boundary
+
+  constexpr TIABallMaskTable() : table()
+  {
+    // First, calculate masks for alignment 0
+    for(Int32 size = 0; size < 4; ++size)
+    {
+      // Set the necessary fields true (everything else starts out false)
+      for(Int32 x = 0; x < 160 + 8; ++x)
+      {
+        if((x >= 0) && (x < (1 << size)))
+        {
+          table[0][size][x % 160] = true;
+        }
+      }
+
+      // Copy fields into the wrap-around area of the mask
+      for(Int32 x = 0; x < 160; ++x)
+      {
+        table[0][size][x + 160] = table[0][size][x];
+      }
+    }
+
+    // Now, copy data for alignments of 1, 2 and 3
+    for(uInt32 align = 1; align < 4; ++align)
+    {
+      for(uInt32 size = 0; size < 4; ++size)
+      {
+        for(uInt32 x = 0; x < 320; ++x)
+        {
+          table[align][size][x] = table[0][size][(x + 320 - align) % 320];
+        }
+      }
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIACollisionTable
+{
+  uInt16 table[256];
+
+  constexpr TIACollisionTable() : table()
+  {
+    for(uInt16 i = 0; i < 64; ++i)
+    {
+      if((i & myM0Bit) && (i & myP1Bit))    // M0-P1
+        table[i] |= 0x0001;
+
+      if((i & myM0Bit) && (i & myP0Bit))    // M0-P0
+        table[i] |= 0x0002;
+
+      if((i & myM1Bit) && (i & myP0Bit))    // M1-P0
+        table[i] |= 0x0004;
+
+      if((i & myM1Bit) && (i & myP1Bit))    // M1-P1
+        table[i] |= 0x0008;
+
+      if((i & myP0Bit) && (i & myPFBit))    // P0-PF
+        table[i] |= 0x0010;
+
+      if((i & myP0Bit) && (i & myBLBit))    // P0-BL
+        table[i] |= 0x0020;
+
+      if((i & myP1Bit) && (i & myPFBit))    // P1-PF
+        table[i] |= 0x0040;
+
+      if((i & myP1Bit) && (i & myBLBit))    // P1-BL
+        table[i] |= 0x0080;
+
+      if((i & myM0Bit) && (i & myPFBit))    // M0-PF
+        table[i] |= 0x0100;
+
+      if((i & myM0Bit) && (i & myBLBit))    // M0-BL
+        table[i] |= 0x0200;
+
+      if((i & myM1Bit) && (i & myPFBit))    // M1-PF
+        table[i] |= 0x0400;
+
+      if((i & myM1Bit) && (i & myBLBit))    // M1-BL
+        table[i] |= 0x0800;
+
+      if((i & myBLBit) && (i & myPFBit))    // BL-PF
+        table[i] |= 0x1000;
+
+      if((i & myP0Bit) && (i & myP1Bit))    // P0-P1
+        table[i] |= 0x2000;
+
+      if((i & myM0Bit) && (i & myM1Bit))    // M0-M1
+        table[i] |= 0x4000;
+    }
+
+    // The score and priority bits don't change what collides
+    for(uInt16 i = 64; i < 256; i++)
+    {
+      table[i] = table[i % 64];
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAMissleMaskTable
+{
+  uInt8 table[4][8][4][320] __attribute__ ((aligned (4)));
+
+  constexpr TIAMissleMaskTable() : table()
+  {
+    // First, calculate masks for alignment 0 (everything starts out false)
+    for(Int32 number = 0; number < 8; ++number)
+    {
+      for(Int32 size = 0; size < 4; ++size)
+      {
+        for(Int32 x = 0; x < 160 + 72; ++x)
+        {
+          // Only one copy of the missle
+          if((number == 0x00) || (number == 0x05) || (number == 0x07))
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+          // Two copies - close
+          else if(number == 0x01)
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 16) >= 0) && ((x - 16) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+          // Two copies - medium
+          else if(number == 0x02)
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+          // Three copies - close
+          else if(number == 0x03)
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 16) >= 0) && ((x - 16) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+          // Two copies - wide
+          else if(number == 0x04)
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 64) >= 0) && ((x - 64) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+          // Three copies - medium
+          else if(number == 0x06)
+          {
+            if((x >= 0) && (x < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 32) >= 0) && ((x - 32) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+            else if(((x - 64) >= 0) && ((x - 64) < (1 << size)))
+              table[0][number][size][x % 160] = true;
+          }
+        }
+
+        // Copy data into wrap-around area
+        for(Int32 x = 0; x < 160; ++x)
+          table[0][number][size][x + 160] = table[0][number][size][x];
+      }
+    }
+
+    // Now, copy data for alignments of 1, 2 and 3
+    for(uInt32 align = 1; align < 4; ++align)
+    {
+      for(uInt32 number = 0; number < 8; ++number)
+      {
+        for(uInt32 size = 0; size < 4; ++size)
+        {
+          for(uInt32 x = 0; x < 320; ++x)
+          {
+            table[align][number][size][x] = table[0][number][size][(x + 320 - align) % 320];
+          }
+        }
+      }
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAPlayerPositionResetWhenTable
+{
+  Int8 table[8][160];
+
+  constexpr TIAPlayerPositionResetWhenTable() : table()
+  {
+    // Where each copy of the player starts for the 8 NUSIZ modes (0xFF ends the list)
+    constexpr uInt8 copies[8][4] = {
+      {0, 0xFF}, {0, 16, 0xFF}, {0, 32, 0xFF}, {0, 16, 32, 0xFF},
+      {0, 64, 0xFF}, {0, 0xFF}, {0, 32, 64, 0xFF}, {0, 0xFF}
+    };
+
+    // -----------------------------------------------------------------------
+    // The answer only depends on how far past the old position the new one
+    // is (wrapping around at 160) so we loop through all player modes and
+    // distances and determine where the new position is located:
+    // 1 means the new position is within the display of an old copy of the
+    // player, -1 means the new position is within the delay portion of an
+    // old copy of the player, and 0 means it's neither of these two.
+    // Each copy is 4 clocks of delay and then 8 clocks of display (16 for
+    // the double width player and 32 for the quad width player).
+    // -----------------------------------------------------------------------
+    for(uInt32 mode = 0; mode < 8; ++mode)
+    {
+      uInt32 width = (mode == 0x05) ? 16 : ((mode == 0x07) ? 32 : 8);
+
+      for(uInt32 distance = 0; distance < 160; ++distance)
+      {
+        for(uInt32 copy = 0; copies[mode][copy] != 0xFF; ++copy)
+        {
+          uInt32 start = copies[mode][copy];
+          if((distance >= start) && (distance < (start + 4)))
+            table[mode][distance] = -1;
+          else if((distance >= start + 4) && (distance < (start + 4 + width)))
+            table[mode][distance] = 1;
+        }
+      }
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAPlayerReflectTable
+{
+  uInt8 table[256];
+
+  constexpr TIAPlayerReflectTable() : table()
+  {
+    for(uInt16 i = 0; i < 256; ++i)
+    {
+      uInt8 r = 0;
+
+      for(uInt16 t = 1; t <= 128; t *= 2)
+      {
+        r = (r << 1) | ((i & t) ? 0x01 : 0x00);
+      }
+
+      table[i] = r;
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAPlayfieldTable
+{
+  uInt32 table[2][160];
+
+  constexpr TIAPlayfieldTable() : table()
+  {
+    // Compute playfield mask table for non-reflected mode
+    for(Int32 x = 0; x < 160; ++x)
+    {
+      if(x < 16)
+      {
+        table[0][x] = table[1][x] = 0x00001 << (x / 4);
+      }
+      else if(x < 48)
+      {
+        table[0][x] = table[1][x] = 0x00800 >> ((x - 16) / 4);
+      }
+      else if(x < 80)
+      {
+        table[0][x] = table[1][x] = 0x01000 << ((x - 48) / 4);
+      }
+      else if(x < 96)
+      {
+        table[0][x] = 0x00001 << ((x - 80) / 4);
+      }
+      else if(x < 128)
+      {
+        table[0][x] = 0x00800 >> ((x - 96) / 4);
+      }
+      else if(x < 160)
+      {
+        table[0][x] = 0x01000 << ((x - 128) / 4);
+      }
+    }
+
+    // Compute playfield mask table for reflected mode
+    for(Int32 x = 80; x < 160; ++x)
+    {
+      if(x < 112)
+        table[1][x] = 0x80000 >> ((x - 80) / 4);
+      else if(x < 144)
+        table[1][x] = 0x00010 << ((x - 112) / 4);
+      else if(x < 160)
+        table[1][x] = 0x00008 >> ((x - 144) / 4);
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Which of the 4 colors (BK, PF, P0, P1) wins for each combination of the
+// enabled bits - the second half is for the right side of the screen in
+// score mode.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAPriorityEncoder
+{
+  uInt8 table[2][256];
+
+  constexpr TIAPriorityEncoder() : table()
+  {
+    for(uInt16 x = 0; x < 2; ++x)
+    {
+      for(uInt16 enabled = 0; enabled < 256; ++enabled)
+      {
+        uInt8 color = 0;
+
+        if(enabled & PriorityBit)
+        {
+          if((enabled & (myP1Bit | myM1Bit)) != 0)
+            color = 3;
+          if((enabled & (myP0Bit | myM0Bit)) != 0)
+            color = 2;
+          if((enabled & myBLBit) != 0)
+            color = 1;
+          if((enabled & myPFBit) != 0)
+            color = 1;  // NOTE: Playfield has priority so ScoreBit isn't used
+        }
+        else
+        {
+          if((enabled & myBLBit) != 0)
+            color = 1;
+          if((enabled & myPFBit) != 0)
+            color = (enabled & ScoreBit) ? ((x == 0) ? 2 : 3) : 1;
+          if((enabled & (myP1Bit | myM1Bit)) != 0)
+            color = 3;
+          if((enabled & (myP0Bit | myM0Bit)) != 0)
+            color = 2;
+        }
+
+        table[x][enabled] = color;
+      }
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// A COLUxx value repeated across all 4 bytes of a word (the low bit of the
+// color register isn't used so it's dropped here too).
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+struct TIAColorRepeatTable
+{
+  uInt32 table[256];
+
+  constexpr TIAColorRepeatTable() : table()
+  {
+    for(uInt32 i = 0; i < 256; i += 2)
+    {
+      table[i]   = (i << 24) | (i << 16) | (i << 8) | i;
+      table[i+1] = (i << 24) | (i << 16) | (i << 8) | i;
+    }
+  }
+};
+
+#endif
@@ -25,6 +25,8 @@
 //============================================================================
 #define THUMB_SUPPORT
 #include <nds.h>
+#include <string.h>
+#include <stdlib.h>
 #include "bspf.hxx"
 #include "Thumbulator.hxx"
 #include "Cart.hxx"
@@ -35,37 +37,146 @@ uInt8 *myARMRAM      __attribute__((section(".dtcm"))) = 0;
 
 //#define SAFE_THUMB  1     // This enables the Safe Thumb check... otherwise we are ALWAYS UNSAFE (needed for speed)
 
-#define MEM_256KB   (1024 * 256)        // We decode the ROM out here in the cart_buffer[] which limits us to 256K of ARM code (that's huge)
-
 uInt32 cStack, cBase, cStart;           // The DPC+ and CDF/J/+ drivers need to set these before usign the Thumbulator
 
+#define MEM_256KB   (1024 * 256)        // Images up to this size have their ROM decoded out here in the cart_buffer[]
+
+uInt8 *thumbDecoded = NULL;             // The decoded ops - the upper half of cart_buffer[] or from the heap for a bigger image
+uInt32 thumbRomMask __attribute__((section(".dtcm"))) = ROMADDMASK;
+uInt32 thumbPagesDecoded = 0;
+
+static uInt32  decodedPages[THUMB_PAGES/32];    // A bit for each page of thumbDecoded[] that's been decoded
+static uInt16 *romImage = NULL;                 // What's decoded - and how (see decodePage())
+static bool    fusePairs = true;
+static bool    liveFlags = true;
+
+#if defined(THUMB_FLAG_LIVENESS) && defined(HOST_BUILD)
+uInt8  thumbLiveFlags[ROMSIZE/2];
+#endif
+
 #ifdef CPU_PROFILER
 u32 profiler[256];
+u32 profiler_pairs[256*256];
+#endif
+
+#ifdef THUMB_TRANSLATOR
+bool   bThumbTranslate = false;
+bool   bThumbTranslateCheck = false;
+uInt32 thumbZNflags = 0;
+uInt32 thumbVflag = 0;
+uInt32 thumbSteps = 0;
 #endif
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-Thumbulator::Thumbulator(uInt16* rom_ptr)
+Thumbulator::Thumbulator(uInt16* rom_ptr, uInt32 size, bool fuse, bool liveness)
 {
-    for(uInt32 i=0; i < ROMSIZE/2; i++)
+    // Nothing is decoded until it runs - every op starts out as Op::undecoded
+    romImage = rom_ptr;
+    fusePairs = fuse;
+    liveFlags = liveness;
+    uInt32 romSize = THUMB_PAGE_SIZE;
+    while ((romSize < size) && (romSize < ROMSIZE)) romSize <<= 1;
+    thumbRomMask = romSize - 1;
+    if (romSize <= MEM_256KB) thumbDecoded = &cart_buffer[MEM_256KB];  // Free for anything up to 256K
+    else thumbDecoded = (uInt8 *)malloc(romSize/2);                     // Only one Thumbulator is ever around at a time
+    if (thumbDecoded) memset(thumbDecoded, (uInt8)Op::undecoded, romSize/2);   // Cartridge::create() turns the cart down if not
+    memset(decodedPages, 0x00, sizeof(decodedPages));
+    thumbPagesDecoded = 0;
+#if defined(THUMB_FLAG_LIVENESS) && defined(HOST_BUILD)
+    memset(thumbLiveFlags, THUMB_FLAG_ALL, ROMSIZE/2);
+#endif
+
+#ifdef THUMB_TRANSLATOR
+    ThumbTranslator::flush();
+    if (bThumbTranslate) fusePairs = false;     // The translator steps the interpreter an instruction at a time
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Decode one page of the ARM code - called from execute() the first time it runs into
+// an Op::undecoded. The flag liveness and the superinstructions are worked out for the
+// page on its own: nothing is fused across the end of a page and anything leaving the
+// page is taken to need all of the flags.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Thumbulator::decodePage(uInt32 page)
+{
+    uInt32 first = page * THUMB_PAGE_OPS;
+    for(uInt32 i=first; i < first+THUMB_PAGE_OPS; i++)
     {
-        Thumbulator::Op decoded = decodeInstructionWord(*rom_ptr++);
-        cart_buffer[MEM_256KB+i] = (uInt8)decoded;
+        Thumbulator::Op decoded = decodeInstructionWord(romImage[i]);
+        thumbDecoded[i] = (uInt8)decoded;
     }    
+
+#ifdef THUMB_FLAG_LIVENESS
+    // Before the superinstructions so the pairs can be made from the carry-less ops too
+    if (liveFlags) findLiveFlags(first);
+#endif
+
+#ifdef THUMB_SUPERINSTRUCTIONS
+    // ------------------------------------------------------------------------------------
+    // Second pass - each op that starts one of the common pairs becomes the superinstruction
+    // for the pair. The second op is left alone so anything that branches straight to it
+    // still finds it. Going forwards means the second op is always still the plain one.
+    // ------------------------------------------------------------------------------------
+    if (fusePairs)
+    {
+        for(uInt32 i=first; i < first+THUMB_PAGE_OPS-1; i++)
+        {
+            Thumbulator::Op fused = fuseInstructions((Thumbulator::Op)thumbDecoded[i], (Thumbulator::Op)thumbDecoded[i+1]);
+            thumbDecoded[i] = (uInt8)fused;
+        }
+    }
+#endif
+
+    decodedPages[page >> 5] |= (1 << (page & 31));
+    thumbPagesDecoded++;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// For anything that looks at the decoded ops without running them (the host's translator)
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Thumbulator::decodeAt(uInt32 addr)
+{
+    uInt32 page = (addr & thumbRomMask) / THUMB_PAGE_SIZE;
+    if (!(decodedPages[page >> 5] & (1 << (page & 31)))) decodePage(page);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Thumbulator::~Thumbulator()
 {
+    // Only the big ARM carts need their own buffer for the decoded ops so give the memory back
+    if (thumbDecoded != &cart_buffer[MEM_256KB]) free(thumbDecoded);
+    thumbDecoded = NULL;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 ITCM_CODE void Thumbulator::run( void )
 {
   reset();
+#ifdef THUMB_TRANSLATOR
+  // Timed (either way) so the host can give the MIPS of a game's ARM code
+  ThumbTranslator::startTiming();
+  if (bThumbTranslate) ThumbTranslator::run(this);
+  else execute();
+  ThumbTranslator::stopTiming();
+  return;
+#endif
   execute();
   return;
 }
 
+#ifdef THUMB_TRANSLATOR
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool Thumbulator::step(uInt32 count)
+{
+  thumbSteps = count + 1;
+  execute();
+  bool stepped = (thumbSteps == 0);
+  thumbSteps = 0;
+  return stepped;
+}
+#endif
+
 #define write8(addr, data)  (*(uInt8*)(myARMRAM + (addr & RAMADDMASK)) = data)
 #define write16(addr, data) (*(uInt16*)(myARMRAM + (addr & RAMADDMASK)) = data)
 #define write32(addr, data) (*(uInt32*)(myARMRAM + (addr & RAMADDMASK)) = data)
@@ -502,34 +613,338 @@ Thumbulator::Op Thumbulator::decodeInstructionWord(uint16_t inst)
   return Op::invalid;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Thumbulator::Op Thumbulator::fuseInstructions(Op first, Op second)
+{
+  switch (first)
+  {
+      //CMP(1) followed by BEQ, BNE, BCS or BCC
+      case Op::cmp1_r0: case Op::cmp1_r1: case Op::cmp1_r2: case Op::cmp1_r3:
+      case Op::cmp1_r4: case Op::cmp1_r5: case Op::cmp1_r6: case Op::cmp1_r7:
+          if ((second == Op::b1_000_pos) || (second == Op::b1_000_neg)) return Op::cmp1_beq;
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::cmp1_bne;
+          if (second == Op::b1_200) return Op::cmp1_bcs;
+          if (second == Op::b1_300) return Op::cmp1_bcc;
+          break;
+
+      //CMP(2) followed by BEQ or BNE
+      case Op::cmp2: case Op::cmp2_r2: case Op::cmp2_r3:
+          if ((second == Op::b1_000_pos) || (second == Op::b1_000_neg)) return Op::cmp2_beq;
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::cmp2_bne;
+          break;
+
+      //SUB(2) followed by BNE - the usual count down loop
+      case Op::sub2:
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::sub2_bne;
+          break;
+
+      //The same again for the ops that have been left without the carry
+      case Op::cmp1_nc:
+          if ((second == Op::b1_000_pos) || (second == Op::b1_000_neg)) return Op::cmp1_beq_nc;
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::cmp1_bne_nc;
+          break;
+
+      case Op::cmp2_nc:
+          if ((second == Op::b1_000_pos) || (second == Op::b1_000_neg)) return Op::cmp2_beq_nc;
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::cmp2_bne_nc;
+          break;
+
+      case Op::sub2_nc:
+          if ((second == Op::b1_100_pos) || (second == Op::b1_100_neg)) return Op::sub2_bne_nc;
+          break;
+
+      //LDR(1) followed by LDR(1)
+      case Op::ldr1_r0: case Op::ldr1_r1: case Op::ldr1_r2: case Op::ldr1_r3:
+      case Op::ldr1_r4: case Op::ldr1_r5: case Op::ldr1_r6: case Op::ldr1_r7:
+          switch (second)
+          {
+              case Op::ldr1_r0: case Op::ldr1_r1: case Op::ldr1_r2: case Op::ldr1_r3:
+              case Op::ldr1_r4: case Op::ldr1_r5: case Op::ldr1_r6: case Op::ldr1_r7:
+                  return Op::ldr1_ldr1;
+              default:
+                  break;
+          }
+          break;
+
+      //ADD(3) followed by STR(1)
+      case Op::add3:
+          if (second == Op::str1) return Op::add3_str1;
+          break;
+
+      //STR(1) followed by ADD(2) - store and move the pointer on
+      case Op::str1:
+          switch (second)
+          {
+              case Op::add2_r0: case Op::add2_r1: case Op::add2_r2: case Op::add2_r3:
+              case Op::add2_r4: case Op::add2_r5: case Op::add2_r6: case Op::add2_r7:
+              case Op::incr:
+                  return Op::str1_add2;
+              default:
+                  break;
+          }
+          break;
+
+      //PUSH followed by SUB(4) - the function prologue
+      case Op::push:
+          if (second == Op::sub4) return Op::push_sub4;
+          break;
+
+      //ADD(7) followed by POP - the function epilogue
+      case Op::add7:
+          if (second == Op::pop) return Op::add7_pop;
+          break;
+
+      default:
+          break;
+  }
+
+  return first;
+}
+
+#ifdef THUMB_FLAG_LIVENESS
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The flags each (unfused) op looks at and the ones it always sets - a shift by a register
+// that might be zero might not set the carry so it doesn't count as setting it. These are
+// the flags execute() sets without SAFE_THUMB: ADD(2) and ADD(3) leave the carry alone and
+// only MOV(2) touches the V flag.
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Thumbulator::flagUse(Op op, uInt8 *reads, uInt8 *writes)
+{
+  *reads = 0;
+  *writes = 0;
+  switch (op)
+  {
+      case Op::b1_000_neg: case Op::b1_000_pos: case Op::b1_100_neg: case Op::b1_100_pos:
+      case Op::b1_400:     case Op::b1_500_pos: case Op::b1_500_neg:
+          *reads = THUMB_FLAG_ZN;
+          break;
+
+      case Op::b1_200: case Op::b1_300:
+          *reads = THUMB_FLAG_C;
+          break;
+
+      case Op::b1_600: case Op::b1_700:
+          *reads = THUMB_FLAG_V;
+          break;
+
+      case Op::b1_800: case Op::b1_900:
+          *reads = THUMB_FLAG_ZN | THUMB_FLAG_C;
+          break;
+
+      case Op::b1_a00: case Op::b1_b00: case Op::b1_c00: case Op::b1_d00:
+          *reads = THUMB_FLAG_ZN | THUMB_FLAG_V;
+          break;
+
+      case Op::adc: case Op::sbc:
+          *reads = THUMB_FLAG_C;
+          *writes = THUMB_FLAG_ZN | THUMB_FLAG_C;
+          break;
+
+      case Op::asr2: case Op::lsl2: case Op::lsr2: case Op::ror:
+      case Op::add1: case Op::add2_r0: case Op::add2_r1: case Op::add2_r2: case Op::add2_r3:
+      case Op::add2_r4: case Op::add2_r5: case Op::add2_r6: case Op::add2_r7: case Op::incr:
+      case Op::add3: case Op::and_: case Op::bic: case Op::eor: case Op::lsl1: case Op::mov1:
+      case Op::mul: case Op::mvn: case Op::orr: case Op::tst:
+          *writes = THUMB_FLAG_ZN;
+          break;
+
+      case Op::asr1: case Op::cmn: case Op::cmp1_r0: case Op::cmp1_r1: case Op::cmp1_r2:
+      case Op::cmp1_r3: case Op::cmp1_r4: case Op::cmp1_r5: case Op::cmp1_r6: case Op::cmp1_r7:
+      case Op::cmp2: case Op::cmp2_r2: case Op::cmp2_r3: case Op::cmp3: case Op::lsl1_rb:
+      case Op::lsr1: case Op::neg: case Op::sub1: case Op::sub2: case Op::sub3:
+          *writes = THUMB_FLAG_ZN | THUMB_FLAG_C;
+          break;
+
+      case Op::mov2:
+          *writes = THUMB_FLAG_ZN | THUMB_FLAG_C | THUMB_FLAG_V;
+          break;
+
+      default:
+          break;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Work backwards over a newly decoded page until nothing changes to find which flags might
+// be looked at after each instruction - then swap the ops that set a carry nothing looks at
+// for the ones that don't. Everything is live after an op we can't follow, on leaving the
+// page, or at an exit back to the 6502 (cFlag is kept from one run of the ARM code to the next).
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+static uInt8 pageLive[THUMB_PAGE_OPS];
+
+void Thumbulator::findLiveFlags(uInt32 first)
+{
+    uInt8 *decoded = thumbDecoded;
+    uInt16 *rom = romImage;
+    uInt8 *live = pageLive - first;     // So both are indexed by the halfword in the ROM
+    Int32 last = first + THUMB_PAGE_OPS - 1;
+    uInt8 use[256];     // Flags read in the low nibble and flags set in the high nibble - by op
+
+    for (uInt32 op = 0; op < 256; op++)
+    {
+        uInt8 reads, writes;
+        flagUse((Op)op, &reads, &writes);
+        use[op] = reads | (writes << 4);
+    }
+
+    #define LIVE_BEFORE(j) ((((j) < (Int32)first) || ((j) > last)) ? THUMB_FLAG_ALL : ((use[decoded[j]] & 0x0F) | (live[j] & ~(use[decoded[j]] >> 4))))
+
+    memset(pageLive, 0x00, sizeof(pageLive));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (Int32 i = last; i >= (Int32)first; i--)
+        {
+            uInt16 inst = rom[i];
+            uInt8 after;
+            switch ((Op)decoded[i])
+            {
+                case Op::b1_000_neg: case Op::b1_000_pos: case Op::b1_100_neg: case Op::b1_100_pos:
+                case Op::b1_200:     case Op::b1_300:     case Op::b1_400:     case Op::b1_500_pos:
+                case Op::b1_500_neg: case Op::b1_600:     case Op::b1_700:     case Op::b1_800:
+                case Op::b1_900:     case Op::b1_a00:     case Op::b1_b00:     case Op::b1_c00:
+                case Op::b1_d00:
+                    {
+                        Int32 target = i + 2 + (Int8)(inst & 0xFF);
+                        after = LIVE_BEFORE(i+1) | LIVE_BEFORE(target);
+                    }
+                    break;
+
+                case Op::b2_pos: case Op::b2_neg:
+                    {
+                        Int32 target = i + 2 + ((inst & 0x400) ? (Int32)(inst | 0xFFFFF800) : (Int32)(inst & 0x7FF));
+                        after = LIVE_BEFORE(target);
+                    }
+                    break;
+
+                case Op::blx1:      // The first half of a BL runs into the second - which we can't follow
+                    after = ((inst & 0x1800) == 0x1000) ? LIVE_BEFORE(i+1) : THUMB_FLAG_ALL;
+                    break;
+
+                case Op::pop:
+                    after = (inst & 0x100) ? THUMB_FLAG_ALL : LIVE_BEFORE(i+1);
+                    break;
+
+                case Op::add4:
+                    after = ((((inst>>0)&0x7) | ((inst>>4)&0x8)) == 15) ? THUMB_FLAG_ALL : LIVE_BEFORE(i+1);
+                    break;
+
+                case Op::b1_e00: case Op::b1_f00: case Op::bx: case Op::blx2: case Op::mov3_r15:
+                case Op::swi: case Op::bkpt: case Op::cps: case Op::setend: case Op::invalid:
+                    after = THUMB_FLAG_ALL;
+                    break;
+
+                default:
+                    after = LIVE_BEFORE(i+1);
+                    break;
+            }
+
+            if (after != live[i])
+            {
+                live[i] = after;
+                changed = true;
+            }
+        }
+    }
+
+    for (Int32 i = first; i <= last; i++)
+    {
+#ifdef HOST_BUILD
+        thumbLiveFlags[i] = live[i];
+#endif
+        if (live[i] & THUMB_FLAG_C) continue;
+        switch ((Op)decoded[i])
+        {
+            case Op::cmp1_r0: case Op::cmp1_r1: case Op::cmp1_r2: case Op::cmp1_r3:
+            case Op::cmp1_r4: case Op::cmp1_r5: case Op::cmp1_r6: case Op::cmp1_r7:
+                decoded[i] = (uInt8)Op::cmp1_nc; break;
+            case Op::cmp2: case Op::cmp2_r2: case Op::cmp2_r3:
+                decoded[i] = (uInt8)Op::cmp2_nc; break;
+            case Op::sub1: decoded[i] = (uInt8)Op::sub1_nc; break;
+            case Op::sub2: decoded[i] = (uInt8)Op::sub2_nc; break;
+            case Op::sub3: decoded[i] = (uInt8)Op::sub3_nc; break;
+            default: break;
+        }
+    }
+}
+
+#ifdef HOST_BUILD
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Thumbulator::countDeadFlags(uInt32 start, uInt32 end, uInt32 *carry, uInt32 *carryDead, uInt32 *zn, uInt32 *znDead)
+{
+    *carry = *carryDead = *zn = *znDead = 0;
+    for (uInt32 addr = start & ~1; addr < end; addr += 2)
+    {
+        uInt32 page = addr / THUMB_PAGE_SIZE;
+        if (!(decodedPages[page >> 5] & (1 << (page & 31)))) continue;    // Never ran - likely not code at all
+        uInt8 reads, writes;
+        flagUse(decodeInstructionWord(romImage[addr >> 1]), &reads, &writes);
+        uInt8 live = thumbLiveFlags[addr >> 1];
+        if (writes & THUMB_FLAG_C)  {(*carry)++; if (!(live & THUMB_FLAG_C)) (*carryDead)++;}
+        if (writes & THUMB_FLAG_ZN) {(*zn)++;    if (!(live & THUMB_FLAG_ZN)) (*znDead)++;}
+    }
+}
+#endif
+#endif
+
 
 
 // ------------------------------------------------------------------------
 // Somewhere between 10-20% of instructions modify the R15 PC register 
 // so we default to not updating it unless we know we're using it.
 // This produces a small but meaningful speed-up of Thumb processing...
+// The Thumb bit (bit 0) of any address we branch to is dropped when we
+// point back into the ROM - the ARM9 quietly ignores it on a halfword
+// load but nothing else (e.g. the host build) does. A PC beyond the end
+// of the ROM wraps back into it so we never run off thumbDecoded[].
 // ------------------------------------------------------------------------
 #define FIX_R15_PC reg_sys[15] = ((u32) ((uInt8*)thumb_ptr - (uInt8*)cart_buffer)) + 2;
 
-#define FIX_THUMB_PTRS  thumb_ptr = (uInt16*)&cart_buffer[(reg_sys[15]-2)]; thumb_decode_ptr = &cart_buffer[MEM_256KB + ((reg_sys[15]-2) >> 1)];
+#define FIX_THUMB_PTRS  thumb_ptr = (uInt16*)&cart_buffer[(reg_sys[15]-2) & (thumbRomMask & ~1)]; thumb_decode_ptr = &thumbDecoded[((reg_sys[15]-2) & thumbRomMask) >> 1];
 
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 ITCM_CODE void Thumbulator::execute ( void )
 {
+#ifdef THUMB_TRANSLATOR
+  uInt32 ZNflags = thumbZNflags;
+  uInt32 vFlag = thumbVflag;
+#else
   uInt32 ZNflags = 0;
   uInt32 vFlag = 0;
-  uInt16 *thumb_ptr = (uInt16*)&cart_buffer[(reg_sys[15]-2)];
-  uInt8  *thumb_decode_ptr = &cart_buffer[MEM_256KB+((reg_sys[15]-2) >> 1)];
+#endif
+  uInt16 *thumb_ptr;
+  uInt8  *thumb_decode_ptr;
+  FIX_THUMB_PTRS
+#ifdef CPU_PROFILER
+  uInt8 previous = 0;
+#endif
 
   for (;;)
   {
       uInt32 ra,rb,rc,rd,rm,rn;
+#ifdef THUMB_TRANSLATOR
+      if (thumbSteps)
+      {
+          if (thumbSteps == 1)
+          {
+              FIX_R15_PC
+              thumbZNflags = ZNflags;
+              thumbVflag = vFlag;
+              thumbSteps = 0;
+              return;
+          }
+          thumbSteps--;
+      }
+#endif
       uInt16 inst = *thumb_ptr++;
       Thumbulator::Op decoded = (Thumbulator::Op)*thumb_decode_ptr++;
       
 #ifdef CPU_PROFILER
       profiler[(u8)decoded]++;
+      profiler_pairs[(previous << 8) | (u8)decoded]++;
+      previous = (u8)decoded;
 #endif
       
       switch (decoded)
@@ -983,7 +1398,7 @@ ITCM_CODE void Thumbulator::execute ( void )
               
           case Op::ldr3:
                 rn = ((inst>>8)&0x07);
-                reg_sys[rn] = (u32) *(u32*)((((u32)thumb_ptr + ((inst<<2)&0x3FF) + 2) & ~3));
+                reg_sys[rn] = (u32) *(u32*)((((uintptr_t)thumb_ptr + ((inst<<2)&0x3FF) + 2) & ~3));
               break;
 
           case Op::and_:
@@ -1618,7 +2033,7 @@ ITCM_CODE void Thumbulator::execute ( void )
                 if(rc&1)
                 {
                   rc+=2;
-                  write_register(14,reg_sys[15]-2);
+                  write_register(14,(reg_sys[15]-2) | 1);
                   write_register(15,rc);
                   FIX_THUMB_PTRS
                 }
@@ -1770,6 +2185,300 @@ ITCM_CODE void Thumbulator::execute ( void )
                 write_register(rd,rc);
               break;
                             
+          // ------------------------------------------------------------------------------------
+          // Superinstructions - each does exactly what its two ops would have done one after the
+          // other (flags and all) and picks up the second instruction word on the way through.
+          // ------------------------------------------------------------------------------------
+          case Op::cmp1_beq:  //CMP(1) then BEQ
+                ra=reg_sys[(inst>>8)&0x07];
+                rb=(inst>>0)&0xFF;
+                ZNflags=ra-rb;
+                do_cflag_fast(ra,~rb);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (!ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp1_bne:  //CMP(1) then BNE
+                ra=reg_sys[(inst>>8)&0x07];
+                rb=(inst>>0)&0xFF;
+                ZNflags=ra-rb;
+                do_cflag_fast(ra,~rb);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp1_bcs:  //CMP(1) then BCS
+                ra=reg_sys[(inst>>8)&0x07];
+                rb=(inst>>0)&0xFF;
+                ZNflags=ra-rb;
+                do_cflag_fast(ra,~rb);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (cFlag)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp1_bcc:  //CMP(1) then BCC
+                ra=reg_sys[(inst>>8)&0x07];
+                rb=(inst>>0)&0xFF;
+                ZNflags=ra-rb;
+                do_cflag_fast(ra,~rb);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (!(cFlag))
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp2_beq:  //CMP(2) then BEQ
+                ra=reg_sys[(inst>>0)&0x7];
+                rb=reg_sys[(inst>>3)&0x7];
+                ZNflags=ra-rb;
+                do_cflag(ra,~rb,1);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (!ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp2_bne:  //CMP(2) then BNE
+                ra=reg_sys[(inst>>0)&0x7];
+                rb=reg_sys[(inst>>3)&0x7];
+                ZNflags=ra-rb;
+                do_cflag(ra,~rb,1);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::sub2_bne:  //SUB(2) then BNE
+                rb=(inst>>0)&0xFF;
+                rd=(inst>>8)&0x07;
+                ra=read_register(rd);
+                ZNflags=ra-rb;
+                write_register(rd,ZNflags);
+                do_cflag_fast(ra,~rb);
+#ifdef SAFE_THUMB              
+                vFlag = do_sub_vflag(ra,rb,ZNflags);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::ldr1_ldr1:  //LDR(1) then LDR(1)
+                reg_sys[inst&0x07] = read32(reg_sys[(inst>>3)&0x07] + ((inst>>4)&0x7C));
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                reg_sys[inst&0x07] = read32(reg_sys[(inst>>3)&0x07] + ((inst>>4)&0x7C));
+              break;
+
+          case Op::add3_str1:  //ADD(3) then STR(1)
+                rd=(inst>>0)&0x7;
+                rn=(inst>>3)&0x7;
+                rm=(inst>>6)&0x7;
+                reg_sys[rd] = reg_sys[rn] + reg_sys[rm];
+                do_znflags(reg_sys[rd]);
+#ifdef SAFE_THUMB              
+                do_cflag(reg_sys[rn],reg_sys[rm],0);
+                vFlag = do_add_vflag(reg_sys[rn],reg_sys[rm],reg_sys[rd]);
+#endif              
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                rb=read_register((inst>>3)&0x07)+((inst>>4)&0x7C);
+                write32(rb,read_register((inst>>0)&0x07));
+              break;
+
+          case Op::str1_add2:  //STR(1) then ADD(2)
+                rb=read_register((inst>>3)&0x07)+((inst>>4)&0x7C);
+                write32(rb,read_register((inst>>0)&0x07));
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                rd=(inst>>8)&0x07;
+                reg_sys[rd] += (inst>>0)&0xFF;
+                do_znflags(reg_sys[rd]);
+              break;
+
+          case Op::push_sub4:  //PUSH then SUB(4)
+                  if (inst & 0x100) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[14]);}
+                  if (inst & 0x080) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[7]);}
+                  if (inst & 0x040) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[6]);}
+                  if (inst & 0x020) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[5]);}
+                  if (inst & 0x010) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[4]);}
+                  if (inst & 0x008) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[3]);}
+                  if (inst & 0x004) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[2]);}
+                  if (inst & 0x002) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[1]);}
+                  if (inst & 0x001) {reg_sys[13] -= 4; write32(reg_sys[13], reg_sys[0]);}
+                  inst = *thumb_ptr++; thumb_decode_ptr++;
+                  reg_sys[13] -= (inst&0x7F)<<2;
+              break;
+
+          case Op::add7_pop:  //ADD(7) then POP
+                  reg_sys[13] += (inst&0x7F)<<2;
+                  inst = *thumb_ptr++; thumb_decode_ptr++;
+                  if (inst & 0x001) {reg_sys[0] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x002) {reg_sys[1] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x004) {reg_sys[2] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x008) {reg_sys[3] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x010) {reg_sys[4] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x020) {reg_sys[5] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x040) {reg_sys[6] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x080) {reg_sys[7] =  readRAM32(reg_sys[13]); reg_sys[13] += 4;}
+                  if (inst & 0x100) 
+                  {
+                      reg_sys[15] = readRAM32(reg_sys[13]) + 2; 
+                      reg_sys[13] += 4;
+                      FIX_THUMB_PTRS
+                  }
+              break;
+
+          // ------------------------------------------------------------------------------------
+          // The carry-less ops - as the ones above (or the plain ones) without the carry which
+          // the flag liveness pass found is always set again before anything looks at it.
+          // ------------------------------------------------------------------------------------
+          case Op::cmp1_nc:
+                ZNflags=reg_sys[(inst>>8)&0x07]-((inst>>0)&0xFF);
+              break;
+
+          case Op::cmp2_nc:
+                ZNflags=reg_sys[(inst>>0)&0x7]-reg_sys[(inst>>3)&0x7];
+              break;
+
+          case Op::sub1_nc:
+                ZNflags=reg_sys[(inst>>3)&0x7]-((inst>>6)&0x7);
+                reg_sys[(inst>>0)&0x7]=ZNflags;
+              break;
+
+          case Op::sub2_nc:
+                rd=(inst>>8)&0x07;
+                ZNflags=reg_sys[rd]-((inst>>0)&0xFF);
+                reg_sys[rd]=ZNflags;
+              break;
+
+          case Op::sub3_nc:
+                ZNflags=reg_sys[(inst>>3)&0x7]-reg_sys[(inst>>6)&0x7];
+                reg_sys[(inst>>0)&0x7]=ZNflags;
+              break;
+
+          case Op::cmp1_beq_nc:  //CMP(1) then BEQ
+                ZNflags=reg_sys[(inst>>8)&0x07]-((inst>>0)&0xFF);
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (!ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp1_bne_nc:  //CMP(1) then BNE
+                ZNflags=reg_sys[(inst>>8)&0x07]-((inst>>0)&0xFF);
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp2_beq_nc:  //CMP(2) then BEQ
+                ZNflags=reg_sys[(inst>>0)&0x7]-reg_sys[(inst>>3)&0x7];
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (!ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::cmp2_bne_nc:  //CMP(2) then BNE
+                ZNflags=reg_sys[(inst>>0)&0x7]-reg_sys[(inst>>3)&0x7];
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::sub2_bne_nc:  //SUB(2) then BNE
+                rd=(inst>>8)&0x07;
+                ZNflags=reg_sys[rd]-((inst>>0)&0xFF);
+                reg_sys[rd]=ZNflags;
+                inst = *thumb_ptr++; thumb_decode_ptr++;
+                if (ZNflags)
+                {
+                    rb=(inst>>0)&0xFF;
+                    if(rb&0x80) rb|=0xFFFFFF00; // Sign extend
+                    thumb_ptr += (int)rb+1;
+                    thumb_decode_ptr += (int)rb+1;
+                }
+              break;
+
+          case Op::undecoded:   // The first time into this page - decode it and go round again for the same instruction
+                decodePage((((uInt8*)thumb_ptr - cart_buffer) - 2) / THUMB_PAGE_SIZE);
+                thumb_ptr--;
+                thumb_decode_ptr--;
+#ifdef THUMB_TRANSLATOR
+                if (thumbSteps) thumbSteps++;
+#endif
+              break;
+
           case Op::invalid:                 
               return;
               break;              
@@ -1783,4 +2492,8 @@ void Thumbulator::reset ( void )
     reg_sys[13]=cStack;   //sp
     reg_sys[14]=cBase;    //lr (duz this use odd addrs)
     reg_sys[15]=cStart+3; //pc entry point of 0xc09+2 for DPC or 0x809+2 for CDF
+#ifdef THUMB_TRANSLATOR
+    thumbZNflags = 0;
+    thumbVflag = 0;
+#endif
 }
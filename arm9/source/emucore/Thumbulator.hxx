@@ -27,17 +27,74 @@
 #ifdef THUMB_SUPPORT
 
 #include "bspf.hxx"
+#include "Cart.hxx"
 
-#define ROMADDMASK 0x3FFFF      // 256K ROM
+#define ROMADDMASK (MAX_CART_FILE_SIZE-1)   // Up to 512K ROM - all of cart_buffer[] (see thumbRomMask)
 #define RAMADDMASK 0x7FFF       // 32K RAM
 
 #define ROMSIZE (ROMADDMASK+1)
 #define RAMSIZE (RAMADDMASK+1)
 
+// ---------------------------------------------------------------------------------------
+// Uncomment this to have a second pass over the decoded ROM replace the most common pairs
+// of instructions (compare and branch, back to back loads, push and make room on the
+// stack and so on) with a single op that does both - one trip round the execute loop
+// instead of two. The CPU_PROFILER counts pairs of ops as well as the ops themselves so
+// the pairs worth doing can be picked from the games that need it most. Left off until
+// it has been checked against the DPC+/CDF/CDFJ games and timed on a DS.
+// ---------------------------------------------------------------------------------------
+//#define THUMB_SUPERINSTRUCTIONS  TRUE
+
+// ---------------------------------------------------------------------------------------
+// Uncomment this to have a flag liveness pass work out which flags (Z/N, C and V) might
+// still be looked at after each instruction - following a B<cond> both ways and assuming
+// all of them after anything it can't follow (BX, POP {PC}, BL and the exits back to the
+// 6502). A CMP or SUB whose carry is never looked at is swapped for a variant that doesn't
+// work it out. It's done a page at a time as each page is decoded (anything leaving the
+// page counts as something it can't follow). The host build keeps the flags live after
+// each instruction in thumbLiveFlags[] for its translator which drops the Z/N stores as
+// well. SAFE_THUMB builds also work out the V flag on every add and subtract so they go
+// without. Left off until the host's -x 2 check has been run over the CDFJ/CDFJ+ games -
+// a host run of a game reports how much of its code could go without the carry and Z/N.
+// ---------------------------------------------------------------------------------------
+//#define THUMB_FLAG_LIVENESS  TRUE
+
+#if defined(THUMB_FLAG_LIVENESS) && defined(SAFE_THUMB)
+#undef THUMB_FLAG_LIVENESS
+#endif
+
+#define THUMB_FLAG_ZN   0x01
+#define THUMB_FLAG_C    0x02
+#define THUMB_FLAG_V    0x04
+#define THUMB_FLAG_ALL  0x07
+
+// ---------------------------------------------------------------------------------------
+// The ARM code is decoded a 2K page at a time the first time anything in that page runs
+// rather than all of it when the Thumbulator is made. Nearly all of a big CDFJ+ ROM is
+// graphics and music that never runs. The ROM is taken to be the image rounded up to a
+// power of 2 (thumbRomMask) and the decoded ops need one byte per halfword of that. Up to
+// 256K they go in the upper half of cart_buffer[] which the image leaves free - only a
+// bigger image, which needs all of cart_buffer[] for itself, gets a buffer from the heap.
+// ---------------------------------------------------------------------------------------
+#define THUMB_PAGE_SIZE  2048
+#define THUMB_PAGE_OPS   (THUMB_PAGE_SIZE/2)
+#define THUMB_PAGES      (ROMSIZE/THUMB_PAGE_SIZE)
+
+// ---------------------------------------------------------------------------------------
+// On x86-64 the host build can also translate the Thumb code into native code a basic
+// block at a time (host/source/ThumbTranslate.cpp) for bulk testing of the ARM games.
+// It is picked at runtime with bThumbTranslate and gives the interpreter's results bit
+// for bit - so it leaves SAFE_THUMB builds alone rather than work out the V flag.
+// ---------------------------------------------------------------------------------------
+#if defined(HOST_BUILD) && defined(__x86_64__) && !defined(SAFE_THUMB)
+#define THUMB_TRANSLATOR  TRUE
+#endif
+
 //#define CPU_PROFILER  TRUE
 
 #ifdef CPU_PROFILER
 extern u32 profiler[];
+extern u32 profiler_pairs[];    // Indexed by (previous op << 8) | op
 #endif
 
 extern uInt32 reg_sys[16];
@@ -82,10 +139,26 @@ extern uInt32 cStack, cBase, cStart;
 
 extern uInt8 *myARMRAM;
 
+extern uInt8 *thumbDecoded;             // One op per halfword of ARM code - Op::undecoded until its page first runs
+extern uInt32 thumbRomMask;             // Size of the ROM (a power of 2) less one - the PC wraps inside it
+extern uInt32 thumbPagesDecoded;
+
+#if defined(THUMB_FLAG_LIVENESS) && defined(HOST_BUILD)
+extern uInt8  thumbLiveFlags[];         // The flags live after each instruction (THUMB_FLAG_ALL until decoded)
+#endif
+
+#ifdef THUMB_TRANSLATOR
+extern bool   bThumbTranslate;          // Run the ARM code through the translator
+extern bool   bThumbTranslateCheck;     // ...and check every block it runs against the interpreter
+extern uInt32 thumbZNflags;             // The flags that are otherwise local to execute()
+extern uInt32 thumbVflag;
+extern uInt32 thumbSteps;               // Instructions left to step plus one - zero runs to the end
+#endif
+
 class Thumbulator
 {
   public:
-    Thumbulator(uInt16* rom);
+    Thumbulator(uInt16* rom, uInt32 size, bool fuse = true, bool liveness = true);
     ~Thumbulator();
 
     /**
@@ -98,7 +171,21 @@ class Thumbulator
     */
     void run();
 
+#ifdef THUMB_TRANSLATOR
+    // Run just the next count instructions - false if the ARM code finished first
+    bool step(uInt32 count);
+#endif
+
+#if defined(THUMB_FLAG_LIVENESS) && defined(HOST_BUILD)
+    // Of the flag setting ops in [start, end) - how many set the carry and how many of those
+    // don't need to, and the same for Z/N (from the last Thumbulator made)
+    static void countDeadFlags(uInt32 start, uInt32 end, uInt32 *carry, uInt32 *carryDead, uInt32 *zn, uInt32 *znDead);
+#endif
+
   private:
+#ifdef THUMB_TRANSLATOR
+    friend class ThumbTranslator;
+#endif
     
     enum class Op : uInt8 {
       invalid,      adc,        add1,       add2_r0,    add2_r1,    add2_r2,    add2_r3,    add2_r4,    add2_r5,    add2_r6,        //00
@@ -113,7 +200,16 @@ class Thumbulator
       lsr1,         lsr2,       mov1,       mov2,       mov3,       mov3_r15,   mul,        mvn,        neg,        orr,            //90
       pop,          push,       rev,        rev16,      revsh,      ror,        sbc,        setend,     stmia,      str1,           //100
       str2,         str3,       str3_r2,    str3_r3,    strb1,      strb2,      strh1,      strh2,      sub1,       sub2,           //110
-      sub3,         sub4,       swi,        sxtb,       sxth,       tst,        uxtb,       uxth,       mov1z                       //120      
+      sub3,         sub4,       swi,        sxtb,       sxth,       tst,        uxtb,       uxth,       mov1z,                      //120
+
+      // Superinstructions - two instructions that follow one another run as one (see fuseInstructions())
+      cmp1_beq,     cmp1_bne,   cmp1_bcs,   cmp1_bcc,   cmp2_beq,   cmp2_bne,   sub2_bne,   ldr1_ldr1,  add3_str1,  str1_add2,      //129
+      push_sub4,    add7_pop,                                                                                                   //139
+
+      // Without the carry - where the flag liveness pass found nothing looks at it (see findLiveFlags())
+      cmp1_nc,      cmp2_nc,    sub1_nc,    sub2_nc,    sub3_nc,    cmp1_beq_nc, cmp1_bne_nc, cmp2_beq_nc, cmp2_bne_nc, sub2_bne_nc, //141
+
+      undecoded                 // Everything in a page that hasn't been decoded yet (see decodePage())
     };
     
     inline uInt16 read16 ( uInt32 addr );
@@ -132,6 +228,35 @@ class Thumbulator
     void reset ( void );
     
     static Op decodeInstructionWord(uint16_t inst);
+    static Op fuseInstructions(Op first, Op second);
+    static void decodePage(uInt32 page);
+    static void decodeAt(uInt32 addr);
+#ifdef THUMB_FLAG_LIVENESS
+    static void flagUse(Op op, uInt8 *reads, uInt8 *writes);
+    static void findLiveFlags(uInt32 first);
+#endif
 };
 
+#ifdef THUMB_TRANSLATOR
+class ThumbTranslator
+{
+  public:
+    static void run(Thumbulator *thumb);    // Takes the place of execute() - stepping the interpreter for anything it can't translate
+    static void flush(void);                // Forget everything translated (the ROM is about to change)
+    static void report(void);               // Print what was translated, run and checked
+    static uint64_t executed(void);         // Thumb instructions run so far - natively or stepped
+    static void startTiming(void);          // Around each Thumbulator::run() - translated or not
+    static void stopTiming(void);
+    static double seconds(void);            // Time spent in Thumbulator::run() so far
+
+    struct Block;                           // One translated basic block
+
+  private:
+    static Block* translate(uInt32 start);
+    static bool   translateOp(uInt32 addr, uInt16 inst, Thumbulator::Op op);
+    static bool   conditionPassed(uInt8 cond);
+    static void   check(Thumbulator *thumb, Block *block, uInt32 pc);
+};
+#endif
+
 #endif
@@ -235,6 +235,9 @@ void SaveState(void)
     // TIA
     fwrite(ourCollisionTable,           sizeof(ourCollisionTable),          1, fp);
     fwrite(myPriorityEncoder,           sizeof(myPriorityEncoder),          1, fp);
+#ifdef TIA_COLLISION_SPANS
+    theTIA.resolveCollisions();
+#endif
     fwrite(&myCollision,                sizeof(myCollision),                1, fp);
 
     fwrite(&myPOSP0,                    sizeof(myPOSP0),                    1, fp);
@@ -468,8 +471,11 @@ void LoadState(void)
             fread(&myPageOffsets,              sizeof(myPageOffsets),              1, fp);
 
             // TIA
-            fread(ourCollisionTable,           sizeof(ourCollisionTable),          1, fp);
-            fread(myPriorityEncoder,           sizeof(myPriorityEncoder),          1, fp);
+            fseek(fp, sizeof(ourCollisionTable), SEEK_CUR); // Built at compile time - skip it
+            fseek(fp, sizeof(myPriorityEncoder), SEEK_CUR); // Built at compile time - skip it
+#ifdef TIA_COLLISION_SPANS
+            myCollisionSpans = 0;           // Anything still pending is from before the load - the saved bits replace it
+#endif
             fread(&myCollision,                sizeof(myCollision),                1, fp);
 
             fread(&myPOSP0,                    sizeof(myPOSP0),                    1, fp);
@@ -528,8 +534,8 @@ void LoadState(void)
             fread(&myNUSIZ0,                   sizeof(myNUSIZ0),                   1, fp);
             fread(&myNUSIZ0,                   sizeof(myNUSIZ0),                   1, fp);
 
-            fread(ourPlayerReflectTable,       sizeof(ourPlayerReflectTable),      1, fp);
-            fread(ourPlayfieldTable,           sizeof(ourPlayfieldTable),          1, fp);
+            fseek(fp, sizeof(ourPlayerReflectTable), SEEK_CUR); // Built at compile time - skip it
+            fseek(fp, sizeof(ourPlayfieldTable), SEEK_CUR); // Built at compile time - skip it
 
             // TIA Sound
             fread(AUDC,                        sizeof(AUDC),                       1, fp);
@@ -0,0 +1,59 @@
+#!/bin/sh
+#---------------------------------------------------------------------------------
+# Checks that M6502_CYCLE_ACCOUNTING is cycle exact. Builds the headless runner
+# twice - once counting cycles on every bus access as normal and once with the
+# per-instruction accounting - both with TIA_WRITE_DIGEST so each run reports a
+# hash of every TIA write and the cycle it landed on. Then runs every ROM given
+# through both and compares the cycle count, TIA write digest and frame hash.
+#
+#   ./cyclecheck.sh [-f frames] [-d driver] rom1.a26 rom2.bin ...
+#
+# Any extra build options (e.g. -DM6502_THREADED_DISPATCH) can be passed in
+# through DEFINES in the environment. Timing lines are ignored - everything
+# else the runner prints (including any errors) has to match.
+#---------------------------------------------------------------------------------
+FRAMES=1000
+RUNARGS=""
+while getopts "f:d:" opt; do
+    case $opt in
+        f) FRAMES=$OPTARG ;;
+        d) RUNARGS="-d $OPTARG" ;;
+        *) exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 [-f frames] [-d driver] romfile ..."
+    exit 1
+fi
+
+cd "$(dirname "$0")" || exit 1
+JOBS=$(nproc 2>/dev/null || echo 4)
+
+# The Makefile doesn't track the build options so start over if they changed
+if [ ! -f build-cc-bus/.defines ] || [ "$(cat build-cc-bus/.defines)" != "$DEFINES" ]; then
+    rm -rf build-cc-bus build-cc-ins stellads-cc-bus stellads-cc-ins
+    mkdir -p build-cc-bus && echo "$DEFINES" > build-cc-bus/.defines
+fi
+
+make -s -j$JOBS BUILD=build-cc-bus TARGET=stellads-cc-bus DEFINES="$DEFINES -DTIA_WRITE_DIGEST" || exit 1
+make -s -j$JOBS BUILD=build-cc-ins TARGET=stellads-cc-ins DEFINES="$DEFINES -DTIA_WRITE_DIGEST -DM6502_CYCLE_ACCOUNTING" || exit 1
+
+pass=0
+fail=0
+for rom in "$@"; do
+    a=$(./stellads-cc-bus -f $FRAMES $RUNARGS "$rom" 2>&1 | grep -vE '^(rom|md5|frames|fps|instr|mips|idle|boot):')
+    b=$(./stellads-cc-ins -f $FRAMES $RUNARGS "$rom" 2>&1 | grep -vE '^(rom|md5|frames|fps|instr|mips|idle|boot):')
+    if [ -n "$a" ] && [ "$a" = "$b" ]; then
+        pass=$((pass+1))
+        echo "SAME  $rom  ($(echo "$a" | grep '^tia:' | cut -c10-))"
+    else
+        fail=$((fail+1))
+        echo "DIFF  $rom"
+        echo "$a" | sed 's/^/    bus: /'
+        echo "$b" | sed 's/^/    ins: /'
+    fi
+done
+
+echo "$pass same, $fail different"
+[ $fail -eq 0 ]
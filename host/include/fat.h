@@ -0,0 +1,12 @@
+// =====================================================================================
+// Host (Linux) stand-in for <fat.h> - the host has a real file system so there is
+// nothing to initialize. fatInitDefault() always succeeds.
+// =====================================================================================
+#ifndef __HOST_FAT_H
+#define __HOST_FAT_H
+
+#include <sys/stat.h>
+
+static inline bool fatInitDefault(void) { return true; }
+
+#endif
@@ -0,0 +1,90 @@
+// =====================================================================================
+// Host (Linux) stand-in for <nds.h> so the emucore can be compiled and run on a PC.
+//
+// Only the handful of libnds symbols the emucore actually touches are provided here.
+// The DS memory-placement attributes (ITCM_CODE and the ".dtcm" section) become no-ops
+// or plain data sections and the DMA helpers collapse into memcpy(). A few emucore
+// modules address DS VRAM directly (the TIA frame buffer and the sound sample buffers)
+// so host_platform_init() maps an anonymous block of memory at those same addresses.
+//
+// The emucore also stores pointers in 32-bit integers in a few places (Thumbulator and
+// the sound pointers) so the host build is linked non-PIE, keeping all static data and
+// the heap below 4GB - see host/Makefile.
+// =====================================================================================
+#ifndef __HOST_NDS_H
+#define __HOST_NDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+typedef uint8_t             u8;
+typedef uint16_t            u16;
+typedef uint32_t            u32;
+typedef uint64_t            u64;
+typedef int8_t              s8;
+typedef int16_t             s16;
+typedef int32_t             s32;
+typedef int64_t             s64;
+
+typedef volatile u8         vu8;
+typedef volatile u16        vu16;
+typedef volatile u32        vu32;
+
+typedef uint8_t             uint8;
+typedef uint16_t            uint16;
+typedef uint32_t            uint32;
+typedef int8_t              int8;
+typedef int16_t             int16;
+typedef int32_t             int32;
+
+#define BIT(n)              (1 << (n))
+
+// No tightly-coupled memory on the host - code and data just live where the linker puts them
+#define ITCM_CODE
+#define DTCM_DATA
+#define DTCM_BSS
+
+// ---------------------------------------------------------------------------
+// DS VRAM - mapped by host_platform_init() at the real DS addresses so that
+// the emucore can keep using its hard-coded VRAM buffers unchanged. The
+// runner is linked above this range (see the Makefile) so it's always free.
+// ---------------------------------------------------------------------------
+#define HOST_VRAM_BASE      0x06000000
+#define HOST_VRAM_SIZE      0x00900000  // Covers BG_GFX (0x06000000) through the LCDC bank used for sound (0x068A0000)
+
+#define BG_GFX              ((u16*)0x06000000)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int  host_platform_init(void);
+extern u16  host_timer_data(int timer);
+extern bool isDSiMode(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// DMA is just a copy on the host... and it's always complete.
+// ---------------------------------------------------------------------------
+static inline void dmaCopyWords(u8 channel, const void* src, void* dest, u32 size)       { (void)channel; memcpy(dest, src, size); }
+static inline void dmaCopyWordsAsynch(u8 channel, const void* src, void* dest, u32 size) { (void)channel; memcpy(dest, src, size); }
+static inline void dmaCopy(const void* src, void* dest, u32 size)                        { memcpy(dest, src, size); }
+static inline void DC_FlushRange(const void* base, u32 size)                             { (void)base; (void)size; }
+
+// ---------------------------------------------------------------------------
+// The hardware timers run at 33.513982 MHz / 1024 = 32,728.5 ticks per second.
+// On the host they are derived from the monotonic clock.
+// ---------------------------------------------------------------------------
+#define TIMER_FREQ(n)       (-0x2000000/(n))
+#define TIMER0_DATA         (host_timer_data(0))
+#define TIMER1_DATA         (host_timer_data(1))
+#define TIMER3_DATA         (host_timer_data(3))
+
+#endif
@@ -0,0 +1,825 @@
+// =====================================================================================================
+// Stella DS/DSi Pheonix Edition - Thumbulator translator for the host build
+//
+// Copyright (c) 2020-2024 by Dave Bernazzani
+//
+// Copying and distribution of this emulator, it's source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave (Phoenix-Edition),
+// Alekmaul (original port) are thanked profusely along with the entire Stella Team.
+//
+// The StellaDS emulator is offered as-is, without any warranty.
+// =====================================================================================================
+//
+// Turns the Thumb code in cart_buffer[] into x86-64 a basic block at a time so that the
+// DPC+ and CDF/CDFJ/CDFJ+ games can be run for thousands of frames on a PC without the
+// interpreter being the bottleneck. Only the host build (and only on x86-64) has this -
+// the DS always interprets.
+//
+// A block is straight-line code ending in a branch whose target is known when it's
+// translated (B, B<cond> and BL). Anything the translator doesn't handle - BX, POP {PC},
+// LDMIA, the register shifts and the ops that leave the ARM code - ends the block just
+// before it and is stepped through the interpreter one instruction at a time. The code
+// only ever runs from cart_buffer[] and every store goes to the ARM RAM (the Thumbulator
+// masks all writes into it) so nothing can write over code that has been translated - it's
+// all thrown away when a new Thumbulator is made for a new ROM.
+//
+// Each translated op does exactly what the interpreter's case does, quirks and all (the
+// ADD(2) that leaves the carry alone, the carry that a shift leaves as the bit rather than
+// 1 and so on), so the two can be checked against one another after every block.
+// =====================================================================================================
+#include <nds.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "Cart.hxx"
+#include "Thumbulator.hxx"
+
+#ifdef THUMB_TRANSLATOR
+
+
+#define TRANSLATE_HOT       2                   // Times a block has to be reached before it's translated
+#define TRANSLATE_MAX_OPS   64                  // Longest block we'll make
+#define TRANSLATE_CODE_SIZE (8 * 1024 * 1024)   // Room for the native code - all flushed when it fills up
+#define TRANSLATE_BLOCKS    (ROMSIZE / 2)       // Worst case is a block starting at every instruction
+
+#define COND_ALWAYS         14                  // B, BL
+#define COND_NONE           15                  // The block runs into something we can't translate
+
+struct ThumbTranslator::Block
+{
+    void   (*code)(void);   // The native code - updates reg_sys[], the flags and the ARM RAM
+    uInt16 count;           // Thumb instructions in the block (including the branch that ends it)
+    uInt8  cond;            // The condition of that branch
+    uInt32 next;            // The address after the block
+    uInt32 target;          // Where the branch goes if it's taken
+};
+
+static ThumbTranslator::Block  *blockMap[ROMSIZE / 2];         // By (halfword) Thumb address
+static uInt8                    blockHeat[ROMSIZE / 2];
+static ThumbTranslator::Block   blockPool[TRANSLATE_BLOCKS];
+static ThumbTranslator::Block   noBlock;                        // Marks an address that starts with something we can't translate
+static uInt32                   blocksUsed = 0;
+
+static uInt8 *codeBase = NULL;
+static uInt8 *codePtr = NULL;
+
+static uInt32 statBlocks = 0;           // Blocks translated
+static uInt32 statOps = 0;              // ...and the Thumb instructions in them
+static uInt32 statFlushes = 0;
+static uint64_t statRun = 0;              // Instructions run as native code
+static uint64_t statStepped = 0;          // Instructions stepped through the interpreter
+static uInt32 statChecked = 0;          // Blocks checked against the interpreter
+static uInt32 statMismatches = 0;
+static double statSeconds = 0.0;        // Time spent in Thumbulator::run()
+static struct timespec statStart;
+
+// ---------------------------------------------------------------------------------------
+// A bare bones x86-64 emitter - just the handful of forms the translation needs.
+// The guest registers, flags and memory are all reached through callee-saved registers
+// set up when each block is entered:
+//
+//   rbx = reg_sys[]   rbp = &cFlag   r12 = &thumbZNflags   r13 = &thumbVflag
+//   r14 = myARMRAM    r15 = cart_buffer
+//
+// with eax, ecx and edx free for the work.
+// ---------------------------------------------------------------------------------------
+enum { RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+#define GUEST   RBX
+#define CFLAG   RBP
+#define ZNFLAG  R12
+#define VFLAG   R13
+#define RAM     R14
+#define ROM     R15
+
+static inline void emit8(uInt8 value)
+{
+    *codePtr++ = value;
+}
+
+static inline void emit32(uInt32 value)
+{
+    memcpy(codePtr, &value, 4);
+    codePtr += 4;
+}
+
+static inline void emit64(uint64_t value)
+{
+    memcpy(codePtr, &value, 8);
+    codePtr += 8;
+}
+
+// An op with a memory operand [base + index + disp] (index < 0 for none). The opcode is
+// given as up to three bytes (high byte first) with an optional legacy prefix before the REX.
+static void emitMem(uInt32 opcode, int length, int reg, int base, int index, Int32 disp, bool wide = false, uInt8 prefix = 0)
+{
+    if (prefix) emit8(prefix);
+    uInt8 rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index >= 0) && (index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+    if (rex != 0x40) emit8(rex);
+    for (int i = length - 1; i >= 0; i--) emit8((opcode >> (8 * i)) & 0xFF);
+
+    int mod = ((disp == 0) && ((base & 7) != RBP)) ? 0 : (((disp >= -128) && (disp < 128)) ? 1 : 2);
+    if ((index >= 0) || ((base & 7) == RSP))
+    {
+        emit8((mod << 6) | ((reg & 7) << 3) | 4);
+        emit8((((index >= 0) ? (index & 7) : 4) << 3) | (base & 7));
+    }
+    else
+    {
+        emit8((mod << 6) | ((reg & 7) << 3) | (base & 7));
+    }
+    if (mod == 1) emit8((uInt8)disp);
+    else if (mod == 2) emit32((uInt32)disp);
+}
+
+// An op between two of the low eight registers (reg is the ModRM reg field - or the /n)
+static void emitReg(uInt32 opcode, int length, int reg, int rm)
+{
+    for (int i = length - 1; i >= 0; i--) emit8((opcode >> (8 * i)) & 0xFF);
+    emit8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// The flags that might be looked at after the op being translated - the others aren't stored
+static uInt8 liveFlags = THUMB_FLAG_ALL;
+
+static inline void loadGuest(int x86, int r)    {emitMem(0x8B, 1, x86, GUEST, -1, r * 4);}      // mov x86, reg_sys[r]
+static inline void storeGuest(int r, int x86)   {emitMem(0x89, 1, x86, GUEST, -1, r * 4);}      // mov reg_sys[r], x86
+static inline void storeZN(int x86)             {if (liveFlags & THUMB_FLAG_ZN) emitMem(0x89, 1, x86, ZNFLAG, -1, 0);}  // mov [thumbZNflags], x86
+static inline void storeC(int x86)              {if (liveFlags & THUMB_FLAG_C) emitMem(0x89, 1, x86, CFLAG, -1, 0);}    // mov [cFlag], x86
+
+static inline void storeGuestImm(int r, uInt32 value)
+{
+    emitMem(0xC7, 1, 0, GUEST, -1, r * 4);
+    emit32(value);
+}
+
+static inline void storeFlagImm(int base, uInt32 value)
+{
+    emitMem(0xC7, 1, 0, base, -1, 0);
+    emit32(value);
+}
+
+static inline void movImm(int x86, uInt32 value)    {emit8(0xB8 + x86); emit32(value);}
+static inline void movReg(int dst, int src)         {emitReg(0x89, 1, src, dst);}
+static inline void aluReg(uInt8 op, int dst, int src) {emitReg(op, 1, src, dst);}    // op = 01 add, 09 or, 21 and, 29 sub, 31 xor, 39 cmp
+static inline void aluImm(int n, int dst, uInt32 value) {emitReg(0x81, 1, n, dst); emit32(value);}   // n = 0 add, 4 and, 5 sub
+static inline void shiftImm(int n, int dst, uInt8 count) {emitReg(0xC1, 1, n, dst); emit8(count);}  // n = 4 shl, 5 shr, 7 sar
+static inline void setFlag(uInt8 cc, int dst)       {emitReg(0x0F90 | cc, 2, 0, dst); emitReg(0x0FB6, 2, dst, dst);}    // setcc + movzx
+
+#define ALU_ADD  0x01
+#define ALU_OR   0x09
+#define ALU_AND  0x21
+#define ALU_SUB  0x29
+#define ALU_XOR  0x31
+#define ALU_CMP  0x39
+
+#define CC_B     0x2        // Carry set (borrow)
+#define CC_AE    0x3        // Carry clear (no borrow)
+
+// Read the ARM memory at the address in eax into eax - the same test as Thumbulator::read32()
+// and friends. opcode is the load (mov, movzx or movsx) and its length.
+static void emitRead(uInt32 opcode, int length, uInt8 prefix = 0)
+{
+    emit8(0xA9); emit32(0x40000000);                // test eax, 0x40000000
+    emit8(0x74); uInt8 *romBranch = codePtr++;      // jz rom
+    emit8(0x25); emit32(RAMADDMASK);                // and eax, RAMADDMASK
+    emitMem(opcode, length, RAX, RAM, RAX, 0, false, prefix);
+    emit8(0xEB); uInt8 *doneBranch = codePtr++;     // jmp done
+    *romBranch = (uInt8)(codePtr - romBranch - 1);
+    emitMem(opcode, length, RAX, ROM, RAX, 0, false, prefix);
+    *doneBranch = (uInt8)(codePtr - doneBranch - 1);
+}
+
+static inline void emitRead32(void)  {emitRead(0x8B, 1);}
+static inline void emitRead16(void)  {emitRead(0x0FB7, 2);}
+static inline void emitRead8(void)   {emitRead(0x0FB6, 2);}
+static inline void emitReadS16(void) {emitRead(0x0FBF, 2);}
+static inline void emitReadS8(void)  {emitRead(0x0FBE, 2);}
+
+// The stack is always in the ARM RAM (readRAM32)
+static void emitReadRAM32(void)
+{
+    emit8(0x25); emit32(RAMADDMASK);
+    emitMem(0x8B, 1, RAX, RAM, RAX, 0);
+}
+
+// Write ecx to the ARM RAM at the address in eax - all writes are masked into the RAM
+static void emitWrite32(void) {emit8(0x25); emit32(RAMADDMASK); emitMem(0x89, 1, RCX, RAM, RAX, 0);}
+static void emitWrite16(void) {emit8(0x25); emit32(RAMADDMASK); emitMem(0x89, 1, RCX, RAM, RAX, 0, false, 0x66);}
+static void emitWrite8(void)  {emit8(0x25); emit32(RAMADDMASK); emitMem(0x88, 1, RCX, RAM, RAX, 0);}
+
+static void emitPrologue(void)
+{
+    emit8(0x53);                                    // push rbx
+    emit8(0x55);                                    // push rbp
+    emit8(0x41); emit8(0x54);                       // push r12
+    emit8(0x41); emit8(0x55);                       // push r13
+    emit8(0x41); emit8(0x56);                       // push r14
+    emit8(0x41); emit8(0x57);                       // push r15
+    emit8(0x48); emit8(0xB8 + GUEST);       emit64((uint64_t)(uintptr_t)reg_sys);
+    emit8(0x48); emit8(0xB8 + CFLAG);       emit64((uint64_t)(uintptr_t)&cFlag);
+    emit8(0x49); emit8(0xB8 + (ZNFLAG & 7)); emit64((uint64_t)(uintptr_t)&thumbZNflags);
+    emit8(0x49); emit8(0xB8 + (VFLAG & 7)); emit64((uint64_t)(uintptr_t)&thumbVflag);
+    emit8(0x49); emit8(0xB8 + (RAM & 7));   emit64((uint64_t)(uintptr_t)&myARMRAM);
+    emitMem(0x8B, 1, RAM, RAM, -1, 0, true);        // mov r14, [r14]
+    emit8(0x49); emit8(0xB8 + (ROM & 7));   emit64((uint64_t)(uintptr_t)cart_buffer);
+}
+
+static void emitEpilogue(void)
+{
+    emit8(0x41); emit8(0x5F);                       // pop r15
+    emit8(0x41); emit8(0x5E);                       // pop r14
+    emit8(0x41); emit8(0x5D);                       // pop r13
+    emit8(0x41); emit8(0x5C);                       // pop r12
+    emit8(0x5D);                                    // pop rbp
+    emit8(0x5B);                                    // pop rbx
+    emit8(0xC3);                                    // ret
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ThumbTranslator::flush(void)
+{
+    if (codeBase == NULL)
+    {
+        void *code = mmap(NULL, TRANSLATE_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED)
+        {
+            fprintf(stderr, "thumb translator: unable to map %u bytes for code - interpreting instead\n", TRANSLATE_CODE_SIZE);
+            bThumbTranslate = false;
+            return;
+        }
+        codeBase = (uInt8*)code;
+    }
+
+    codePtr = codeBase;
+    blocksUsed = 0;
+    memset(blockMap, 0x00, sizeof(blockMap));
+    memset(blockHeat, 0x00, sizeof(blockHeat));
+    statFlushes++;
+}
+
+// ---------------------------------------------------------------------------------------
+// Emit one (non-branching) Thumb instruction - false if it's one we leave to the interpreter.
+// The cases follow the ones in Thumbulator::execute() - see there for what each one does.
+// ---------------------------------------------------------------------------------------
+bool ThumbTranslator::translateOp(uInt32 addr, uInt16 inst, Thumbulator::Op op)
+{
+    typedef Thumbulator::Op Op;
+    uInt32 rd = inst & 0x7;
+    uInt32 rn = (inst >> 3) & 0x7;
+    uInt32 rm = (inst >> 6) & 0x7;
+    uInt32 r8 = (inst >> 8) & 0x7;
+    uInt32 hd = (inst & 0x7) | ((inst >> 4) & 0x8);
+    uInt32 hm = (inst >> 3) & 0xF;
+
+#ifdef THUMB_FLAG_LIVENESS
+    liveFlags = thumbLiveFlags[addr >> 1];
+#endif
+
+    switch (op)
+    {
+        case Op::add1:          // rd = rn + imm3 (flags ZN) - with an imm3 of zero it does nothing at all
+            if (rm == 0) return true;
+            loadGuest(RAX, rn); aluImm(0, RAX, rm); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::incr:
+        case Op::add2_r0: case Op::add2_r1: case Op::add2_r2: case Op::add2_r3:
+        case Op::add2_r4: case Op::add2_r5: case Op::add2_r6: case Op::add2_r7:
+            loadGuest(RAX, r8); aluImm(0, RAX, inst & 0xFF); storeGuest(r8, RAX); storeZN(RAX);
+            return true;
+
+        case Op::add3:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::add4:          // High registers, no flags - but leave anything with the PC to the interpreter
+            if ((hd == 15) || (hm == 15)) return false;
+            loadGuest(RAX, hd); loadGuest(RCX, hm); aluReg(ALU_ADD, RAX, RCX); storeGuest(hd, RAX);
+            return true;
+
+        case Op::add5:          // rd = PC (word aligned) + imm8*4 - known now
+            storeGuestImm(r8, ((addr + 4) & ~3) + ((inst & 0xFF) << 2));
+            return true;
+
+        case Op::add6:          // rd = SP + imm8*4
+            loadGuest(RAX, 13); aluImm(0, RAX, (inst & 0xFF) << 2); storeGuest(r8, RAX);
+            return true;
+
+        case Op::add7:          // SP += imm7*4
+            loadGuest(RAX, 13); aluImm(0, RAX, (inst & 0x7F) << 2); storeGuest(13, RAX);
+            return true;
+
+        case Op::sub4:          // SP -= imm7*4
+            loadGuest(RAX, 13); aluImm(5, RAX, (inst & 0x7F) << 2); storeGuest(13, RAX);
+            return true;
+
+        case Op::and_:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_AND, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::eor:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_XOR, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::orr:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_OR, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::bic:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); emitReg(0xF7, 1, 2, RCX); aluReg(ALU_AND, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::mvn:
+            loadGuest(RAX, rn); emitReg(0xF7, 1, 2, RAX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::mul:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); emitReg(0x0FAF, 2, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::neg:           // Carry is set only when negating zero
+            loadGuest(RAX, rn); emitReg(0xF7, 1, 3, RAX); setFlag(CC_AE, RDX); storeGuest(rd, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::tst:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_AND, RAX, RCX); storeZN(RAX);
+            return true;
+
+        case Op::cmn:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_ADD, RAX, RCX); setFlag(CC_B, RDX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::cmp1_r0: case Op::cmp1_r1: case Op::cmp1_r2: case Op::cmp1_r3:
+        case Op::cmp1_r4: case Op::cmp1_r5: case Op::cmp1_r6: case Op::cmp1_r7: case Op::cmp1_nc:
+            loadGuest(RAX, r8); aluImm(5, RAX, inst & 0xFF); setFlag(CC_AE, RDX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::cmp2: case Op::cmp2_r2: case Op::cmp2_r3: case Op::cmp2_nc:
+            loadGuest(RAX, rd); loadGuest(RCX, rn); aluReg(ALU_SUB, RAX, RCX); setFlag(CC_AE, RDX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::cmp3:
+            if ((hd == 15) || (hm == 15)) return false;
+            loadGuest(RAX, hd); loadGuest(RCX, hm); aluReg(ALU_SUB, RAX, RCX); setFlag(CC_AE, RDX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::cpy:
+            loadGuest(RAX, rn); storeGuest(rd, RAX);
+            return true;
+
+        case Op::mov3:
+            if ((hd == 15) || (hm == 15)) return false;
+            loadGuest(RAX, hm); storeGuest(hd, RAX);
+            return true;
+
+        case Op::mov1:
+            storeGuestImm(r8, inst & 0xFF);
+            if (liveFlags & THUMB_FLAG_ZN) storeFlagImm(ZNFLAG, inst & 0xFF);
+            return true;
+
+        case Op::mov1z:         // Leaves the flags alone
+            storeGuestImm(r8, 0);
+            return true;
+
+        case Op::mov2:
+            loadGuest(RAX, rn); storeGuest(rd, RAX); storeZN(RAX);
+            if (liveFlags & THUMB_FLAG_C) storeFlagImm(CFLAG, 0);
+            if (liveFlags & THUMB_FLAG_V) storeFlagImm(VFLAG, 0);
+            return true;
+
+        case Op::lsl1:          // LSL #0 is a move
+            loadGuest(RAX, rn); storeGuest(rd, RAX); storeZN(RAX);
+            return true;
+
+        case Op::lsl1_rb:       // The carry is left as the bit shifted out rather than 1
+            loadGuest(RAX, rn); movReg(RDX, RAX); aluImm(4, RDX, 1u << (32 - ((inst >> 6) & 0x1F)));
+            shiftImm(4, RAX, (inst >> 6) & 0x1F); storeGuest(rd, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::lsr1:
+            loadGuest(RAX, rn); movReg(RDX, RAX);
+            if (((inst >> 6) & 0x1F) == 0)
+            {
+                aluImm(4, RDX, 0x80000000); movImm(RAX, 0);
+            }
+            else
+            {
+                aluImm(4, RDX, 1u << (((inst >> 6) & 0x1F) - 1)); shiftImm(5, RAX, (inst >> 6) & 0x1F);
+            }
+            storeGuest(rd, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::asr1:
+            loadGuest(RAX, rn); movReg(RDX, RAX);
+            if (((inst >> 6) & 0x1F) == 0)
+            {
+                shiftImm(5, RDX, 31); shiftImm(7, RAX, 31);
+            }
+            else
+            {
+                aluImm(4, RDX, 1u << (((inst >> 6) & 0x1F) - 1)); shiftImm(7, RAX, (inst >> 6) & 0x1F);
+            }
+            storeGuest(rd, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::sub1: case Op::sub1_nc:    // rd = rn - imm3
+            loadGuest(RAX, rn); aluImm(5, RAX, rm); setFlag(CC_AE, RDX); storeGuest(rd, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::sub2: case Op::sub2_nc:
+            loadGuest(RAX, r8); aluImm(5, RAX, inst & 0xFF); setFlag(CC_AE, RDX); storeGuest(r8, RAX); storeZN(RAX); storeC(RDX);
+            return true;
+
+        case Op::sub3: case Op::sub3_nc:    // The interpreter works the carry out from rn and rm after rd is written
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_SUB, RAX, RCX); storeGuest(rd, RAX); storeZN(RAX);
+            if (liveFlags & THUMB_FLAG_C)
+            {
+                loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_CMP, RAX, RCX); setFlag(CC_AE, RDX); storeC(RDX);
+            }
+            return true;
+
+        case Op::ldr1_r0: case Op::ldr1_r1: case Op::ldr1_r2: case Op::ldr1_r3:
+        case Op::ldr1_r4: case Op::ldr1_r5: case Op::ldr1_r6: case Op::ldr1_r7:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 4) & 0x7C); emitRead32(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldr2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); emitRead32(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldr3:          // PC relative - the literal is in the ROM so it's known now
+            storeGuestImm(r8, *(uInt32*)((((uintptr_t)&cart_buffer[addr + 2]) + ((inst << 2) & 0x3FF) + 2) & ~3));
+            return true;
+
+        case Op::ldr4_r0: case Op::ldr4_r1: case Op::ldr4_r2: case Op::ldr4_r3:
+        case Op::ldr4_r4: case Op::ldr4_r5: case Op::ldr4_r6: case Op::ldr4_r7:
+            loadGuest(RAX, 13); aluImm(0, RAX, (inst << 2) & 0x3FF); emitReadRAM32(); storeGuest(r8, RAX);
+            return true;
+
+        case Op::ldrb1:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 6) & 0x1F); emitRead8(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldrb2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); emitRead8(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldrh1:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 5) & 0x3E); emitRead16(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldrh2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); emitRead16(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldrsb:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); emitReadS8(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::ldrsh:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); emitReadS16(); storeGuest(rd, RAX);
+            return true;
+
+        case Op::str1:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 4) & 0x7C); loadGuest(RCX, rd); emitWrite32();
+            return true;
+
+        case Op::str2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); loadGuest(RCX, rd); emitWrite32();
+            return true;
+
+        case Op::str3: case Op::str3_r2: case Op::str3_r3:
+            loadGuest(RAX, 13); aluImm(0, RAX, (inst << 2) & 0x3FF); loadGuest(RCX, r8); emitWrite32();
+            return true;
+
+        case Op::strb1:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 6) & 0x1F); loadGuest(RCX, rd); emitWrite8();
+            return true;
+
+        case Op::strb2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); loadGuest(RCX, rd); emitWrite8();
+            return true;
+
+        case Op::strh1:
+            loadGuest(RAX, rn); aluImm(0, RAX, (inst >> 5) & 0x3E); loadGuest(RCX, rd); emitWrite16();
+            return true;
+
+        case Op::strh2:
+            loadGuest(RAX, rn); loadGuest(RCX, rm); aluReg(ALU_ADD, RAX, RCX); loadGuest(RCX, rd); emitWrite16();
+            return true;
+
+        case Op::push:          // LR first then R7 down to R0 - SP kept in edx
+            loadGuest(RDX, 13);
+            for (int r = 8; r >= 0; r--)
+            {
+                if (inst & (1 << r))
+                {
+                    aluImm(5, RDX, 4); movReg(RAX, RDX); loadGuest(RCX, (r == 8) ? 14 : r); emitWrite32();
+                }
+            }
+            storeGuest(13, RDX);
+            return true;
+
+        case Op::pop:           // POP {PC} is a branch to somewhere we can't know - the interpreter does it
+            if (inst & 0x100) return false;
+            loadGuest(RDX, 13);
+            for (int r = 0; r < 8; r++)
+            {
+                if (inst & (1 << r))
+                {
+                    movReg(RAX, RDX); emitReadRAM32(); storeGuest(r, RAX); aluImm(0, RDX, 4);
+                }
+            }
+            storeGuest(13, RDX);
+            return true;
+
+        case Op::uxtb:
+            loadGuest(RAX, rn); emitReg(0x0FB6, 2, RAX, RAX); storeGuest(rd, RAX);
+            return true;
+
+        case Op::uxth:
+            loadGuest(RAX, rn); emitReg(0x0FB7, 2, RAX, RAX); storeGuest(rd, RAX);
+            return true;
+
+        case Op::sxtb:
+            loadGuest(RAX, rn); emitReg(0x0FBE, 2, RAX, RAX); storeGuest(rd, RAX);
+            return true;
+
+        case Op::sxth:
+            loadGuest(RAX, rn); emitReg(0x0FBF, 2, RAX, RAX); storeGuest(rd, RAX);
+            return true;
+
+        case Op::rev:
+            loadGuest(RAX, rn); emit8(0x0F); emit8(0xC8 + RAX); storeGuest(rd, RAX);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// ---------------------------------------------------------------------------------------
+// Translate the block starting at start. Returns &noBlock if its very first instruction
+// is one we don't translate.
+// ---------------------------------------------------------------------------------------
+ThumbTranslator::Block* ThumbTranslator::translate(uInt32 start)
+{
+    typedef Thumbulator::Op Op;
+
+    if ((blocksUsed >= TRANSLATE_BLOCKS) || ((codePtr - codeBase) > (TRANSLATE_CODE_SIZE - 64 * 1024))) flush();
+
+    Block *block = &blockPool[blocksUsed];
+    uInt8 *entry = codePtr;
+    uInt32 addr = start;
+    block->count = 0;
+    block->cond = COND_NONE;
+    block->target = 0;
+
+    emitPrologue();
+
+    while ((block->count < TRANSLATE_MAX_OPS) && (addr < thumbRomMask - 1))
+    {
+        uInt16 inst = *(uInt16*)&cart_buffer[addr];
+        Thumbulator::decodeAt(addr);
+        Op op = (Op)thumbDecoded[addr >> 1];
+
+        if ((op >= Op::b1_000_neg) && (op <= Op::b1_d00))   // B(1) - conditional branch
+        {
+            Int32 offset = (inst & 0x80) ? (Int32)(inst | 0xFFFFFF00) : (Int32)(inst & 0xFF);
+            block->cond = (inst >> 8) & 0x0F;
+            block->target = addr + 4 + offset * 2;
+            block->count++;
+            addr += 2;
+            break;
+        }
+
+        if ((op == Op::b2_pos) || (op == Op::b2_neg))        // B(2) - unconditional branch
+        {
+            Int32 offset = (inst & 0x400) ? (Int32)(inst | 0xFFFFF800) : (Int32)(inst & 0x7FF);
+            block->cond = COND_ALWAYS;
+            block->target = addr + 4 + offset * 2;
+            block->count++;
+            addr += 2;
+            break;
+        }
+
+        if ((op == Op::blx1) && ((inst & 0x1800) == 0x1000) && ((*(uInt16*)&cart_buffer[addr + 2] & 0xF800) == 0xF800))
+        {
+            // BL - both halves together. LR ends up the address after it with the Thumb bit set.
+            uInt16 low = *(uInt16*)&cart_buffer[addr + 2];
+            Int32 high = (inst & 0x400) ? (Int32)((inst & 0x7FF) | 0xFFFFF800) : (Int32)(inst & 0x7FF);
+            storeGuestImm(14, (addr + 4) | 1);
+            block->cond = COND_ALWAYS;
+            block->target = addr + 4 + (high << 12) + ((low & 0x7FF) << 1);
+            block->count += 2;
+            addr += 4;
+            break;
+        }
+
+        uInt8 *before = codePtr;
+        if (!translateOp(addr, inst, op))
+        {
+            codePtr = before;
+            break;
+        }
+        block->count++;
+        addr += 2;
+    }
+
+    if (block->count == 0)
+    {
+        codePtr = entry;
+        return &noBlock;
+    }
+
+    emitEpilogue();
+
+    block->code = (void (*)(void))entry;
+    block->next = addr;
+    blocksUsed++;
+    statBlocks++;
+    statOps += block->count;
+    return block;
+}
+
+// ---------------------------------------------------------------------------------------
+// The same tests as the B(1) cases in Thumbulator::execute()
+// ---------------------------------------------------------------------------------------
+bool ThumbTranslator::conditionPassed(uInt8 cond)
+{
+    bool n = (thumbZNflags & 0x80000000) ? true : false;
+    bool v = thumbVflag ? true : false;
+
+    switch (cond)
+    {
+        case 0x0: return !thumbZNflags;
+        case 0x1: return thumbZNflags ? true : false;
+        case 0x2: return cFlag ? true : false;
+        case 0x3: return !cFlag;
+        case 0x4: return n;
+        case 0x5: return !n;
+        case 0x6: return v;
+        case 0x7: return !v;
+        case 0x8: return cFlag && thumbZNflags;
+        case 0x9: return !thumbZNflags || !cFlag;
+        case 0xA: return (n == v);
+        case 0xB: return (n != v);
+        case 0xC: return (n == v) && thumbZNflags;
+        case 0xD: return (n != v) || !thumbZNflags;
+        case COND_ALWAYS: return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------------------
+// Run the block natively, put everything back and run the same instructions through the
+// interpreter - then compare the two. The interpreter's results are the ones kept.
+// ---------------------------------------------------------------------------------------
+static uInt8  checkRAM[RAMSIZE];
+static uInt8  nativeRAM[RAMSIZE];
+
+void ThumbTranslator::check(Thumbulator *thumb, Block *block, uInt32 pc)
+{
+    // The DPC+ (and small CDF) drivers give the ARM the 8K fast buffer rather than a full 32K
+    uInt32 ramSize = (myARMRAM == fast_cart_buffer) ? (8 * 1024) : RAMSIZE;
+
+    uInt32 regs[16], c = cFlag, zn = thumbZNflags, v = thumbVflag;
+    memcpy(regs, reg_sys, sizeof(regs));
+    memcpy(checkRAM, myARMRAM, ramSize);
+
+    block->code();
+    uInt32 nativeRegs[16], nativeC = cFlag, nativeZN = thumbZNflags, nativeV = thumbVflag;
+    uInt32 nativePC = conditionPassed(block->cond) ? block->target : block->next;
+    memcpy(nativeRegs, reg_sys, sizeof(nativeRegs));
+    memcpy(nativeRAM, myARMRAM, ramSize);
+
+    memcpy(reg_sys, regs, sizeof(regs));
+    memcpy(myARMRAM, checkRAM, ramSize);
+    cFlag = c; thumbZNflags = zn; thumbVflag = v;
+    reg_sys[15] = pc + 2;
+    bool stepped = thumb->step(block->count);
+    uInt32 interpretedPC = (reg_sys[15] - 2) & ~1;
+
+    // A flag that nothing can look at before it's set again is left alone by the translated code
+    uInt8 live = THUMB_FLAG_ALL;
+#ifdef THUMB_FLAG_LIVENESS
+    live = thumbLiveFlags[(block->next - 2) >> 1];
+#endif
+
+    statChecked++;
+    const char *what = NULL;
+    int which = -1;
+    if (!stepped) what = "the interpreter left the ARM code";
+    else if (nativePC != interpretedPC) what = "next PC";
+    else if ((live & THUMB_FLAG_C) && (nativeC != cFlag)) what = "C flag";
+    else if ((live & THUMB_FLAG_ZN) && (nativeZN != thumbZNflags)) what = "N/Z flags";
+    else if ((live & THUMB_FLAG_V) && (nativeV != thumbVflag)) what = "V flag";
+    else
+    {
+        for (int r = 0; (r < 15) && (which < 0); r++) if (nativeRegs[r] != reg_sys[r]) which = r;
+        if (which >= 0) what = "register";
+        else
+        {
+            for (uInt32 i = 0; (i < ramSize) && (which < 0); i++) if (nativeRAM[i] != myARMRAM[i]) which = i;
+            if (which >= 0) what = "RAM";
+        }
+    }
+
+    if (what)
+    {
+        if (statMismatches++ < 20)
+        {
+            printf("thumb translator: block %05X (%u ops) differs from the interpreter - %s", pc, block->count, what);
+            if (which >= 0) printf(" %u (native %08X, interpreter %08X)", which,
+                                   (what[0] == 'r') ? nativeRegs[which] : nativeRAM[which], (what[0] == 'r') ? reg_sys[which] : myARMRAM[which]);
+            else if (what[0] == 'n') printf(" (native %05X, interpreter %05X)", nativePC, interpretedPC);
+            printf("\n");
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ThumbTranslator::run(Thumbulator *thumb)
+{
+    uInt32 pc = (reg_sys[15] - 2) & ~1;
+    bool leader = true;     // Only where a branch lands (or after a block) can a block start
+
+    for (;;)
+    {
+        Block *block = NULL;
+        if (leader && (pc <= thumbRomMask))
+        {
+            block = blockMap[pc >> 1];
+            if ((block == NULL) && (++blockHeat[pc >> 1] >= TRANSLATE_HOT))
+            {
+                block = translate(pc);
+                blockMap[pc >> 1] = block;
+            }
+        }
+
+        if (block && (block != &noBlock))
+        {
+            if (bThumbTranslateCheck)
+            {
+                check(thumb, block, pc);
+                pc = (reg_sys[15] - 2) & ~1;
+            }
+            else
+            {
+                block->code();
+                pc = conditionPassed(block->cond) ? block->target : block->next;
+            }
+            statRun += block->count;
+            leader = true;
+            continue;
+        }
+
+        reg_sys[15] = pc + 2;
+        statStepped++;
+        if (!thumb->step(1)) return;
+        uInt32 next = (reg_sys[15] - 2) & ~1;
+        leader = (next != pc + 2) || (block == &noBlock);
+        pc = next;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+uint64_t ThumbTranslator::executed(void)
+{
+    return statRun + statStepped;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ThumbTranslator::startTiming(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &statStart);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ThumbTranslator::stopTiming(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    statSeconds += (double)(now.tv_sec - statStart.tv_sec) + (double)(now.tv_nsec - statStart.tv_nsec) / 1000000000.0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double ThumbTranslator::seconds(void)
+{
+    return statSeconds;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ThumbTranslator::report(void)
+{
+    printf("thumb:   %u blocks translated (%u ops, %u flushes), %llu ops run natively, %llu stepped",
+           statBlocks, statOps, statFlushes, (unsigned long long)statRun, (unsigned long long)statStepped);
+    if (statChecked) printf(", %u blocks checked, %u mismatches", statChecked, statMismatches);
+    printf("\n");
+}
+
+#endif
@@ -0,0 +1,1477 @@
+// =====================================================================================================
+// Stella DS/DSi Pheonix Edition - Headless Host Runner
+//
+// Copyright (c) 2020-2024 by Dave Bernazzani
+//
+// Copying and distribution of this emulator, it's source code and associated
+// readme files, with or without modification, are permitted in any medium without
+// royalty provided this copyright notice is used and wavemotion-dave (Phoenix-Edition),
+// Alekmaul (original port) are thanked profusely along with the entire Stella Team.
+//
+// The StellaDS emulator is offered as-is, without any warranty.
+// =====================================================================================================
+//
+// stellads-headless: runs the unmodified emucore on a PC with no screen, no sound and
+// no input. It loads a ROM, runs a number of frames as fast as possible and reports the
+// frames-per-second along with a hash of the rendered output. The hash lets us make
+// sure that a performance change didn't change what ends up on the screen - the same
+// ROM run for the same number of frames with the same seed must produce the same hash.
+//
+// The sound hardware is "pumped" once per frame at the same rate the DS TIMER2 interrupt
+// would have called into the sound core so the timing includes the audio work as well.
+// In a TIA_SOUND_ARM7 build the pump stands in for the ARM7 instead and plays the frame's
+// register log through the shared sound core in ../arm9/source/common.
+// =====================================================================================================
+#include <nds.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <malloc.h>
+#include <dirent.h>
+
+#include "Console.hxx"
+#include "M6502Low.hxx"
+#include "Cart.hxx"
+#include "System.hxx"
+#include "TIA.hxx"
+#include "TIASound.hxx"
+#include "TIASynth.h"
+#include "Thumbulator.hxx"
+#include "config.h"
+
+// ---------------------------------------------------------------------------
+// All the bits and pieces that the DS front end (StellaDS.cpp, config.cpp)
+// normally provides to the emucore...
+// ---------------------------------------------------------------------------
+#define MAX_DEBUG 40
+Int32  debug[MAX_DEBUG]={0};
+char   my_filename[200] = {0};
+uInt8  tv_type_requested = NTSC;
+uInt8  gSaveKeyEEWritten = false;
+uInt8  gSaveKeyIsDirty = false;
+uInt16 mySoundFreq = 20933;
+uInt32 gAtariFrames = 0;
+uInt32 gTotalAtariFrames = 0;
+uint8  bHaltEmulation = 0;
+
+uint8  sound_buffer[SOUND_SIZE] __attribute__ ((aligned (4))) = {0};
+uint16 *aptr = (uint16*)&sound_buffer[0];
+uint16 *bptr = (uint16*)&sound_buffer[2];
+
+struct AllConfig_t allConfigs;      // Always empty - the internal database is used for everything (but see -m)
+
+Console* theConsole = (Console*) NULL;
+
+void dsWarnIncompatibileCart(void)
+{
+    fprintf(stderr, "CART TYPE NOT SUPPORTED\n");
+    bHaltEmulation = 1;
+}
+
+void dsWarnOutOfMemory(void)
+{
+    fprintf(stderr, "NOT ENOUGH MEMORY FOR CART\n");
+    bHaltEmulation = 1;
+}
+
+void dsPrintCartType(char *type, int size)
+{
+}
+
+bool isDSiMode(void)
+{
+    return true;    // Always run as the faster DSi so we get all the full-speed drivers
+}
+
+// ---------------------------------------------------------------------------
+// time() is wrapped at link time (see host/Makefile) so that the Random
+// class and the TIA sound poly9 table produce the same values run-to-run.
+// ---------------------------------------------------------------------------
+static time_t host_seed = 0;
+extern "C" time_t __wrap_time(time_t *t)
+{
+    if (t) *t = host_seed;
+    return host_seed;
+}
+
+// ---------------------------------------------------------------------------
+// Map the DS VRAM the emucore addresses directly (frame buffer and sound
+// buffers) at its real address. Everything else is ordinary host memory.
+// ---------------------------------------------------------------------------
+int host_platform_init(void)
+{
+    void *vram = mmap((void*)HOST_VRAM_BASE, HOST_VRAM_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (vram != (void*)HOST_VRAM_BASE)
+    {
+        fprintf(stderr, "Unable to map DS VRAM at 0x%08X\n", HOST_VRAM_BASE);
+        return 0;
+    }
+
+    // Keep all heap allocations below 4GB - the emucore stores some pointers in 32-bit integers
+    mallopt(M_MMAP_MAX, 0);
+
+    return 1;
+}
+
+static double host_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// ---------------------------------------------------------------------------
+// The DS hardware timers. With TIA_SOUND_BLOCKS (or TIA_SOUND_WAVE_LOG),
+// TIMER3 counts the samples the ARM7 has played - here that's however many
+// samples a frame is worth.
+// ---------------------------------------------------------------------------
+static u16 host_samples_played = 0;
+u16 host_timer_data(int timer)
+{
+    if (timer == 3) return host_samples_played;
+    return (u16)(host_seconds() * 32728.5);
+}
+
+// ---------------------------------------------------------------------------
+// CPU time used by the whole process so far - this includes the static
+// constructors (the TIA builds its tables there) that run before main().
+// ---------------------------------------------------------------------------
+static double host_cpu_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// ---------------------------------------------------------------------------
+// FNV-1a over the 160 visible pixels of each line of the DS frame buffer.
+// ---------------------------------------------------------------------------
+static uInt32 hashFrame(uInt32 hash)
+{
+    const uInt8 *line = (const uInt8 *)BG_GFX;
+    for (int y = 0; y < 256; y++, line += 256)
+    {
+        for (int x = 0; x < 160; x++)
+        {
+            hash = (hash ^ line[x]) * 16777619;
+        }
+    }
+    return hash;
+}
+
+#ifdef TIA_SOUND_ARM7
+// ---------------------------------------------------------------------------
+// Stand in for the ARM7 - play the AUDx writes the TIA logged this frame
+// through the synthesiser just as arm7/source/emusoundfifo.c does. The
+// samples are hashed and the log can be saved (-l) for replaying with -y.
+// ---------------------------------------------------------------------------
+static TiaSynth host_synth;
+static uint16_t host_ring[TIA_SYNTH_RING_SIZE];
+static uint32_t host_ring_idx = 0;
+static uint32_t host_synth_samples = 0;
+static uint32_t host_synth_digest = 2166136261;
+static FILE    *host_sound_log = NULL;
+
+static void startSynth(void)
+{
+    TiaSynth_init(&host_synth, TIA_SYNTH_CLOCK, mySoundFreq, tia_synth_shared.bit9);
+    TiaSynth_bandlimit(&host_synth, tia_synth_shared.bandlimited);
+    tia_synth_shared.tail = tia_synth_shared.head;
+}
+
+static void pumpSynth(void)
+{
+    while (tia_synth_shared.tail != tia_synth_shared.head)
+    {
+        uint32_t record = tia_synth_shared.records[tia_synth_shared.tail & (TIA_SYNTH_FIFO_SIZE-1)];
+        if (host_sound_log) fwrite(&record, sizeof(record), 1, host_sound_log);
+
+        uint32_t samples = TiaSynth_record(&host_synth, record, host_ring, TIA_SYNTH_RING_SIZE-1, &host_ring_idx);
+        for (uint32_t i = host_ring_idx - samples; i != host_ring_idx; i++)
+        {
+            host_synth_digest = (host_synth_digest ^ host_ring[i & (TIA_SYNTH_RING_SIZE-1)]) * 16777619;
+        }
+        host_synth_samples += samples;
+        tia_synth_shared.tail++;
+
+        if (TIA_SYNTH_REG(record) == TIA_SYNTH_FRAME) tia_synth_shared.played = TIA_SYNTH_RECORD(0, TIA_SYNTH_FRAME, TIA_SYNTH_VALUE(record));
+    }
+    tia_synth_shared.ahead = (int16_t)((uint16_t)host_ring_idx - host_samples_played);
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Stand in for the DS TIMER2 interrupt - generate one frame worth of samples.
+// ---------------------------------------------------------------------------
+static void pumpSound(void)
+{
+    if (myCartInfo.soundQuality == SOUND_MUTE) return;
+
+    uInt16 samples = (myCartInfo.tv_type == PAL) ? (mySoundFreq / 50) : (mySoundFreq / 60);
+#ifdef TIA_SOUND_BLOCKS
+    if (bBlockSound)
+    {
+        host_samples_played += samples;     // The TIA already made the frame's sound as it ran
+        return;
+    }
+#endif
+#ifdef TIA_SOUND_ARM7
+    if (bArm7Sound)
+    {
+        pumpSynth();                        // The TIA only logged the writes - this is the ARM7's job
+        return;
+    }
+#endif
+#ifdef TIA_SOUND_WAVE_LOG
+    if (bWaveLogSound)
+    {
+        host_samples_played += samples;     // The TIA made the frame's sound from its log at the end of the frame
+        return;
+    }
+#endif
+    if (myCartInfo.soundQuality == SOUND_WAVE)
+    {
+        for (uInt16 i = 0; i < samples; i++) Tia_process_wave();
+    }
+    else
+    {
+        for (uInt16 i = 0; i < samples; i++) Tia_process();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Run one frame - the first one also marks how long it took to boot.
+// ---------------------------------------------------------------------------
+static double boot_seconds = 0.0;
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+static uInt32 host_frame_budget = 0;    // Microseconds each frame has (-b) - 0 runs flat out without skipping
+#endif
+static void emulateFrame(void)
+{
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+    double frame_start = host_seconds();
+    theConsole->update();
+    tiaFrameTime((uInt32)((host_seconds() - frame_start) * 1000000.0), host_frame_budget);
+#else
+    theConsole->update();
+#endif
+    pumpSound();
+    if (boot_seconds == 0.0) boot_seconds = host_cpu_seconds();
+}
+
+// ---------------------------------------------------------------------------
+// Write the DS frame buffer out as a PPM so the output can be eyeballed.
+// ---------------------------------------------------------------------------
+static void writeFrame(const char *filename)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) return;
+
+    const uInt32 *palette = theTIA.palette();
+    const uInt8 *line = (const uInt8 *)BG_GFX;
+    uInt16 lines = (myCartInfo.tv_type == PAL) ? 256 : 210;
+    fprintf(fp, "P6\n160 %d\n255\n", lines);
+    for (int y = 0; y < lines; y++, line += 256)
+    {
+        for (int x = 0; x < 160; x++)
+        {
+            uInt32 rgb = palette[line[x]];
+            fputc((rgb >> 16) & 0xFF, fp);
+            fputc((rgb >> 8) & 0xFF, fp);
+            fputc(rgb & 0xFF, fp);
+        }
+    }
+    fclose(fp);
+}
+
+// ---------------------------------------------------------------------------
+// A small 4K kernel used by -k to time the TIA pixel kernels one object
+// combination at a time. Each frame it sets GRP0/ENAM0/GRP1/ENAM1/ENABL/PF
+// from the bits in RAM $80 (same order as the TIA enabled bits - P0, M0, P1,
+// M1, BL, PF), ORs RAM $81 into CTRLPF (reflect + 4 wide ball) and then sits
+// on WSYNC for 192 lines so every visible line is drawn as one 160 pixel span.
+// ---------------------------------------------------------------------------
+static const uInt8 kernelBenchRom[] =
+{
+    0x78, 0xD8, 0xA2, 0xFF, 0x9A,                           // SEI / CLD / LDX #$FF / TXS
+    0xA9, 0x00, 0xAA, 0x95, 0x00, 0xE8, 0xD0, 0xFB,         // Clear TIA and RAM
+    0xA9, 0x02, 0x85, 0x02, 0x85, 0x00, 0x85, 0x02,         // frame: VSYNC on for 3 lines
+    0x85, 0x02, 0x85, 0x02,
+    0xA9, 0x00, 0x85, 0x00, 0xA9, 0x02, 0x85, 0x01,         // VSYNC off, VBLANK on
+    0xA9, 0x2B, 0x8D, 0x96, 0x02,                           // LDA #43 / STA TIM64T
+    0x85, 0x02, 0xA2, 0x06, 0xCA, 0xD0, 0xFD,               // STA WSYNC and delay
+    0x85, 0x10, 0xEA, 0x85, 0x12, 0xEA, 0x85, 0x11,         // RESP0 RESM0 RESP1 RESM1 RESBL
+    0xEA, 0x85, 0x13, 0xEA, 0x85, 0x14,
+    0xA9, 0x33, 0x85, 0x04, 0xA9, 0x26, 0x85, 0x05,         // NUSIZ0=$33 NUSIZ1=$26
+    0xA9, 0x86, 0x85, 0x06, 0xA9, 0xC6, 0x85, 0x07,         // COLUP0 COLUP1
+    0xA9, 0x46, 0x85, 0x08, 0xA9, 0x00, 0x85, 0x09,         // COLUPF COLUBK
+    0xA5, 0x81, 0x09, 0x21, 0x85, 0x0A,                     // LDA $81 / ORA #$21 / STA CTRLPF
+    0xA5, 0x80,                                             // LDA $80
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0xA5, 0x86, 0x1B,   // GRP0  = bit 0 ? $A5 : 0
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0x02, 0x86, 0x1D,   // ENAM0 = bit 1 ? $02 : 0
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0x5A, 0x86, 0x1C,   // GRP1  = bit 2 ? $5A : 0
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0x02, 0x86, 0x1E,   // ENAM1 = bit 3 ? $02 : 0
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0x02, 0x86, 0x1F,   // ENABL = bit 4 ? $02 : 0
+    0xA2, 0x00, 0x4A, 0x90, 0x02, 0xA2, 0xAA,               // PF0/1/2 = bit 5 ? $AA : 0
+    0x86, 0x0D, 0x86, 0x0E, 0x86, 0x0F,
+    0xAD, 0x84, 0x02, 0xD0, 0xFB,                           // Wait on INTIM
+    0x85, 0x02, 0x85, 0x01, 0xA0, 0xC0,                     // STA WSYNC / STA VBLANK / LDY #192
+    0x85, 0x02, 0x88, 0xD0, 0xFB,                           // line: STA WSYNC / DEY / BNE line
+    0xA9, 0x02, 0x85, 0x01, 0xA9, 0x23, 0x8D, 0x96, 0x02,   // VBLANK on / LDA #35 / STA TIM64T
+    0xAD, 0x84, 0x02, 0xD0, 0xFB,                           // Wait on INTIM
+    0x4C, 0x0D, 0xF0,                                       // JMP frame
+};
+
+// ---------------------------------------------------------------------------
+// Run the kernel above for every object combination in the normal, score
+// and playfield priority modes and report how many pixels per second the
+// TIA draws for each. The hash column covers the last frame of all three
+// modes so kernel changes can be checked against each other.
+// ---------------------------------------------------------------------------
+static int benchKernels(uInt32 frames)
+{
+    static const uInt8 modes[3] = {0x00, 0x02, 0x04};
+
+    memset(cart_buffer, 0xFF, 4096);
+    memcpy(cart_buffer, kernelBenchRom, sizeof(kernelBenchRom));
+    cart_buffer[0xFFC] = 0x00; cart_buffer[0xFFD] = 0xF0;
+    cart_buffer[0xFFE] = 0x00; cart_buffer[0xFFF] = 0xF0;
+    strcpy(my_filename, "kernelbench.bin");
+
+    theConsole = new Console((const uInt8*) cart_buffer, 4096, "noname");
+    if (bHaltEmulation) return 2;
+    theConsole->update();   // Let the kernel clear RAM before we start poking at it
+
+    printf("objects      PF BL M1 M0 P1 P0   normal    score priority  (Mpixels/sec)  hash\n");
+    for (uInt8 objects = 0; objects < 64; objects++)
+    {
+        double rate[3];
+        uInt32 hash = 2166136261;
+        for (uInt8 mode = 0; mode < 3; mode++)
+        {
+            myRAM[0] = objects;
+            myRAM[1] = modes[mode];
+            theConsole->update();   // One frame to pick up the new setup
+
+            double start = host_seconds();
+            for (uInt32 i = 0; i < frames; i++) theConsole->update();
+            double elapsed = host_seconds() - start;
+
+            rate[mode] = (elapsed > 0.0) ? ((double)frames * 192 * 160 / elapsed / 1000000.0) : 0.0;
+            hash = hashFrame(hash);
+        }
+        printf("kernel 0x%02X   %c  %c  %c  %c  %c  %c  %8.1f %8.1f %8.1f                 %08X\n", objects,
+               (objects & 0x20) ? 'x':'.', (objects & 0x10) ? 'x':'.', (objects & 0x08) ? 'x':'.',
+               (objects & 0x02) ? 'x':'.', (objects & 0x04) ? 'x':'.', (objects & 0x01) ? 'x':'.',
+               rate[0], rate[1], rate[2], hash);
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// The full size [mode][oldx][newx] player reset table that the TIA used to
+// build at start up (200K of RAM). Kept here as the reference for -c which
+// checks every mode, old and new position against the compact table.
+// ---------------------------------------------------------------------------
+static void referencePlayerPositionResetWhen(uInt32 mode, uInt32 oldx, Int8 row[160])
+{
+    uInt32 newx;
+
+    for(newx = 0; newx < 160; ++newx)
+    {
+        row[newx] = 0;
+    }
+
+    for(newx = 0; newx < 160 + 72 + 5; ++newx)
+    {
+      if(mode == 0x00)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x01)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 16)) && (newx < (oldx + 16 + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 16 + 4) && (newx < (oldx + 16 + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x02)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x03)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 16)) && (newx < (oldx + 16 + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 16 + 4) && (newx < (oldx + 16 + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x04)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 64)) && (newx < (oldx + 64 + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 64 + 4) && (newx < (oldx + 64 + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x05)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 16)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x06)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 32)) && (newx < (oldx + 32 + 4)))
+          row[newx % 160] = -1;
+        else if((newx >= (oldx + 64)) && (newx < (oldx + 64 + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 32 + 4) && (newx < (oldx + 32 + 4 + 8)))
+          row[newx % 160] = 1;
+        else if((newx >= oldx + 64 + 4) && (newx < (oldx + 64 + 4 + 8)))
+          row[newx % 160] = 1;
+      }
+      else if(mode == 0x07)
+      {
+        if((newx >= oldx) && (newx < (oldx + 4)))
+          row[newx % 160] = -1;
+
+        if((newx >= oldx + 4) && (newx < (oldx + 4 + 32)))
+          row[newx % 160] = 1;
+      }
+    }
+}
+
+static int checkTables(void)
+{
+    uInt32 mismatches = 0;
+    Int8 row[160];
+
+    for (uInt32 mode = 0; mode < 8; mode++)
+    {
+        for (uInt32 oldx = 0; oldx < 160; oldx++)
+        {
+            referencePlayerPositionResetWhen(mode, oldx, row);
+            for (uInt32 newx = 0; newx < 160; newx++)
+            {
+                Int8 when = TIA::playerPositionResetWhen(mode, oldx, newx);
+                if (when != row[newx])
+                {
+                    if (mismatches++ < 10) printf("mode %u oldx %3u newx %3u: expected %d got %d\n", mode, oldx, newx, row[newx], when);
+                }
+            }
+        }
+    }
+
+    printf("resetwhen: %u positions checked, %u mismatches\n", 8 * 160 * 160, mismatches);
+    printf("resetwhen: %u bytes (was %u bytes) - %u bytes saved\n", 8 * 160, 8 * 160 * 160, (8 * 160 * 160) - (8 * 160));
+
+    return mismatches ? 3 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// The MD5 lookups - every internal database entry is looked up through the
+// index and through the linear strcmp() walk it replaced (and the same again
+// against a StellaDS.DAT filled up with as many of those games as it holds)
+// checking they agree and timing both.
+// ---------------------------------------------------------------------------
+#define DATABASE_PASSES 20
+
+static bool isDigestString(const char *md5)
+{
+    return (strlen(md5) == 32) && (strspn(md5, "0123456789abcdef") == 32);
+}
+
+static const CartInfo* referenceFindInternalDatabase(const char *md5)
+{
+    for (const CartInfo* entry = CartInternalDatabase(); (entry->special != 99); ++entry)
+    {
+        if (strcmp(entry->md5, md5) == 0) return entry;
+    }
+    return NULL;
+}
+
+static Int16 referenceFindConfigSlot(const char *md5)
+{
+    for (Int16 slot = 0; slot < MAX_CONFIGS; slot++)
+    {
+        if (strcmp(allConfigs.cart[slot].md5, md5) == 0) return slot;
+    }
+    return -1;
+}
+
+static int benchDatabase(void)
+{
+    const char *md5s[4096];
+    uInt32 count = 0, mismatches = 0;
+
+    for (const CartInfo* entry = CartInternalDatabase(); (entry->special != 99); ++entry)
+    {
+        if (isDigestString(entry->md5) && (count < 4096)) md5s[count++] = entry->md5;
+    }
+
+    double start = host_seconds();
+    for (uInt32 pass = 0; pass < DATABASE_PASSES; pass++)
+        for (uInt32 i = 0; i < count; i++) if (referenceFindInternalDatabase(md5s[i]) == NULL) mismatches++;
+    double linear = host_seconds() - start;
+
+    start = host_seconds();
+    for (uInt32 pass = 0; pass < DATABASE_PASSES; pass++)
+        for (uInt32 i = 0; i < count; i++) if (CartFindInternalDatabase(md5s[i]) == NULL) mismatches++;
+    double indexed = host_seconds() - start;
+
+    for (uInt32 i = 0; i < count; i++)
+    {
+        if (CartFindInternalDatabase(md5s[i]) != referenceFindInternalDatabase(md5s[i]))
+        {
+            if (mismatches++ < 10) printf("database: %s found at the wrong entry\n", md5s[i]);
+        }
+    }
+
+    printf("database: %u entries looked up %u times, %u mismatches\n", count, DATABASE_PASSES, mismatches);
+    printf("database: linear %.3f us/lookup, indexed %.3f us/lookup (%.0fx)\n", linear * 1000000.0 / (count * DATABASE_PASSES),
+           indexed * 1000000.0 / (count * DATABASE_PASSES), (indexed > 0.0) ? (linear / indexed) : 0.0);
+
+    // Save games into a fresh StellaDS.DAT (last entry first so the order differs from the table) until it's full
+    for (Int16 slot = 0; slot < MAX_CONFIGS; slot++) strcpy(allConfigs.cart[slot].md5, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+    CartIndexConfigs();
+
+    uInt32 saved = 0;
+    for (uInt32 i = count; i-- > 0; )
+    {
+        Int16 expected = referenceFindConfigSlot(md5s[i]);     // The table has a few duplicates
+        if (expected < 0) expected = (saved < MAX_CONFIGS) ? saved++ : -1;
+        Int16 slot = CartClaimConfigSlot(md5s[i]);
+        if ((slot != expected) || (CartClaimConfigSlot(md5s[i]) != slot))
+        {
+            if (mismatches++ < 10) printf("config:   %s saved into the wrong slot %d\n", md5s[i], slot);
+        }
+    }
+
+    // And then load it back up as we would at boot
+    start = host_seconds();
+    CartIndexConfigs();
+    double load = host_seconds() - start;
+
+    Int32 found = 0;
+    start = host_seconds();
+    for (uInt32 pass = 0; pass < DATABASE_PASSES; pass++)
+        for (uInt32 i = 0; i < count; i++) found += (referenceFindConfigSlot(md5s[i]) >= 0);
+    linear = host_seconds() - start;
+
+    start = host_seconds();
+    for (uInt32 pass = 0; pass < DATABASE_PASSES; pass++)
+        for (uInt32 i = 0; i < count; i++) found -= (CartFindConfigSlot(md5s[i]) >= 0);
+    double hashed = host_seconds() - start;
+
+    for (uInt32 i = 0; i < count; i++)
+    {
+        if (CartFindConfigSlot(md5s[i]) != referenceFindConfigSlot(md5s[i]))
+        {
+            if (mismatches++ < 10) printf("config:   %s found in the wrong slot\n", md5s[i]);
+        }
+    }
+    if (found) mismatches++;
+
+    printf("config:   %u of %u slots filled, indexed in %.1f us, %u mismatches\n", saved, MAX_CONFIGS, load * 1000000.0, mismatches);
+    printf("config:   linear %.3f us/lookup, hashed %.3f us/lookup (%.0fx)\n", linear * 1000000.0 / (count * DATABASE_PASSES),
+           hashed * 1000000.0 / (count * DATABASE_PASSES), (hashed > 0.0) ? (linear / hashed) : 0.0);
+
+    return mismatches ? 3 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Runs the bankswitch guess for every ROM in a directory both ways - one pass
+// over the image for all the signatures and the old search of the whole image
+// for each signature in turn - reporting any difference and the time taken.
+// ---------------------------------------------------------------------------
+static int compareDetectors(const char *dirname)
+{
+    DIR *dir = opendir(dirname);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", dirname);
+        return 1;
+    }
+
+    uInt32 roms = 0, mismatches = 0;
+    double oldTotal = 0.0, newTotal = 0.0;
+    struct dirent *file;
+    while ((file = readdir(dir)) != NULL)
+    {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s/%s", dirname, file->d_name);
+        FILE *fp = fopen(filename, "rb");
+        if (fp == NULL) continue;
+        uInt32 size = fread(cart_buffer, 1, MAX_CART_FILE_SIZE, fp);
+        bool tooBig = (fgetc(fp) != EOF);
+        fclose(fp);
+        if ((size == 0) || tooBig) continue;
+
+        double start = host_seconds();
+        uInt8 oldBanking = Cartridge::guessBanking(cart_buffer, size, false);
+        double oldTime = host_seconds() - start;
+
+        start = host_seconds();
+        uInt8 newBanking = Cartridge::guessBanking(cart_buffer, size, true);
+        double newTime = host_seconds() - start;
+
+        roms++;
+        oldTotal += oldTime;
+        newTotal += newTime;
+        if (oldBanking != newBanking) mismatches++;
+        printf("detect:  %-40.40s %7u bytes  banking %2u %2u  %9.1f us %9.1f us%s\n", file->d_name, size, oldBanking, newBanking,
+               oldTime * 1000000.0, newTime * 1000000.0, (oldBanking != newBanking) ? "  MISMATCH" : "");
+    }
+    closedir(dir);
+
+    printf("detect:  %u roms, %u mismatches\n", roms, mismatches);
+    if (roms) printf("detect:  old %.1f us/rom, single pass %.1f us/rom (%.1fx)\n", oldTotal * 1000000.0 / roms, newTotal * 1000000.0 / roms,
+                     (newTotal > 0.0) ? (oldTotal / newTotal) : 0.0);
+
+    return mismatches ? 3 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Replay a register log (saved with -l) through both the TIASynth copy of the
+// sound core and the original one in TIASound.cpp and check that every sample
+// matches. Both are run at the full 31.4kHz so every audio clock is compared -
+// the decimation to the output rate is the same few lines of code in both.
+// The original is driven a sample at a time through Tia_process() with the
+// register writes made the same way TIA::poke() makes them.
+// ---------------------------------------------------------------------------
+static int replaySoundLog(const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", filename);
+        return 1;
+    }
+
+    static uint16_t samples[0x10000];
+    uint32_t idx = 0;
+    uint32_t records = 0, compared = 0, mismatches = 0;
+    uint32_t digest = 2166136261;
+    uint32_t cycle = 0;
+    uint32_t record;
+    TiaSynth synth;
+
+    myCartInfo.soundQuality = SOUND_MUTE;   // Just so nothing else is set up - Tia_process() still writes *aptr
+    Tia_sound_init(TIA_SYNTH_CLOCK, TIA_SYNTH_CLOCK);
+    TiaSynth_init(&synth, TIA_SYNTH_CLOCK, TIA_SYNTH_CLOCK, Bit9);
+
+    while (fread(&record, sizeof(record), 1, fp) == 1)
+    {
+        records++;
+        uint32_t start = idx;
+        uint32_t count = TiaSynth_record(&synth, record, samples, 0xFFFF, &idx);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            cycle += TIA_SYNTH_CYCLES;
+            Tia_process();
+            uint16_t expected = *aptr;
+            uint16_t sample = samples[(start + i) & 0xFFFF];
+            if (sample != expected)
+            {
+                if (mismatches++ < 10) printf("record %u cycle %u: expected %04X got %04X\n", records, cycle, expected, sample);
+            }
+            digest = (digest ^ sample) * 16777619;
+        }
+        compared += count;
+
+        uint8_t value = TIA_SYNTH_VALUE(record);
+        switch (TIA_SYNTH_REG(record))
+        {
+            case 0: AUDC[0] = value;      Update_tia_sound_0(); break;
+            case 1: AUDC[1] = value;      Update_tia_sound_1(); break;
+            case 2: AUDF[0] = value;      Update_tia_sound_0(); break;
+            case 3: AUDF[1] = value;      Update_tia_sound_1(); break;
+            case 4: AUDV[0] = value << 3; Update_tia_sound_0(); break;
+            case 5: AUDV[1] = value << 3; Update_tia_sound_1(); break;
+        }
+    }
+    fclose(fp);
+
+    printf("synth:   %u records, %u samples compared, %u mismatches, digest %08X\n", records, compared, mismatches, digest);
+
+    return mismatches ? 3 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Render a register log (saved with -l) to a WAV file at each of the output
+// rates the DS uses, both the plain way (the level taken every Nth audio
+// clock) and band-limited (TiaSynth_bandlimit), and report how much CPU each
+// takes per second of sound made. The files are named after the log - e.g.
+// game.log.15700.wav and game.log.15700-bl.wav - so they can be listened to
+// side by side.
+// ---------------------------------------------------------------------------
+static bool writeWave(const char *filename, const uint16_t *samples, uint32_t count, uint32_t rate)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) return false;
+
+    uint32_t header[11];
+    header[0]  = 0x46464952;                    // "RIFF"
+    header[1]  = 36 + count * 2;
+    header[2]  = 0x45564157;                    // "WAVE"
+    header[3]  = 0x20746D66;                    // "fmt "
+    header[4]  = 16;
+    header[5]  = 1 | (1 << 16);                 // PCM, mono
+    header[6]  = rate;
+    header[7]  = rate * 2;                      // Bytes per second
+    header[8]  = 2 | (16 << 16);                // Bytes per sample, bits per sample
+    header[9]  = 0x61746164;                    // "data"
+    header[10] = count * 2;
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(samples, sizeof(uint16_t), count, fp);
+    fclose(fp);
+
+    return true;
+}
+
+static int renderSoundLog(const char *filename)
+{
+    static const uint16_t rates[] = { 10466, 15700, 20933, TIA_SYNTH_CLOCK };
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", filename);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    uint32_t records = ftell(fp) / sizeof(uint32_t);
+    fseek(fp, 0, SEEK_SET);
+    uint32_t *log = (uint32_t *)malloc(records * sizeof(uint32_t));
+    records = fread(log, sizeof(uint32_t), records, fp);
+    fclose(fp);
+
+    // The log is as long as its frame records add up to
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < records; i++)
+    {
+        if (TIA_SYNTH_REG(log[i]) == TIA_SYNTH_FRAME) cycles += TIA_SYNTH_CYCLE(log[i]);
+    }
+    double seconds = (double)cycles / (TIA_SYNTH_CYCLES * TIA_SYNTH_CLOCK);
+    uint16_t *samples = (uint16_t *)malloc(((uint32_t)(seconds * TIA_SYNTH_CLOCK) + 0x10000) * sizeof(uint16_t));
+
+    printf("render:  %u records, %.1f seconds of sound\n", records, seconds);
+    for (uint32_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        for (uint32_t bandlimited = 0; bandlimited < 2; bandlimited++)
+        {
+            char wavname[512];
+            uint32_t idx = 0;
+            TiaSynth synth;
+
+            TiaSynth_init(&synth, TIA_SYNTH_CLOCK, rates[r], Bit9);
+            TiaSynth_bandlimit(&synth, bandlimited);
+
+            double start = host_cpu_seconds();
+            for (uint32_t i = 0; i < records; i++)
+            {
+                TiaSynth_record(&synth, log[i], samples, 0xFFFFFFFF, &idx);
+            }
+            double cpu = host_cpu_seconds() - start;
+
+            snprintf(wavname, sizeof(wavname), "%s.%u%s.wav", filename, rates[r], bandlimited ? "-bl" : "");
+            if (!writeWave(wavname, samples, idx, rates[r]))
+            {
+                fprintf(stderr, "Unable to write %s\n", wavname);
+                return 1;
+            }
+            printf("render:  %5u Hz %-12s %8u samples, %6.3f ms of CPU per second of sound -> %s\n",
+                   rates[r], bandlimited ? "band-limited" : "plain", idx, (cpu * 1000.0) / seconds, wavname);
+        }
+    }
+
+    free(samples);
+    free(log);
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Check the run-length stepping in TIASynth against Tia_process() for every
+// AUDC/AUDF pair on channel 0 (with channel 1 and both volumes cycling along
+// so every mode gets mixed with others and AUDV=0 is covered). The pairs are
+// played back to back without a reset so each one starts from whatever poly
+// and divider phase the one before left behind. Tia_process() can only stop
+// on a sample so the register writes go in at the audio clock it stopped on -
+// Samp_n_cnt>>8 is how many clocks the next sample takes. Done at each of the
+// output rates the DS uses and timed both ways.
+// ---------------------------------------------------------------------------
+#define RUN_CHECK_SAMPLES 4000
+
+static int checkSoundRuns(void)
+{
+    static const uint16_t rates[] = { TIA_SYNTH_CLOCK, 20933, 15700, 10466 };
+    static uint16_t expected[16 * 32 * RUN_CHECK_SAMPLES];
+    static uint16_t samples[16 * 32 * RUN_CHECK_SAMPLES];
+    static uint32_t ticks[16 * 32];
+    uint32_t mismatches = 0;
+
+    myCartInfo.soundQuality = SOUND_MUTE;   // Just so nothing else is set up - Tia_process() still writes *aptr
+
+    for (uint32_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        uint32_t rate_mismatches = 0;
+        uint32_t idx = 0;
+        TiaSynth synth;
+
+        Tia_sound_init(TIA_SYNTH_CLOCK, rates[r]);
+        TiaSynth_init(&synth, TIA_SYNTH_CLOCK, rates[r], Bit9);
+
+        double start = host_cpu_seconds();
+        for (uint32_t pair = 0; pair < 16 * 32; pair++)
+        {
+            uint8_t audc = pair >> 5, audf = pair & 31;
+            AUDC[0] = audc;                                 Update_tia_sound_0();
+            AUDF[0] = audf;                                 Update_tia_sound_0();
+            AUDV[0] = ((audc + audf) & 15) << 3;            Update_tia_sound_0();
+            AUDC[1] = (audc * 7 + 3) & 15;                  Update_tia_sound_1();
+            AUDF[1] = (audf * 13 + 5) & 31;                 Update_tia_sound_1();
+            AUDV[1] = (15 - ((audc + audf) & 15)) << 3;     Update_tia_sound_1();
+
+            ticks[pair] = 0;
+            for (uint32_t i = 0; i < RUN_CHECK_SAMPLES; i++)
+            {
+                ticks[pair] += Samp_n_cnt >> 8;
+                Tia_process();
+                expected[pair * RUN_CHECK_SAMPLES + i] = *aptr;
+            }
+        }
+        double reference = host_cpu_seconds() - start;
+
+        start = host_cpu_seconds();
+        for (uint32_t pair = 0; pair < 16 * 32; pair++)
+        {
+            uint8_t audc = pair >> 5, audf = pair & 31;
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 0, audc), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 2, audf), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 4, (audc + audf) & 15), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 1, (audc * 7 + 3) & 15), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 3, (audf * 13 + 5) & 31), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(0, 5, 15 - ((audc + audf) & 15)), samples, 0xFFFFFFFF, &idx);
+            TiaSynth_record(&synth, TIA_SYNTH_RECORD(ticks[pair] * TIA_SYNTH_CYCLES, TIA_SYNTH_FRAME, 0), samples, 0xFFFFFFFF, &idx);
+        }
+        double runs = host_cpu_seconds() - start;
+
+        if (idx != 16 * 32 * RUN_CHECK_SAMPLES)
+        {
+            printf("runs:    %5u Hz: expected %u samples got %u\n", rates[r], 16 * 32 * RUN_CHECK_SAMPLES, idx);
+            rate_mismatches++;
+        }
+        else for (uint32_t i = 0; i < idx; i++)
+        {
+            if (samples[i] != expected[i])
+            {
+                if (rate_mismatches++ < 10) printf("runs:    %5u Hz: AUDC0 %2u AUDF0 %2u sample %4u: expected %04X got %04X\n", rates[r],
+                                                   (i / RUN_CHECK_SAMPLES) >> 5, (i / RUN_CHECK_SAMPLES) & 31, i % RUN_CHECK_SAMPLES, expected[i], samples[i]);
+            }
+        }
+
+        printf("runs:    %5u Hz: %u samples compared, %u mismatches - Tia_process() %.2f ms, run-length %.2f ms (%.1fx)\n",
+               rates[r], idx, rate_mismatches, reference * 1000.0, runs * 1000.0, (runs > 0.0) ? (reference / runs) : 0.0);
+        mismatches += rate_mismatches;
+    }
+
+    return mismatches ? 3 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// A small Thumb workload shaped like the ARM side of a CDFJ/DPC+ game - a
+// loop over a table in ROM building up a buffer in RAM, then a function that
+// walks the buffer - run through the Thumbulator with and without the
+// superinstructions and the flag liveness. Every run must leave the registers
+// and the ARM RAM the same. It sits at the usual CDF C start (0x808) and returns through the
+// even C base in lr just as the real drivers expect.
+// ---------------------------------------------------------------------------
+static const uInt16 thumbBenchCode[] =
+{
+    0xB5F0,     // push    {r4-r7, lr}
+    0xB082,     // sub     sp, #8
+    0x2700,     // movs    r7, #0
+    0x4820,     // ldr     r0, =0x40000000
+    0x6800,     // ldr     r0, [r0, #0]       @ outer loop count from the first word of RAM
+    0x9000,     // str     r0, [sp, #0]
+    // outer:
+    0x481F,     // ldr     r0, =0x40000400
+    0x4920,     // ldr     r1, =0x00001000
+    0x2380,     // movs    r3, #128
+    // inner:
+    0x680C,     // ldr     r4, [r1, #0]
+    0x684D,     // ldr     r5, [r1, #4]
+    0x406C,     // eors    r4, r5
+    0x00E6,     // lsls    r6, r4, #3
+    0x19A4,     // adds    r4, r4, r6
+    0x6004,     // str     r4, [r0, #0]
+    0x784E,     // ldrb    r6, [r1, #1]
+    0x7106,     // strb    r6, [r0, #4]
+    0x884E,     // ldrh    r6, [r1, #2]
+    0x80C6,     // strh    r6, [r0, #6]
+    0x6085,     // str     r5, [r0, #8]
+    0x300C,     // adds    r0, #12
+    0x3108,     // adds    r1, #8
+    0x3B01,     // subs    r3, #1
+    0xD1F0,     // bne     inner
+    0xF000,     // bl      helper
+    0xF809,
+    0x9800,     // ldr     r0, [sp, #0]
+    0x3801,     // subs    r0, #1
+    0x9000,     // str     r0, [sp, #0]
+    0x2800,     // cmp     r0, #0
+    0xD1E6,     // bne     outer
+    0xB002,     // add     sp, #8
+    0xBCF0,     // pop     {r4-r7}
+    0xBC08,     // pop     {r3}
+    0x4718,     // bx      r3                 @ lr was the (even) C base - back to the caller
+    // helper:
+    0xB530,     // push    {r4, r5, lr}
+    0xB081,     // sub     sp, #4
+    0x4810,     // ldr     r0, =0x40000400
+    0x2200,     // movs    r2, #0
+    0x2300,     // movs    r3, #0
+    0x25C0,     // movs    r5, #192
+    0x00ED,     // lsls    r5, r5, #3         @ 1536 bytes
+    // hloop:
+    0x5884,     // ldr     r4, [r0, r2]
+    0x191B,     // adds    r3, r3, r4
+    0x09DC,     // lsrs    r4, r3, #7
+    0x4063,     // eors    r3, r4
+    0x3204,     // adds    r2, #4
+    0x42AA,     // cmp     r2, r5
+    0xD1F8,     // bne     hloop
+    0x480C,     // ldr     r0, =0x40000100
+    0x6801,     // ldr     r1, [r0, #0]
+    0x6844,     // ldr     r4, [r0, #4]
+    0x18C9,     // adds    r1, r1, r3
+    0x19C9,     // adds    r1, r1, r7
+    0x6001,     // str     r1, [r0, #0]
+    0x2203,     // movs    r2, #3
+    0x400A,     // ands    r2, r1
+    0x2A01,     // cmp     r2, #1
+    0xD301,     // bcc     even
+    0x3401,     // adds    r4, #1
+    0x6044,     // str     r4, [r0, #4]
+    // even:
+    0x2A02,     // cmp     r2, #2
+    0xD000,     // beq     skip
+    0x3701,     // adds    r7, #1
+    // skip:
+    0x6087,     // str     r7, [r0, #8]
+    0xB001,     // add     sp, #4
+    0xBD30,     // pop     {r4, r5, pc}
+    0x46C0,     // nop                        @ (pad the literal pool to a word)
+    // ram:
+    0x0000,     // .word   0x40000000
+    0x4000,
+    // dst:
+    0x0400,     // .word   0x40000400
+    0x4000,
+    // src:
+    0x1000,     // .word   0x00001000
+    0x0000,
+    // sum:
+    0x0100,     // .word   0x40000100
+    0x4000
+};
+
+static uInt8 thumbBenchRAM[RAMSIZE] __attribute__((aligned(4)));
+
+static uInt32 runThumbBench(bool fuse, bool liveness, uInt32 loops, double *seconds)
+{
+    memset(cart_buffer, 0x00, 0x2000);
+    memcpy(&cart_buffer[0x808], thumbBenchCode, sizeof(thumbBenchCode));
+    uInt32 seed = 12345;
+    for (uInt32 i = 0x1000; i < 0x1400; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        cart_buffer[i] = (uInt8)(seed >> 16);
+    }
+
+    memset(thumbBenchRAM, 0x00, sizeof(thumbBenchRAM));
+    *(uInt32*)thumbBenchRAM = loops;
+    myARMRAM = thumbBenchRAM;
+    cStack = 0x40001fb4;
+    cBase  = 0x00000800;
+    cStart = 0x00000808;
+
+    Thumbulator *thumb = new Thumbulator((uInt16*)cart_buffer, 0x2000, fuse, liveness);
+#ifdef CPU_PROFILER
+    memset(profiler, 0x00, 256 * sizeof(u32));
+    memset(profiler_pairs, 0x00, 256 * 256 * sizeof(u32));
+#endif
+    double start = host_seconds();
+    thumb->run();
+    *seconds = host_seconds() - start;
+    delete thumb;
+
+    uInt32 digest = 2166136261;
+    for (uInt32 i = 0; i < 15; i++) digest = (digest ^ reg_sys[i]) * 16777619;   // r15 is only fixed up when it's used
+    for (uInt32 i = 0; i < sizeof(thumbBenchRAM); i++) digest = (digest ^ thumbBenchRAM[i]) * 16777619;
+    return digest;
+}
+
+// ---------------------------------------------------------------------------
+// How long it takes to get a Thumbulator going on a 512K CDFJ+ sized image -
+// the workload up front and the rest random (as the graphics and music would
+// be) - building it and then the first run of the workload.
+// ---------------------------------------------------------------------------
+#define THUMB_LOAD_PASSES 20
+
+static void timeThumbLoad(void)
+{
+    uInt32 seed = 54321;
+    for (uInt32 i = 0; i < MAX_CART_FILE_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        cart_buffer[i] = (uInt8)(seed >> 16);
+    }
+    memcpy(&cart_buffer[0x808], thumbBenchCode, sizeof(thumbBenchCode));
+
+    memset(thumbBenchRAM, 0x00, sizeof(thumbBenchRAM));
+    *(uInt32*)thumbBenchRAM = 1;
+    myARMRAM = thumbBenchRAM;
+    cStack = 0x40001fb4;
+    cBase  = 0x00000800;
+    cStart = 0x00000808;
+
+    double start = host_seconds();
+    for (uInt32 i = 0; i < THUMB_LOAD_PASSES; i++) delete new Thumbulator((uInt16*)cart_buffer, MAX_CART_FILE_SIZE);
+    double built = (host_seconds() - start) / THUMB_LOAD_PASSES;
+
+    Thumbulator *thumb = new Thumbulator((uInt16*)cart_buffer, MAX_CART_FILE_SIZE);
+    start = host_seconds();
+    thumb->run();
+    double first = host_seconds() - start;
+    delete thumb;
+
+    printf("thumb:   512K image - Thumbulator built in %.3f ms, first run of the workload %.3f ms (%u of %u pages decoded)\n",
+           built * 1000.0, first * 1000.0, thumbPagesDecoded, (thumbRomMask+1) / THUMB_PAGE_SIZE);
+    memset(cart_buffer, 0x00, MAX_CART_FILE_SIZE);
+}
+
+#ifdef CPU_PROFILER
+// The busiest ops and pairs of ops from the last Thumbulator run
+static void dumpThumbProfile(void)
+{
+    for (uInt32 n = 0; n < 12; n++)
+    {
+        uInt32 best = 0;
+        for (uInt32 i = 1; i < 256 * 256; i++) if (profiler_pairs[i] > profiler_pairs[best]) best = i;
+        if (profiler_pairs[best] == 0) break;
+        printf("profile: ops %3u,%3u  %10u  (%3u alone %10u)\n", best >> 8, best & 0xFF, profiler_pairs[best], best & 0xFF, profiler[best & 0xFF]);
+        profiler_pairs[best] = 0;
+    }
+}
+#endif
+
+static int benchThumb(uInt32 loops)
+{
+    double plain, fused, live;
+    uInt32 expected = runThumbBench(false, false, loops, &plain);
+#ifdef CPU_PROFILER
+    dumpThumbProfile();
+#endif
+    uInt32 digest = runThumbBench(true, false, loops, &fused);
+    uInt32 pruned = runThumbBench(true, true, loops, &live);
+
+    printf("thumb:   %u loops, plain %.2f ms digest %08X, superinstructions %.2f ms digest %08X (%.2fx), with flag liveness %.2f ms digest %08X (%.2fx)\n",
+           loops, plain * 1000.0, expected, fused * 1000.0, digest, (fused > 0.0) ? (plain / fused) : 0.0,
+           live * 1000.0, pruned, (live > 0.0) ? (plain / live) : 0.0);
+    if ((digest != expected) || (pruned != expected)) printf("thumb:   MISMATCH\n");
+    bool mismatch = (digest != expected) || (pruned != expected);
+
+#ifdef THUMB_FLAG_LIVENESS
+    // Over the workload itself - less the four word literal pool on the end
+    uInt32 carry, carryDead, zn, znDead;
+    Thumbulator::countDeadFlags(0x808, 0x808 + sizeof(thumbBenchCode) - 16, &carry, &carryDead, &zn, &znDead);
+    printf("thumb:   carry not needed after %u of %u ops that set it, Z/N not needed after %u of %u\n", carryDead, carry, znDead, zn);
+#endif
+
+#ifdef THUMB_TRANSLATOR
+    // Then through the translator - flat out with and without the flag liveness and then (for
+    // a few loops as it copies the whole ARM RAM twice a block) checking every block against
+    // the interpreter
+    double translated, unpruned, checked;
+    uInt32 checkLoops = (loops < 20) ? loops : 20;
+    uInt32 expectedChecked = runThumbBench(false, true, checkLoops, &checked);
+    bThumbTranslate = true;
+    uint64_t before = ThumbTranslator::executed();
+    uInt32 native = runThumbBench(false, true, loops, &translated);
+    uint64_t instructions = ThumbTranslator::executed() - before;
+    uInt32 nativeAll = runThumbBench(false, false, loops, &unpruned);
+    bThumbTranslateCheck = true;
+    uInt32 both = runThumbBench(false, true, checkLoops, &checked);
+    ThumbTranslator::report();
+    bThumbTranslateCheck = false;
+    bThumbTranslate = false;
+
+    printf("thumb:   translated %.2f ms digest %08X (%.2fx), without flag liveness %.2f ms digest %08X, %u loops checked digest %08X (expected %08X)\n",
+           translated * 1000.0, native, (translated > 0.0) ? (plain / translated) : 0.0, unpruned * 1000.0, nativeAll,
+           checkLoops, both, expectedChecked);
+    if ((native != expected) || (nativeAll != expected) || (both != expectedChecked)) printf("thumb:   TRANSLATOR MISMATCH\n");
+    mismatch |= (native != expected) || (nativeAll != expected) || (both != expectedChecked);
+
+    // The same instructions run each way so one count gives the MIPS for all of them
+    printf("thumb:   %llu instructions - MIPS plain %.1f, superinstructions %.1f, with flag liveness %.1f, translated %.1f\n",
+           (unsigned long long)instructions, instructions / plain / 1000000.0, instructions / fused / 1000000.0,
+           instructions / live / 1000000.0, instructions / translated / 1000000.0);
+#endif
+
+    timeThumbLoad();
+
+    return mismatch ? 3 : 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f frames] [-w warmup_frames] [-s seed] [-d driver] [-a quality] [-p] [-v] [-o frame.ppm] romfile\n", prog);
+    fprintf(stderr, "       %s -k [-f frames]\n", prog);
+    fprintf(stderr, "       %s -c\n", prog);
+    fprintf(stderr, "       %s -m\n", prog);
+    fprintf(stderr, "       %s -e romdir\n", prog);
+    fprintf(stderr, "       %s -t loops\n", prog);
+    fprintf(stderr, "       %s -y soundlog\n", prog);
+    fprintf(stderr, "       %s -g\n", prog);
+    fprintf(stderr, "       %s -r soundlog\n", prog);
+    fprintf(stderr, "   -f frames   Number of frames to time (default 3000)\n");
+    fprintf(stderr, "   -w frames   Number of frames to run before timing starts (default 0)\n");
+    fprintf(stderr, "   -s seed     Seed for the emulated power-on randomness (default 0)\n");
+    fprintf(stderr, "   -d driver   Force the 6502 bus driver (cartDriver) - e.g. 2=F8, 7=F6SC\n");
+    fprintf(stderr, "   -p          Request PAL if the ROM is not in the database\n");
+    fprintf(stderr, "   -a quality  Sound quality: 0=mute (default) 1=10kHz 2=15kHz 3=20kHz 4=30kHz 5=WAVE DIRECT\n");
+    fprintf(stderr, "   -v          Print the frame hash of every frame\n");
+    fprintf(stderr, "   -o file     Write the last frame out as a PPM image\n");
+    fprintf(stderr, "   -b usec     Time each frame against this budget and skip drawing when behind (TIA_ADAPTIVE_FRAMESKIP builds)\n");
+    fprintf(stderr, "   -k          Time the TIA pixel kernels for every object combination (no ROM needed)\n");
+    fprintf(stderr, "   -c          Check the compact TIA tables against the full size tables they replace\n");
+    fprintf(stderr, "   -m          Check and time the MD5 lookups into the internal database and StellaDS.DAT\n");
+    fprintf(stderr, "   -e dir      Guess the bankswitching of every ROM in dir with the single pass scanner and the old searches\n");
+    fprintf(stderr, "   -t loops    Run a Thumb workload through the Thumbulator with and without the superinstructions and flag liveness\n");
+#ifdef THUMB_TRANSLATOR
+    fprintf(stderr, "   -x mode     Run the ARM code of a DPC+/CDF game: 0=interpreted (default) 1=translated 2=translated and checked\n");
+#endif
+    fprintf(stderr, "   -l file     Save the sound register log (TIA_SOUND_ARM7 builds with sound on)\n");
+    fprintf(stderr, "   -y file     Replay a sound register log through both sound cores and compare them\n");
+    fprintf(stderr, "   -g          Check the run-length sound generator against Tia_process() for every AUDC/AUDF pair\n");
+    fprintf(stderr, "   -r file     Render a sound register log to WAV files at each sample rate, plain and band-limited\n");
+}
+
+int main(int argc, char **argv)
+{
+    uInt32 frames = 3000;
+    uInt32 warmup = 0;
+    bool   verbose = false;
+    bool   kernels = false;
+    bool   tables = false;
+    bool   database = false;
+    bool   runs = false;
+    char  *outfile = NULL;
+    char  *logfile = NULL;
+    char  *replayfile = NULL;
+    char  *renderfile = NULL;
+    char  *detectdir = NULL;
+    uInt32 thumbloops = 0;
+    int    driver = -1;
+    int    opt;
+
+    while ((opt = getopt(argc, argv, "f:w:s:o:d:a:l:y:r:b:e:t:x:pvkcgmh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': frames = strtoul(optarg, NULL, 0); break;
+            case 'w': warmup = strtoul(optarg, NULL, 0); break;
+            case 's': host_seed = (time_t)strtoul(optarg, NULL, 0); break;
+            case 'p': tv_type_requested = PAL; break;
+            case 'a': myGlobalCartInfo.sound = strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = true; break;
+            case 'k': kernels = true; break;
+            case 'c': tables = true; break;
+            case 'm': database = true; break;
+            case 'g': runs = true; break;
+            case 'o': outfile = optarg; break;
+            case 'l': logfile = optarg; break;
+            case 'y': replayfile = optarg; break;
+            case 'r': renderfile = optarg; break;
+            case 'e': detectdir = optarg; break;
+            case 't': thumbloops = strtoul(optarg, NULL, 0); break;
+            case 'd': driver = strtol(optarg, NULL, 0); break;
+#ifdef THUMB_TRANSLATOR
+            case 'x': bThumbTranslate = (strtoul(optarg, NULL, 0) > 0); bThumbTranslateCheck = (strtoul(optarg, NULL, 0) > 1); break;
+#endif
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+            case 'b': host_frame_budget = strtoul(optarg, NULL, 0); break;
+#endif
+            default:  usage(argv[0]); return 1;
+        }
+    }
+
+    if (tables)
+    {
+        // The tables are built when the TIA is constructed so there's nothing to set up
+        return checkTables();
+    }
+
+    if (database)
+    {
+        return benchDatabase();
+    }
+
+    if (detectdir)
+    {
+        return compareDetectors(detectdir);
+    }
+
+    if (thumbloops)
+    {
+        return benchThumb(thumbloops);
+    }
+
+    if (replayfile)
+    {
+        if (!host_platform_init()) return 1;
+        return replaySoundLog(replayfile);
+    }
+
+    if (renderfile)
+    {
+        return renderSoundLog(renderfile);
+    }
+
+    if (runs)
+    {
+        if (!host_platform_init()) return 1;
+        return checkSoundRuns();
+    }
+
+    if (kernels)
+    {
+        if (!host_platform_init()) return 1;
+        return benchKernels((frames == 3000) ? 200 : frames);
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!host_platform_init()) return 1;
+
+    // Load the file
+    const char *filename = argv[optind];
+    FILE *romfile = fopen(filename, "rb");
+    if (romfile == NULL)
+    {
+        fprintf(stderr, "Unable to open %s\n", filename);
+        return 1;
+    }
+
+    fseek(romfile, 0, SEEK_END);
+    uInt32 buffer_size = ftell(romfile);
+    if (buffer_size > MAX_CART_FILE_SIZE)
+    {
+        fprintf(stderr, "ROM is too large (%u bytes)\n", buffer_size);
+        fclose(romfile);
+        return 1;
+    }
+
+    memset(cart_buffer, 0xFF, MAX_CART_FILE_SIZE);
+    rewind(romfile);
+    fread(cart_buffer, buffer_size, 1, romfile);
+    fclose(romfile);
+
+    for (uInt16 i=0; i<(uInt16)strlen(filename) && i<(sizeof(my_filename)-1); i++)
+    {
+        my_filename[i] = tolower(filename[i]);
+    }
+
+    // Init the emulation
+    theConsole = new Console((const uInt8*) cart_buffer, buffer_size, "noname");
+    if (bHaltEmulation) return 2;
+    if (driver >= 0) cartDriver = driver;
+
+#ifdef TIA_SOUND_ARM7
+    if (bArm7Sound)
+    {
+        startSynth();
+        if (logfile) host_sound_log = fopen(logfile, "wb");
+    }
+#endif
+
+    for (uInt32 i = 0; i < warmup; i++)
+    {
+        emulateFrame();
+    }
+
+    uInt32 hash = 2166136261;
+    uInt32 startCycles = gTotalSystemCycles;
+#ifdef M6502_INSTRUCTION_COUNT
+    uInt32 startInstructions = gTotalInstructions;
+    uInt32 startIdle = gIdleCyclesSkipped;
+#endif
+#ifdef TIA_WRITE_DIGEST
+    uInt32 startWrites = gTIAWrites;
+    gTIAWriteDigest = 2166136261;
+#endif
+#if defined(TIA_DEFERRED_RENDER) && defined(TIA_STATS)
+    uInt32 startDeferred = gTIAWritesDeferred;
+    uInt32 startFlushes = gTIAWriteLogFlushes;
+#endif
+#if defined(TIA_DIRTY_LINES) && defined(TIA_STATS)
+    uInt32 startPushed = gLinesPushed;
+    uInt32 startLinesSkipped = gLinesSkipped;
+#endif
+#if defined(TIA_COLLISION_SPANS) && defined(TIA_STATS)
+    uInt32 startReads = gCollisionReads;
+    uInt32 startResolved = gCollisionSpansResolved;
+    uInt32 startSkipped = gCollisionSpansSkipped;
+#endif
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+    uInt32 startFramesSkipped = gFramesSkipped;
+#endif
+#ifdef TIA_SOUND_BLOCKS
+    uInt32 startBlocks = gSoundBlocks;
+    uInt32 startSamples = gSoundBlockSamples;
+    uInt32 startResyncs = gSoundRingResyncs;
+#endif
+#ifdef TIA_SOUND_WAVE_LOG
+    uInt32 startWaveRecords = gWaveRecords;
+    uInt32 startWaveSamples = gWaveSamples;
+    uInt32 startWaveResyncs = gWaveResyncs;
+#endif
+#ifdef TIA_SOUND_ARM7
+    uInt32 startRecords = gSoundRecords;
+    uInt32 startFull = gSoundFifoFull;
+    uInt32 startSynthSamples = host_synth_samples;
+    host_synth_digest = 2166136261;
+#endif
+    double start = host_seconds();
+    for (uInt32 i = 0; i < frames; i++)
+    {
+        emulateFrame();
+        if (verbose) printf("frame %u: %08X\n", i, hashFrame(2166136261));
+    }
+    double elapsed = host_seconds() - start;
+
+    // The frame hash covers only the last frame so it is independent of any timing
+    hash = hashFrame(hash);
+    if (outfile) writeFrame(outfile);
+
+    printf("rom:     %s\n", filename);
+    printf("md5:     %s\n", myCartInfo.md5);
+    printf("cart:    %s (driver %d)\n", theConsole->myCartridge->name(), cartDriver);
+    printf("frames:  %u in %.3f sec\n", frames, elapsed);
+    printf("fps:     %.1f\n", (elapsed > 0.0) ? (frames / elapsed) : 0.0);
+    printf("boot:    %.3f ms of CPU time to the end of the first frame\n", boot_seconds * 1000.0);
+    printf("cycles:  %u\n", gTotalSystemCycles - startCycles);
+#ifdef M6502_INSTRUCTION_COUNT
+    uInt32 instructions = gTotalInstructions - startInstructions;
+    printf("instr:   %u\n", instructions);
+    printf("mips:    %.2f\n", (elapsed > 0.0) ? (instructions / elapsed / 1000000.0) : 0.0);
+    printf("idle:    %u cycles skipped\n", gIdleCyclesSkipped - startIdle);
+#endif
+#ifdef TIA_WRITE_DIGEST
+    // Every TIA write of the timed frames along with the cycle it happened on
+    printf("tia:     %u writes, digest %08X\n", gTIAWrites - startWrites, gTIAWriteDigest);
+#endif
+#if defined(TIA_DEFERRED_RENDER) && defined(TIA_STATS)
+    // Display register writes that went through the scanline write log and how many times it was played back
+    printf("tialog:  %u writes deferred, %u flushes\n", gTIAWritesDeferred - startDeferred, gTIAWriteLogFlushes - startFlushes);
+#endif
+#if defined(TIA_COLLISION_SPANS) && defined(TIA_STATS)
+    // Collision register reads and the drawn spans that had their collisions worked out (or never needed to)
+    printf("collide: %u reads, %u spans resolved, %u skipped\n", gCollisionReads - startReads, gCollisionSpansResolved - startResolved, gCollisionSpansSkipped - startSkipped);
+#endif
+#if defined(TIA_DIRTY_LINES) && defined(TIA_STATS)
+    // Scanlines copied out to the DS screen against the ones that hadn't changed since the last time
+    printf("lines:   %u pushed, %u skipped, %u on the last frame\n", gLinesPushed - startPushed, gLinesSkipped - startLinesSkipped, gLinesPushedLastFrame);
+#endif
+#ifdef TIA_ADAPTIVE_FRAMESKIP
+    // Frames that ran but weren't drawn as we were behind the -b budget
+    printf("skip:    %u of %u frames not drawn\n", gFramesSkipped - startFramesSkipped, frames);
+#endif
+#ifdef TIA_SOUND_BLOCKS
+    // Samples made a block at a time (one per AUDx write plus one per frame) instead of one per timer interrupt
+    printf("sound:   %u samples in %u blocks, %u ring resyncs\n", gSoundBlockSamples - startSamples, gSoundBlocks - startBlocks, gSoundRingResyncs - startResyncs);
+#endif
+#ifdef TIA_SOUND_ARM7
+    // Register writes handed over to the "ARM7" and the samples it made from them
+    printf("sound:   %u records, %u dropped, %u samples, digest %08X\n", gSoundRecords - startRecords, gSoundFifoFull - startFull, host_synth_samples - startSynthSamples, host_synth_digest);
+    if (host_sound_log) fclose(host_sound_log);
+#endif
+#ifdef TIA_SOUND_WAVE_LOG
+    // WAVE DIRECT writes logged and the samples made from them at the end of each frame
+    printf("wave:    %u records, %u samples, %u ring resyncs\n", gWaveRecords - startWaveRecords, gWaveSamples - startWaveSamples, gWaveResyncs - startWaveResyncs);
+#endif
+#ifdef THUMB_TRANSLATOR
+    // What the translator made of the ARM code (for the whole run - warmup included)
+    if (bThumbTranslate) ThumbTranslator::report();
+    if (thumbPagesDecoded)
+    {
+        // Only translated runs count the instructions - the interpreter's MIPS is that count over
+        // the time of a -x 0 run of the same ROM and seed
+        double armSeconds = ThumbTranslator::seconds();
+        if (bThumbTranslate) printf("thumb:   %llu instructions in %.1f ms of ARM code - %.1f MIPS\n", (unsigned long long)ThumbTranslator::executed(),
+                                    armSeconds * 1000.0, (armSeconds > 0.0) ? (ThumbTranslator::executed() / armSeconds / 1000000.0) : 0.0);
+        else printf("thumb:   %.1f ms of ARM code\n", armSeconds * 1000.0);
+    }
+#endif
+#ifdef THUMB_FLAG_LIVENESS
+    if (thumbPagesDecoded)
+    {
+        // Over every page of ARM code that ran
+        uInt32 carry, carryDead, zn, znDead;
+        Thumbulator::countDeadFlags(0, thumbRomMask+1, &carry, &carryDead, &zn, &znDead);
+        printf("thumb:   carry not needed after %u of %u ops that set it, Z/N not needed after %u of %u (%u pages decoded)\n",
+               carryDead, carry, znDead, zn, thumbPagesDecoded);
+    }
+#endif
+    printf("hash:    %08X\n", hash);
+
+    return 0;
+}